@@ -19,14 +19,18 @@ import {
     filterLegal,
     legalMap,
     parseCryptarithm,
+    setCryptarithmEngine,
     solveCryptarithm,
     tryFormulaLevel,
 } from '../common/cryptarithm';
+import { loadCsolverWasm } from '../common/csolverwasm';
 import { JTButtonItem, JTButtonGroup } from '../common/jtbuttongroup';
 import { JTFLabeledInput } from '../common/jtflabeledinput';
 import { JTTable } from '../common/jttable';
 import { CipherEncoder, IEncoderState, suggestedData } from './cipherencoder';
 
+declare var __CSOLVER_WASM__: boolean;
+
 interface ICryptarithmState extends IEncoderState {
     /** Problem */
     problem: string;
@@ -493,6 +497,16 @@ export class CipherCryptarithmEncoder extends CipherEncoder {
     public init(lang: string): void {
         super.init(lang);
         this.ShowRevReplace = false;
+        // Builds made with --env=wasm=y check puzzles with the WebAssembly solver
+        // once it has loaded.  Until then, or if it can't be loaded, the
+        // TypeScript one is used.
+        if (typeof __CSOLVER_WASM__ !== 'undefined' && __CSOLVER_WASM__) {
+            loadCsolverWasm().then((loaded) => {
+                if (loaded) {
+                    setCryptarithmEngine('wasm');
+                }
+            });
+        }
     }
     public buildReplacement(msg: string, maxEncodeWidth: number): string[][] {
         const result: string[][] = [];
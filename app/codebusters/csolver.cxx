@@ -47,18 +47,37 @@
 #include <memory.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
 #include <time.h>
 #include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 typedef unsigned long ulong;
+typedef unsigned long long ulonglong;
 
-// For the sake of efficiency, we limit the maximum base to 16 and
+// For the sake of efficiency, we limit the maximum base to 62 and
 // the maximum length of a string to 16 characters.  These can
-// be increased.  MAX_BASE can be increased arbitrarily.  MAX_LEN
+// be increased.  MAX_BASE can be increased to 64 before the bit masks
+// of digits below, one bit for each digit, run out of bits.  MAX_LEN
 // must be increased by powers of two and MAX_LEN_SHIFT must be
 // increased so that 2^MAX_LEN_SHIFT == MAX_LEN
 
-const int MAX_BASE = 16;
+const int MAX_BASE = 62;
 const int MAX_LEN = 16;
 const int MAX_LEN_SHIFT = 4;
 
@@ -78,6 +97,401 @@ int max_of_two(int x, int y)
    {
       return((x > y) ? x : y);
    }
+long long min_of_two_long(long long x, long long y)
+   {
+      return((x < y) ? x : y);
+   }
+long long max_of_two_long(long long x, long long y)
+   {
+      return((x > y) ? x : y);
+   }
+
+// Letters other than A to Z.  Words are read as UTF-8, and the first
+// time a letter that isn't one of A to Z is seen, with any accents
+// written after it as combining marks, it is given one of the chars
+// after Z.  The searches only ever see the chars, so these letters
+// cost no more than A to Z once the words are read.  The chars stay
+// below 128, so the tables indexed by letter and the bit maps of the
+// letters in a word, with a bit for each from A up, are big enough for
+// all of them.
+//
+// The letters taken are the Latin, Greek and Cyrillic ones, upcased
+// where they have a capital.  A letter written as one code point and
+// the same letter written with a combining mark are the same letter.
+// When accents are folded, a letter that Unicode makes from another
+// and marks is that other letter, so É is E, while Æ, Ø and ß, which
+// aren't made that way, are still letters of their own.
+//
+// Each puzzle has its own alphabet of these chars, so there can be
+// EXTRA_LETTERS of them in each.  A -batch thread starts a new one
+// for every puzzle it reads.  The puzzle or the word list given on
+// the command line uses run_letters, and the puzzles -find makes from
+// a list share the list's chars.
+
+const int EXTRA_LETTERS = 128 - ('Z' + 1);
+const int LETTER_SIZE = 16;      // The longest letter in UTF-8, with its null.
+const int WORD_TEXT_SIZE = MAX_LEN * (LETTER_SIZE - 1) + 1;
+
+const int NOT_A_LETTER = 0;      // What read_letter returns for these.
+const int NEW_LETTER = -1;
+const int NO_LETTERS_LEFT = -2;
+
+struct alphabet {
+   int    count;                                 // Chars given out.
+   char   letters[EXTRA_LETTERS][LETTER_SIZE];   // The letter of each.
+};
+
+alphabet run_letters;
+int fold_accents = 0;            // 1 to read letters without their accents.
+
+// The letters Unicode makes from another and one combining mark, so
+// that the two ways of writing them can be made the same, or the mark
+// dropped.  Only the capitals are here.
+
+struct composed_letter {
+   int  code;        // The letter as one code point.
+   int  base;        // The letter it is made from.
+   int  mark;        // The combining mark.
+};
+
+static const composed_letter composed_letters[] = {
+   {0xC0, 'A', 0x300}, {0xC1, 'A', 0x301}, {0xC2, 'A', 0x302},
+   {0xC3, 'A', 0x303}, {0xC4, 'A', 0x308}, {0xC5, 'A', 0x30A},
+   {0xC7, 'C', 0x327}, {0xC8, 'E', 0x300}, {0xC9, 'E', 0x301},
+   {0xCA, 'E', 0x302}, {0xCB, 'E', 0x308}, {0xCC, 'I', 0x300},
+   {0xCD, 'I', 0x301}, {0xCE, 'I', 0x302}, {0xCF, 'I', 0x308},
+   {0xD1, 'N', 0x303}, {0xD2, 'O', 0x300}, {0xD3, 'O', 0x301},
+   {0xD4, 'O', 0x302}, {0xD5, 'O', 0x303}, {0xD6, 'O', 0x308},
+   {0xD9, 'U', 0x300}, {0xDA, 'U', 0x301}, {0xDB, 'U', 0x302},
+   {0xDC, 'U', 0x308}, {0xDD, 'Y', 0x301},
+   {0x100, 'A', 0x304}, {0x102, 'A', 0x306}, {0x104, 'A', 0x328},
+   {0x106, 'C', 0x301}, {0x108, 'C', 0x302}, {0x10A, 'C', 0x307},
+   {0x10C, 'C', 0x30C}, {0x10E, 'D', 0x30C}, {0x112, 'E', 0x304},
+   {0x114, 'E', 0x306}, {0x116, 'E', 0x307}, {0x118, 'E', 0x328},
+   {0x11A, 'E', 0x30C}, {0x11C, 'G', 0x302}, {0x11E, 'G', 0x306},
+   {0x120, 'G', 0x307}, {0x122, 'G', 0x327}, {0x124, 'H', 0x302},
+   {0x128, 'I', 0x303}, {0x12A, 'I', 0x304}, {0x12C, 'I', 0x306},
+   {0x12E, 'I', 0x328}, {0x130, 'I', 0x307}, {0x134, 'J', 0x302},
+   {0x136, 'K', 0x327}, {0x139, 'L', 0x301}, {0x13B, 'L', 0x327},
+   {0x13D, 'L', 0x30C}, {0x143, 'N', 0x301}, {0x145, 'N', 0x327},
+   {0x147, 'N', 0x30C}, {0x14C, 'O', 0x304}, {0x14E, 'O', 0x306},
+   {0x150, 'O', 0x30B}, {0x154, 'R', 0x301}, {0x156, 'R', 0x327},
+   {0x158, 'R', 0x30C}, {0x15A, 'S', 0x301}, {0x15C, 'S', 0x302},
+   {0x15E, 'S', 0x327}, {0x160, 'S', 0x30C}, {0x162, 'T', 0x327},
+   {0x164, 'T', 0x30C}, {0x168, 'U', 0x303}, {0x16A, 'U', 0x304},
+   {0x16C, 'U', 0x306}, {0x16E, 'U', 0x30A}, {0x170, 'U', 0x30B},
+   {0x172, 'U', 0x328}, {0x174, 'W', 0x302}, {0x176, 'Y', 0x302},
+   {0x178, 'Y', 0x308}, {0x179, 'Z', 0x301}, {0x17B, 'Z', 0x307},
+   {0x17D, 'Z', 0x30C},
+   {0x386, 0x391, 0x301}, {0x388, 0x395, 0x301}, {0x389, 0x397, 0x301},
+   {0x38A, 0x399, 0x301}, {0x38C, 0x39F, 0x301}, {0x38E, 0x3A5, 0x301},
+   {0x38F, 0x3A9, 0x301}, {0x3AA, 0x399, 0x308}, {0x3AB, 0x3A5, 0x308},
+   {0x401, 0x415, 0x308}, {0x407, 0x406, 0x308}, {0x419, 0x418, 0x306},
+   {0x40E, 0x423, 0x306}
+};
+
+const int COMPOSED_LETTERS = sizeof(composed_letters) / sizeof(composed_letters[0]);
+
+
+int decode_utf8(
+      const char  **text,   // Moved past the code point.
+      const char   *end     // Where the text ends.
+   )
+   // Returns the code point at text, or -1 if it isn't good UTF-8.
+   {
+      int                   code;
+      int                   i;
+      int                   more;
+      const unsigned char  *p = (const unsigned char *) *text;
+
+
+      if(p[0] < 0x80) {
+         code = p[0];
+         more = 0;
+      } else if(p[0] >= 0xC2 && p[0] <= 0xDF) {
+         code = p[0] & 0x1F;
+         more = 1;
+      } else if(p[0] >= 0xE0 && p[0] <= 0xEF) {
+         code = p[0] & 0x0F;
+         more = 2;
+      } else if(p[0] >= 0xF0 && p[0] <= 0xF4) {
+         code = p[0] & 0x07;
+         more = 3;
+      } else {
+         return(-1);
+      }
+      if(end - *text <= more) {
+         return(-1);
+      }
+      for(i = 1; i <= more; i++) {
+         if((p[i] & 0xC0) != 0x80) {
+            return(-1);
+         }
+         code = (code << 6) | (p[i] & 0x3F);
+      }
+      *text += more + 1;
+      return(code);
+   }
+
+
+int encode_utf8(
+      int    code,
+      char  *text     // Room for four bytes.
+   )
+   // Write a code point as UTF-8.  Returns the number of bytes.
+   {
+      if(code < 0x80) {
+         text[0] = code;
+         return(1);
+      } else if(code < 0x800) {
+         text[0] = 0xC0 | (code >> 6);
+         text[1] = 0x80 | (code & 0x3F);
+         return(2);
+      } else if(code < 0x10000) {
+         text[0] = 0xE0 | (code >> 12);
+         text[1] = 0x80 | ((code >> 6) & 0x3F);
+         text[2] = 0x80 | (code & 0x3F);
+         return(3);
+      }
+      text[0] = 0xF0 | (code >> 18);
+      text[1] = 0x80 | ((code >> 12) & 0x3F);
+      text[2] = 0x80 | ((code >> 6) & 0x3F);
+      text[3] = 0x80 | (code & 0x3F);
+      return(4);
+   }
+
+
+int count_characters(
+      const char  *text
+   )
+   // Returns the number of code points in UTF-8 text, counting each
+   // byte that doesn't continue a code point.
+   {
+      int  count = 0;
+
+
+      for(; *text != '\0'; text++) {
+         count += (*text & 0xC0) != 0x80;
+      }
+      return(count);
+   }
+
+
+int upcase_letter(
+      int  code
+   )
+   // Returns the capital of a letter, or the letter itself if it has
+   // none or isn't one this knows about.  Returns 0 for anything that
+   // isn't a letter.
+   {
+      if(code >= 'A' && code <= 'Z') {
+         return(code);
+      } else if(code >= 'a' && code <= 'z') {
+         return(code - 'a' + 'A');
+      } else if(code < 0xC0 || code == 0xD7 || code == 0xF7) {
+         return(0);
+      } else if(code >= 0xE0 && code <= 0xFE) {
+         return(code - 0x20);
+      } else if(code == 0xFF) {
+         return(0x178);
+      } else if(code == 0x131) {
+         return('I');
+      } else if(code == 0x17F) {
+         return('S');
+      } else if((code >= 0x100 && code <= 0x137) ||
+                (code >= 0x14A && code <= 0x177)) {
+         return(code & ~1);
+      } else if((code >= 0x139 && code <= 0x148) ||
+                (code >= 0x179 && code <= 0x17E)) {
+         return(code - !(code & 1));
+      } else if(code <= 0x24F) {
+         return(code);
+      } else if(code == 0x3C2) {
+         return(0x3A3);
+      } else if(code >= 0x3B1 && code <= 0x3CB) {
+         return(code - 0x20);
+      } else if(code == 0x3AC) {
+         return(0x386);
+      } else if(code >= 0x3AD && code <= 0x3AF) {
+         return(code - 0x25);
+      } else if(code == 0x3CC) {
+         return(0x38C);
+      } else if(code == 0x3CD || code == 0x3CE) {
+         return(code - 0x3F);
+      } else if(code >= 0x386 && code <= 0x3FF && code != 0x387) {
+         return(code);
+      } else if(code >= 0x430 && code <= 0x44F) {
+         return(code - 0x20);
+      } else if(code >= 0x450 && code <= 0x45F) {
+         return(code - 0x50);
+      } else if(code >= 0x400 && code <= 0x4FF &&
+                (code < 0x482 || code > 0x489)) {
+         return(code);
+      }
+      return(0);
+   }
+
+
+int read_letter(
+      const char  **text,     // Moved past the letter.
+      const char   *end,      // Where the text ends.
+      int           add,      // 1 to give a char to a letter not seen before.
+      alphabet     *letters   // The chars given out so far.
+   )
+   // Read a letter and any combining marks after it from UTF-8 text.
+   // Returns its char, NOT_A_LETTER if the text there isn't a letter,
+   // NEW_LETTER if add is 0 and the letter hasn't been given a char,
+   // or NO_LETTERS_LEFT if it would need one and all EXTRA_LETTERS
+   // have been given out.  The text is read past a new letter, so that the
+   // letters of a word can be counted before any are given chars, but
+   // not past anything else that isn't a char.
+   {
+      int          code;
+      int          i;
+      int          length;
+      char         letter[LETTER_SIZE];
+      int          mark;
+      const char  *mark_p;
+      const char  *p = *text;
+
+
+      // Letters of A to Z with nothing after them that could be a mark,
+      // whose first byte is 0xCC or 0xCD, are most of what is read.
+
+      if(p == end) {
+         return(NOT_A_LETTER);
+      }
+      if(((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) &&
+            (p + 1 == end || (p[1] & 0xFE) != 0xCC)) {
+         *text = p + 1;
+         return(*p & ~0x20);
+      }
+      code = upcase_letter(decode_utf8(&p, end));
+      if(code <= 0) {
+         return(NOT_A_LETTER);
+      }
+      if(fold_accents) {
+         for(i = 0; i < COMPOSED_LETTERS; i++) {
+            if(composed_letters[i].code == code) {
+               code = composed_letters[i].base;
+               break;
+            }
+         }
+      }
+
+      // Take the marks.  When they're folded they're just dropped.
+      // Otherwise each is put together with the letter if Unicode has
+      // a code point for the two, or kept after it if not.
+
+      length = 0;
+      while(p < end) {
+         mark_p = p;
+         mark = decode_utf8(&p, end);
+         if(mark < 0x300 || mark > 0x36F) {
+            p = mark_p;
+            break;
+         }
+         if(fold_accents) {
+            continue;
+         }
+         for(i = 0; length == 0 && i < COMPOSED_LETTERS; i++) {
+            if(composed_letters[i].base == code &&
+                  composed_letters[i].mark == mark) {
+               code = composed_letters[i].code;
+               break;
+            }
+         }
+         if(length > 0 || i == COMPOSED_LETTERS) {
+            if(length + 2 > LETTER_SIZE - 5) {
+               return(NOT_A_LETTER);
+            }
+            length += encode_utf8(mark, &letter[4 + length]);
+         }
+      }
+      if(code < 0x80 && length == 0) {
+         *text = p;
+         return(code);
+      }
+
+      // Look the letter up among those given chars, with the code point
+      // in front of the marks.
+
+      i = encode_utf8(code, letter);
+      memmove(&letter[i], &letter[4], length);
+      letter[i + length] = '\0';
+      for(i = 0; i < letters->count; i++) {
+         if(strcmp(letters->letters[i], letter) == 0) {
+            *text = p;
+            return('Z' + 1 + i);
+         }
+      }
+      if(!add) {
+         *text = p;
+         return(NEW_LETTER);
+      }
+      if(i == EXTRA_LETTERS) {
+         return(NO_LETTERS_LEFT);
+      }
+      strcpy(letters->letters[i], letter);
+      letters->count++;
+      *text = p;
+      return('Z' + 1 + i);
+   }
+
+
+int read_word(
+      const char  *text,
+      const char  *end,       // Where the word ends.
+      char        *word,      // Put its chars here, with a null after them.
+      int          add,       // 1 to give chars to letters not seen before.
+      alphabet    *letters    // The chars given out so far.
+   )
+   // Turn a word from UTF-8 into a char for each letter.  Returns the
+   // number of letters, MAX_LEN + 1 if there are more than MAX_LEN, or
+   // what read_letter returned for the first that isn't a letter or
+   // can't be given a char.
+   {
+      int  letter;
+      int  length = 0;
+
+
+      while(text < end) {
+         letter = read_letter(&text, end, add, letters);
+         if(letter <= 0) {
+            return(letter);
+         }
+         if(length == MAX_LEN) {
+            return(MAX_LEN + 1);
+         }
+         word[length++] = letter;
+      }
+      word[length] = '\0';
+      return(length);
+   }
+
+
+int write_word(
+      const char      *word,
+      char            *text,      // Room for WORD_TEXT_SIZE chars.
+      const alphabet  *letters    // The chars its letters were given.
+   )
+   // Write a word's letters in UTF-8 with a null after them.  Returns
+   // the number of bytes, not counting the null, like sprintf.
+   {
+      int  length = 0;
+
+
+      for(; *word != '\0'; word++) {
+         if(*word <= 'Z') {
+            text[length++] = *word;
+         } else {
+            strcpy(&text[length], letters->letters[*word - 'Z' - 1]);
+            length += strlen(&text[length]);
+         }
+      }
+      text[length] = '\0';
+      return(length);
+   }
 
 // Define this to 1 to print the estimated difficulty of solved
 // and found puzzles.  Define to 0 if you don't want the difficulty printed.
@@ -111,25 +525,239 @@ int max_of_two(int x, int y)
 #endif
 
 
+// A function that is given each solution found instead of it being
+// printed, with the letters in alphabetical order and the value of
+// each.  This is how the solver is used as a library.
+
+typedef void (*solution_visitor)(void *context, int letter_count,
+                                 const char *letters, const int *values);
+
+// A growing block of text.  This is used to hold solutions printed
+// by a thread so they can be printed in order once all of the threads
+// are done.  If visit isn't NULL, the solutions are given to it
+// instead.
+
+struct output_buffer {
+   char              *text;
+   int                length;
+   int                size;
+   solution_visitor   visit;
+   void              *context;   // Passed to visit.
+};
+
+
+void add_output_text(
+      output_buffer  *output,
+      const char     *text,
+      int             length
+   )
+   // Add the first length chars of text to the end of the output
+   // buffer.
+   {
+      char  *new_text;
+
+
+      if(output->length + length + 1 > output->size) {
+         output->size = (output->size + length + 1) * 2;
+         new_text = new char[output->size];
+         if(output->length) {
+            memcpy(new_text, output->text, output->length);
+         }
+         delete [] output->text;
+         output->text = new_text;
+      }
+      memcpy(output->text + output->length, text, length);
+      output->length += length;
+      output->text[output->length] = '\0';
+   }
+
+
+void add_output(
+      output_buffer  *output,
+      const char     *text
+   )
+   // Add a string to the end of the output buffer.
+   {
+      add_output_text(output, text, strlen(text));
+   }
+
+
+// Scratch memory for the solver.  The solver takes what it needs for
+// a puzzle by moving a pointer along a block, and gives it all back at
+// once when the puzzle is done, so once the block has grown big enough
+// nothing is allocated per puzzle.  Each thread has its own arena.
+// When a block runs out a bigger one replaces it, but the old one is
+// kept until everything is given back, since what was taken from it
+// may still be in use.  The first ARENA_ALIGN bytes of each block link
+// it to the block it replaced.
+
+const size_t ARENA_ALIGN = 16;
+const size_t MIN_ARENA_SIZE = 4096;
+
+struct solve_arena {
+   char    *block;      // The block being taken from.
+   size_t   size;       // The size of the block.
+   size_t   used;       // How much of the block has been taken.
+   char    *retired;    // Blocks that were replaced.
+};
+
+
+void init_arena(
+      solve_arena  *arena
+   )
+   // Start an empty arena.  Nothing is allocated until it is used.
+   {
+      arena->block = NULL;
+      arena->size = 0;
+      arena->used = 0;
+      arena->retired = NULL;
+   }
+
+
+void *arena_alloc(
+      solve_arena  *arena,
+      size_t        bytes
+   )
+   // Take bytes from the arena.  They stay good until the arena is
+   // released back to a mark taken before this.
+   {
+      char    *new_block;
+      size_t   new_size;
+      void    *result;
+
+
+      bytes = (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+      if(arena->used + bytes > arena->size) {
+         new_size = arena->size ? arena->size * 2 : MIN_ARENA_SIZE;
+         while(new_size < bytes + ARENA_ALIGN) {
+            new_size *= 2;
+         }
+         new_block = new char[new_size];
+         if(arena->block) {
+            *(char **) arena->block = arena->retired;
+            arena->retired = arena->block;
+         }
+         arena->block = new_block;
+         arena->size = new_size;
+         arena->used = ARENA_ALIGN;
+      }
+      result = arena->block + arena->used;
+      arena->used += bytes;
+      return(result);
+   }
+
+
+inline size_t arena_mark(
+      solve_arena  *arena
+   )
+   // Remember how much of the arena is in use.
+   {
+      return(arena->used);
+   }
+
+
+void arena_release(
+      solve_arena  *arena,
+      size_t        mark
+   )
+   // Give back everything taken from the arena since mark was taken.
+   // If that is everything, the blocks that were replaced are freed.
+   // A mark taken before the block was replaced may point past what
+   // is in use in the new block, which only wastes the space until
+   // everything is given back.
+   {
+      char  *next;
+
+
+      if(mark <= ARENA_ALIGN) {
+         while(arena->retired) {
+            next = *(char **) arena->retired;
+            delete [] arena->retired;
+            arena->retired = next;
+         }
+         mark = ARENA_ALIGN;
+      }
+      if(arena->block) {
+         arena->used = mark;
+      }
+   }
+
+
+void free_arena(
+      solve_arena  *arena
+   )
+   // Free all of the memory held by an arena.
+   {
+      arena_release(arena, 0);
+      delete [] arena->block;
+      init_arena(arena);
+   }
+
+
 void print_solution(
-      int  number_map[128],
-      int  map_count[128]
+      int             letter_count,  // The number of letters in the puzzle.
+      const char     *letters,       // The letter for each number.
+      const int      *values,        // The value for each number.
+      output_buffer  *output         // Where to put it.  NULL for stdout.
    )
    // Print the mappings for this solution.  The mappings will be in
-   // alphabetical order.
+   // alphabetical order.  If the output has a visitor, the solution is
+   // given to it instead.
    {
-      int i;
+      int   i, j;
+      char  letter[2] = {0, 0};
+      char  mapping[LETTER_SIZE + 16];
+      int   order[128];
+      char  sorted_letters[MAX_BASE];
+      int   sorted_values[MAX_BASE];
 
 
-      for(i = 0; i < 128; i++) {
+      // Sort the letter numbers by letter.  There are few enough that
+      // an insertion sort is fine.
+
+      for(i = 0; i < letter_count; i++) {
+         for(j = i; j > 0 && letters[order[j - 1]] > letters[i]; j--) {
+            order[j] = order[j - 1];
+         }
+         order[j] = i;
+      }
+      if(output && output->visit) {
+         for(i = 0; i < letter_count; i++) {
+            sorted_letters[i] = letters[order[i]];
+            sorted_values[i] = values[order[i]];
+         }
+         (*output->visit)(output->context, letter_count, sorted_letters,
+                          sorted_values);
+         return;
+      }
+      for(i = 0; i < letter_count; i++) {
+         j = order[i];
+         if(letters[j] <= 'Z') {
+            if(output) {
+               sprintf(mapping, "%c=%d ", letters[j], values[j]);
+               add_output(output, mapping);
+            } else {
+               printf("%c=%d ", letters[j], values[j]);
+            }
+            continue;
+         }
 
-         // Test map_count because number_map is not initialized.
+         // Only the letters other than A to Z are written out as UTF-8.
 
-         if(map_count[i]) {
-            printf("%c=%d ", (char) i, number_map[i]);
+         letter[0] = letters[j];
+         write_word(letter, mapping, &run_letters);
+         sprintf(&mapping[strlen(mapping)], "=%d ", values[j]);
+         if(output) {
+            add_output(output, mapping);
+         } else {
+            fputs(mapping, stdout);
          }
       }
-      printf("\n");
+      if(output) {
+         add_output(output, "\n");
+      } else {
+         printf("\n");
+      }
    }
 
 
@@ -154,225 +782,898 @@ int difficulty_conv(
    }
 
 
-// Macro to simulate multi-dimensional array reference.
-// Note that this can't be an inline because the array is internal to the
-// function.  Used only by the solve function.
+// Counters kept by each search so that it can be seen where a slow
+// puzzle spends its time without building with DEBUG_SOLVE_FLAG.
+// Every backtrack is counted under one of the four reasons, so they
+// add up to backtracks.  column_nodes counts the times the search
+// comes to a letter in each column, going forward or back, with
+// column 0 the leftmost column of the sum.  max_depth is the most
+// letters that had values at once.  The linear engines have no
+// columns, so they leave column_nodes at zero and count all of their
+// backtracks as empty ranges.  stopped_early is 1 if the search was
+// stopped at the number of solutions it was asked for, so that added
+// up it is the number of searches that were.  -find searches some of
+// those again without stopping, to see how many backtracks stopping
+// saved.  sampled_stops is how many, and sampled_saved the backtracks
+// the full searches had over the stopped ones.
+
+struct search_counters {
+   ulong  backtracks;
+   ulong  carry_infeasible;  // The carry needed into a column can't be made.
+   ulong  empty_range;       // No free digit left in a new letter's range.
+   ulong  previously_mapped; // Backed onto a letter set in an earlier column.
+   ulong  value_too_large;   // A letter set earlier doesn't fit its column.
+   ulong  column_nodes[MAX_LEN + 1];
+   int    max_depth;
+   ulong  stopped_early;
+   ulong  sampled_stops;
+   ulong  sampled_saved;
+};
+
+
+inline void clear_search_counters(
+      search_counters  *counters
+   )
+   {
+      memset(counters, 0, sizeof(*counters));
+   }
 
-#define summand_char(row, column) (reform_smnds[((row) << MAX_LEN_SHIFT) + \
-        (column)])
 
-int solve(
-      char **summands,        // An array of pointers to the summands.
-      int    summand_count,   // The number of summands.
-      int   *summand_lengths, // An array with the lengths o the summands.
-      int    longest_summand, // The number of chars in the longest summand.
-      char  *sum,             // The word representing the sum.
-      int    base,            // The base to solve the puzzle in.
-      int    print,           // 1 if results to be printed, 0 otherwise.
-      int    just_one,        // 1 if to leave after first solution.
-      int   *difficulty       // The difficulty on a scale of 1 to 10.
+void add_search_counters(
+      search_counters        *total,
+      const search_counters  *part
    )
-   // This function will find solutions to the given alphametic puzzle.
-   // It returns the number of solutions found.  If just_one is set to
-   // a non-zero value, the function will return after finding the first
-   // solution.  If print is set to a non-zero value, each solution found
-   // will be printed to stdout.
-   // I have written this to be as fast as possible because one of its
-   // intended uses is to check a huge number of potential puzzles for
-   // ones that have a solution.  Because searches of this kind can be
-   // very time consuming, even small efficiencies in this function are
-   // significant.  Because of this, all of the work is done is this one
-   // function, so it is very long.  I had previously written a recursive
-   // version of this that was more easily understandable, but it was
-   // significantly slower.
+   // Add the counters from one search, or one piece of a split search,
+   // to a total.
    {
-      int     allocated_smnds_array;
-      int     backtrack;
-      ulong   backtrack_count = 0;
-      char   *ch_p;
-      int     column;
-      int     column_lengths[MAX_LEN + 1];
-      char    curr_char;
-      int     curr_column;
-      int     curr_smnd_row;
-      int     i, j;
-      char    letter_map[MAX_BASE];
-      char    letter_used[128];
-      int     map_count[128];
-      int     min_possible;
-      int     min_value[128];
-      int     max;
-      int     max_carry[MAX_LEN + 1];
-      int     max_digit = base - 1;
-      int     max_possible;
-      int     max_value[128];
-      int     needed_carry[MAX_LEN];
-      int     needed_sum;
-      int     number_map[128];
-      char   *reform_smnds;
-      char    smnd_char;
-      int     solutions_found = 0;
-      char    static_summands[MAX_LEN * MAX_STATIC_SUMMANDS];
-      int     sum_length = 0;
-      int     total_letters_used = 0;
-      int     value;
-      int     zero_or_one_start[128];
+      int  i;
 
 
-      // Initialize in case of an error.
+      total->backtracks += part->backtracks;
+      total->carry_infeasible += part->carry_infeasible;
+      total->empty_range += part->empty_range;
+      total->previously_mapped += part->previously_mapped;
+      total->value_too_large += part->value_too_large;
+      for(i = 0; i <= MAX_LEN; i++) {
+         total->column_nodes[i] += part->column_nodes[i];
+      }
+      total->max_depth = max_of_two(total->max_depth, part->max_depth);
+      total->stopped_early += part->stopped_early;
+      total->sampled_stops += part->sampled_stops;
+      total->sampled_saved += part->sampled_saved;
+   }
 
-      *difficulty = 0;
 
-      // Figure out the length of the sum and at the same time count
-      // the different characters used in the sum.  We will later
-      // add to this count to find the number of different letters
-      // used in the whole puzzle.
+// The ways solve can go about its search.  They all find the same
+// solutions with the same number of backtracks.
 
-      memset(letter_used, 0, sizeof(letter_used));
-      for(ch_p = sum; *ch_p; ch_p++) {
-         if(letter_used[*ch_p] == 0) {
-            letter_used[*ch_p] = 1;
-            total_letters_used++;
-         }
-         sum_length++;
-      }
+const int ENGINE_SCAN = 0;    // Scan for a free digit one at a time.
+const int ENGINE_MASK = 1;    // Find a free digit from a bit mask.
+const int ENGINE_PROGRAM = 2; // Compile the puzzle into steps first.
+const int ENGINE_LINEAR = 3;  // Solve the puzzle as one equation.
+const int ENGINE_MEET = 4;    // The same with a meet in the middle table.
 
-      // See if any of the strings is too long.  If so print message
-      // and return zero.
+// Settings that choose how solve searches.  A NULL pointer to these
+// gets the default of each.
 
-      if(sum_length > MAX_LEN || longest_summand > MAX_LEN) {
-         printf("Words must all be %d characters or less.\n", MAX_LEN);
-         return(0);
-      }
+struct solve_settings {
+   int  engine;               // One of the ENGINE values.
+   int  specialize;           // 0 to always use the general search.
+   int  prune;                // 1 for the stronger pruning.
+   int  meet_memory;          // Megabytes for the meet in the middle table.
+};
 
-      // If a summand is longer than the sum, then there is no solution.
 
-      if(longest_summand > sum_length) {
-         return(0);
-      }
+// A set of digits or letters, one bit for each.  It is 64 bits so
+// that every digit of a base up to MAX_BASE has a bit.
 
-      // Initialize column lengths and needed_carry to 0.
+typedef ulonglong digit_mask;
 
-      memset(column_lengths, 0, sizeof(column_lengths));
-      memset(needed_carry, 0, sizeof(needed_carry));
+inline digit_mask digit_bit(
+      int  digit
+   )
+   {
+      return((digit_mask) 1 << digit);
+   }
 
-      // Initialize the array used to count mappings for each character.
+inline digit_mask all_digits(
+      int  base
+   )
+   // The mask with a bit set for each digit of the base.
+   {
+      return(~(digit_mask) 0 >> (64 - base));
+   }
 
-      memset(map_count, 0, sizeof(map_count));
 
-      // Initialize the lowest value for each character to be zero.  We
-      // later set those letters at the front of strings to one.
+// Count trailing zeros of a non-zero mask and count the bits set in a
+// mask.  These are one instruction on most processors.  On x86 the
+// compiler only uses the popcount instruction when it is told the
+// processor has one, as with -mpopcnt or -march=native, and otherwise
+// calls a library function, so then the bits are added up in place.
 
-      memset(zero_or_one_start, 0, sizeof(zero_or_one_start));
+#if defined(_MSC_VER)
+#include <intrin.h>
+inline int count_trailing_zeros(
+      digit_mask  bits
+   )
+   {
+      unsigned long  index;
 
-      // Because malloc is somewhat expensive, and this routine needs to
-      // be as fast as possible, only allocate this array if there are
-      // too many summands to fit in the array on the stack.  This one
-      // will hold MAX_STATIC_SUMMANDS.
-
-    //   if(summand_count <= MAX_STATIC_SUMMANDS) {
-         reform_smnds = static_summands;
-         allocated_smnds_array = 0;
-    //   } else {
-    //      reform_smnds = new char[MAX_LEN * summand_count];
-    //      allocated_smnds_array = 1;
-    //   }
-
-      // Zero the array used to map numbers to characters.
-
-      memset(letter_map, 0, sizeof(letter_map));
-
-      // Reformat summands.  We want the columns to match with the
-      // sum string, but we want all of the letters crammed up to
-      // the top rows.  For example:
-      //
-      //      I S      E N I S
-      //      I T        A I T
-      //    N O T   =>     O T
-      //  E A S Y          S Y
-      //      T O          T O
-      //
-      // We don't care what's in the other places since the
-      // column_lengths array keeps us from accessing a character
-      // that's not filled.
-      // While we're doing this, we note those characters at the
-      // front of the strings to insure that they can't be set
-      // to zero.  We also count the number of different characters
-      // in the puzzle.  We will use this to insure there aren't
-      // more characters than digits.
 
-      for(i = 0; i < summand_count; i++) {
-         for(j = 0; j < summand_lengths[i]; j++) {
-            column = sum_length - (summand_lengths[i] - j);
-            curr_char = summands[i][j];
-            summand_char(column_lengths[column], column) = curr_char;
-            column_lengths[column]++;
+      _BitScanForward64(&index, bits);
+      return((int) index);
+   }
+inline int count_bits(
+      digit_mask  bits
+   )
+   {
+      return((int) __popcnt64(bits));
+   }
+#else
+#define count_trailing_zeros(bits) __builtin_ctzll(bits)
+#if defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__))
+#define count_bits(bits) __builtin_popcountll(bits)
+#else
+inline int count_bits(
+      digit_mask  bits
+   )
+   {
+      bits -= (bits >> 1) & 0x5555555555555555ull;
+      bits = (bits & 0x3333333333333333ull) +
+             ((bits >> 2) & 0x3333333333333333ull);
+      bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+      return((int) ((bits * 0x0101010101010101ull) >> 56));
+   }
+#endif
+#endif
 
-            // Note which letters are used.
 
-            if(letter_used[curr_char] == 0) {
-               letter_used[curr_char] = 1;
-               total_letters_used++;
-            }
+inline int next_free_digit(
+      digit_mask  free_digits,  // A bit is set for each unused digit.
+      int         low,          // The smallest value wanted.
+      int         high          // The largest value wanted.
+   )
+   // Return the smallest unused digit from low to high.  If there
+   // isn't one, return a value larger than high.
+   {
+      digit_mask  candidates;
 
-            // If this is the first character in a string make sure it
-            // can never be set to zero.
 
-            if(j == 0) {
-               zero_or_one_start[curr_char] = 1;
-            }
-         }
+      if(low > high) {
+         return(low);
       }
+      candidates = free_digits & (~(digit_mask) 0 << low)
+                 & (~(digit_mask) 0 >> (63 - high));
+      return(candidates ? count_trailing_zeros(candidates) : high + 1);
+   }
 
-      // Note that the first letter of the sum also can't be a zero.
 
-      zero_or_one_start[sum[0]] = 1;
+// A search can be split up into independent pieces so that they can
+// be worked on by different threads.  The split is made at the start
+// of a column.  Each piece starts with the values chosen for all of the
+// letters in the columns to the left and the carry needed into the
+// column.  Only the letters with values are recorded.
+
+struct solve_split {
+   int   column;                   // The column to start at.
+   int   needed_carry;             // Carry needed into the column.
+   int   letter_count;             // Number of letters with values.
+   char  letters[MAX_BASE];        // The letters.
+   char  values[MAX_BASE];         // The value given to each.
+   int   map_counts[MAX_BASE];     // Times each letter has been used.
+};
+
+struct solve_split_list {
+   solve_split  *splits;
+   int           count;
+   int           size;
+   int           overflow;         // Set if there were more than size.
+};
+
+
+// What the search keeps for each letter of a puzzle.  Letters are
+// numbered from zero in the order the search first comes to them, so
+// the table for a puzzle of up to 16 letters fits in two cache lines
+// and is set up with a few stores instead of clearing an entry for
+// every character.
+
+struct solve_letter {
+   short           low;       // Smallest value it can take where it was set.
+   short           high;      // Largest value it can take where it was set.
+   unsigned short  count;     // Times it has been used so far in the search.
+   unsigned char   value;     // The value it has when count isn't zero.
+   unsigned char   leading;   // 1 if it starts a word so it can't be zero.
+};
+
+
+// A puzzle laid out in columns for the search.  The summands are
+// lined up with the right end of the sum and crammed up to the top
+// rows, and their letters are stored by number.  For example:
+//
+//      I S      E N I S
+//      I T        A I T
+//    N O T   =>     O T
+//  E A S Y          S Y
+//      T O          T O
+//
+// We don't care what's in the other places since the column_lengths
+// array keeps us from accessing a character that's not filled.
+// Summands are added and taken off one at a time, last on first off,
+// so when looking for puzzles that share all but their last summand
+// only the changed word has to be laid out again.  Letters are
+// numbered in the order they are added, the sum's first, so those a
+// summand added are the last ones and are taken off with it.  The
+// entries in letter_ids are -1 for every letter not in the puzzle.
+
+struct puzzle_layout {
+   int             base;
+   int             sum_length;
+   int             summand_count;
+   int             letter_count;
+   int             column_lengths[MAX_LEN + 1];
+   int             max_carry[MAX_LEN + 1];   // Largest carry out of each column.
+   unsigned char   sum_ids[MAX_LEN];         // The sum by letter number.
+   char            letters[MAX_BASE];        // The letter for each number.
+   unsigned short  leading[MAX_BASE];        // Number of words it starts.
+   short           added_by[MAX_BASE];       // Summand that added it.  -1 for the sum.
+   signed char     letter_ids[128];          // Number for each letter.
+   char           *smnds;                    // MAX_LEN entries for each summand row.
+};
 
-      // See if we have more letters than digits, in which case a
-      // solution is impossible.
 
-      if(total_letters_used > base) {
-        //  if(allocated_smnds_array) {
-        //     delete [] reform_smnds;
-        //  }
-         return(0);
-      }
+// Macro to simulate multi-dimensional array reference.
+// Note that this can't be an inline because the array is internal to the
+// function.  Used only by the solve function.
 
-      // Figure out what the maximum carry is from each column.
-      // Note that the max carry from a specific column can depend
-      // on the max carry on the column immediately to the right.
-      // We initialize the max carry of the column one past the
-      // last one to zero.
-      // There is one possible improvement here and that is to do
-      // some analysis of the letters in each column.  If they are
-      // different, then the highest total from that row is a bit
-      // less than the number of summands times the max digit.
-      // This improvement is probably more expensive than it's
-      // worth.
+#define summand_char(row, column) (reform_smnds[((row) << MAX_LEN_SHIFT) + \
+        (column)])
 
-      max_carry[sum_length] = 0;
-      for(i = sum_length - 1; i >= 0; i--) {
-         max_carry[i] = (max_digit * column_lengths[i] +
-                         max_carry[i + 1]) / base;
-      }
+
+void update_max_carry(
+      puzzle_layout  *layout,
+      int             first_changed   // The leftmost column that changed.
+   )
+   // Figure out what the maximum carry is from each column after the
+   // columns from first_changed to the right end have changed.  Note
+   // that the max carry from a specific column can depend on the max
+   // carry on the column immediately to the right, so the columns to
+   // the left of the change are redone until one comes out the same.
+   // There is one possible improvement here and that is to do
+   // some analysis of the letters in each column.  If they are
+   // different, then the highest total from that row is a bit
+   // less than the number of summands times the max digit.
+   // This is done by set_prune_bounds when -prune is given.
+   {
+      int  base = layout->base;
+      int  carry;
+      int  i;
+      int  max_digit = base - 1;
+
+
+      for(i = layout->sum_length - 1; i >= 0; i--) {
+         carry = (max_digit * layout->column_lengths[i] +
+                  layout->max_carry[i + 1]) / base;
+         if(i < first_changed && carry == layout->max_carry[i]) {
+            break;
+         }
+         layout->max_carry[i] = carry;
+      }
+   }
+
+
+void start_layout(
+      puzzle_layout  *layout,
+      char           *sum,      // The word representing the sum.
+      int             base      // The base to solve the puzzle in.
+   )
+   // Start laying out a puzzle with just its sum.  The sum can't be
+   // longer than MAX_LEN, so it can't have more letters than MAX_BASE.
+   // The letters left from the puzzle laid out before are taken out
+   // of letter_ids, so it has to be set up the first time to have -1
+   // for all of the letters that will be used.
+   {
+      int   i;
+      int   letter;
+
+
+      for(i = 0; i < layout->letter_count; i++) {
+         layout->letter_ids[(int) layout->letters[i]] = -1;
+      }
+      layout->base = base;
+      layout->summand_count = 0;
+      layout->letter_count = 0;
+      layout->sum_length = strlen(sum);
+      for(i = 0; i < layout->sum_length; i++) {
+         letter = layout->letter_ids[(int) sum[i]];
+         if(letter < 0) {
+            letter = layout->letter_count++;
+            layout->letter_ids[(int) sum[i]] = letter;
+            layout->letters[letter] = sum[i];
+            layout->leading[letter] = 0;
+            layout->added_by[letter] = -1;
+         }
+         layout->sum_ids[i] = letter;
+         layout->column_lengths[i] = 0;
+         layout->max_carry[i] = 0;
+      }
+      layout->column_lengths[layout->sum_length] = 0;
+      layout->max_carry[layout->sum_length] = 0;
+
+      // The first letter of the sum can't be a zero.
+
+      layout->leading[layout->sum_ids[0]]++;
+   }
+
+
+void drop_added_letters(
+      puzzle_layout  *layout
+   )
+   // Take out the letters added by the summand after the last one.
+   {
+      int  letter;
+
+
+      while(layout->letter_count > 0 &&
+            layout->added_by[layout->letter_count - 1] ==
+                                                layout->summand_count) {
+         letter = --layout->letter_count;
+         layout->letter_ids[(int) layout->letters[letter]] = -1;
+      }
+   }
+
+
+int push_summand(
+      puzzle_layout  *layout,
+      char           *word,     // The summand to add.
+      int             length    // Its length.  No more than the sum's.
+   )
+   // Add a summand to the bottom of the layout.  Returns 0 and leaves
+   // the layout as it was if that would make more letters than digits,
+   // in which case a solution is impossible.  There must be room in
+   // smnds for another row.
+   {
+      int    column;
+      int    i;
+      int    letter;
+      char  *reform_smnds = layout->smnds;
+      int    sum_length = layout->sum_length;
+
+
+      // Number the letters not seen before.
+
+      for(i = 0; i < length; i++) {
+         if(layout->letter_ids[(int) word[i]] < 0) {
+            if(layout->letter_count == layout->base) {
+               drop_added_letters(layout);
+               return(0);
+            }
+            letter = layout->letter_count++;
+            layout->letter_ids[(int) word[i]] = letter;
+            layout->letters[letter] = word[i];
+            layout->leading[letter] = 0;
+            layout->added_by[letter] = layout->summand_count;
+         }
+      }
+
+      // Put the letters at the bottom of their columns.  The first
+      // letter of the word can never be set to zero.
+
+      for(i = 0; i < length; i++) {
+         column = sum_length - (length - i);
+         summand_char(layout->column_lengths[column], column) =
+                                              layout->letter_ids[(int) word[i]];
+         layout->column_lengths[column]++;
+      }
+      layout->leading[layout->letter_ids[(int) word[0]]]++;
+      layout->summand_count++;
+      update_max_carry(layout, sum_length - length);
+      return(1);
+   }
+
+
+void pop_summand(
+      puzzle_layout  *layout,
+      char           *word,     // The summand added last.
+      int             length    // Its length.
+   )
+   // Take the last summand added back off of the layout.
+   {
+      int  i;
+      int  sum_length = layout->sum_length;
+
+
+      layout->leading[layout->letter_ids[(int) word[0]]]--;
+      for(i = 0; i < length; i++) {
+         layout->column_lengths[sum_length - (length - i)]--;
+      }
+      layout->summand_count--;
+      drop_added_letters(layout);
+      update_max_carry(layout, sum_length - length);
+   }
+
+
+int lay_out_puzzle(
+      puzzle_layout  *layout,          // Its smnds must be big enough.
+      char          **summands,        // An array of pointers to the summands.
+      int             summand_count,   // The number of summands.
+      int            *summand_lengths, // An array with the lengths of the summands.
+      char           *sum,             // The word representing the sum.
+      int             base             // The base to solve the puzzle in.
+   )
+   // Lay out a whole puzzle at once.  The words must already have been
+   // checked to be no longer than MAX_LEN, and the summands to be no
+   // longer than the sum.  Returns 0 if there are more letters than
+   // digits, so that a solution is impossible.
+   {
+      int  i, j;
+
+
+      // Only the entries in letter_ids for the letters in the puzzle
+      // are ever looked at, so only those are cleared.
+
+      for(i = 0; sum[i]; i++) {
+         layout->letter_ids[(int) sum[i]] = -1;
+      }
+      for(i = 0; i < summand_count; i++) {
+         for(j = 0; j < summand_lengths[i]; j++) {
+            layout->letter_ids[(int) summands[i][j]] = -1;
+         }
+      }
+      layout->letter_count = 0;
+      start_layout(layout, sum, base);
+      if(layout->letter_count > base) {
+         return(0);
+      }
+      for(i = 0; i < summand_count; i++) {
+         if(!push_summand(layout, summands[i], summand_lengths[i])) {
+            return(0);
+         }
+      }
+      return(1);
+   }
+
+
+// Stronger pruning for the column search, used when it is asked for
+// with -prune.  It cuts the search down but costs more at each step,
+// so whether it pays depends on the puzzle.  There are four parts:
+//   The most and least each column's summands can add up to take into
+//   account that different letters must have different digits.
+//   With these, there is a smallest as well as a largest carry out of
+//   each column, and a needed carry outside of them is a dead end.
+//   When a letter is given a value, its range comes from the values
+//   of the other letters in its column that have been set so far and
+//   the free digits that are left for the ones that haven't.
+//   When a letter also appears in a column to the right, and that
+//   column and all of those to its right have all of their letters
+//   set, each has to add up to its sum letter, modulo the base.
+
+struct prune_bounds {
+   int  min_carry[MAX_LEN + 1];   // Smallest carry out of each column.
+   int  max_carry[MAX_LEN + 1];   // Largest carry out of each column.
+   int  last_column[MAX_BASE];    // Rightmost column each letter is in.
+};
+
+
+inline long long floor_div(
+      long long  x,
+      long long  y     // Must be positive.
+   )
+   // Divide rounding down, even for negative x.
+   {
+      return((x >= 0) ? x / y : -((-x + y - 1) / y));
+   }
+
+
+void count_column_letters(
+      puzzle_layout  *layout,
+      int             column,
+      int             rows,        // Look at the summand rows above this.
+      int             letter,      // Count this letter in same.  -1 for none.
+      solve_letter   *state,       // The letters as the search has set them.
+      int            *fixed,       // Return the sum of those already set.
+      int            *same,        // Return how many are letter.
+      int            *counts,      // Return how many times each other is used.
+      int            *count_total  // Return how many there are in counts.
+   )
+   // Go through the summand letters in a column from row zero up to
+   // rows, sorting them into those set, those that are letter, and
+   // those that still need values.  counts is sorted largest first.
+   // If state is NULL, none of them are set.
+   {
+      int    i, j;
+      int    other;
+      char  *reform_smnds = layout->smnds;
+      int    row;
+      int    times[MAX_BASE];
+      int    used[MAX_BASE];
+
+
+      *fixed = 0;
+      *same = 0;
+      *count_total = 0;
+      for(row = 0; row < rows; row++) {
+         other = summand_char(row, column);
+         if(other == letter) {
+            (*same)++;
+         } else if(state && state[other].count) {
+            *fixed += state[other].value;
+         } else {
+            for(i = 0; i < *count_total && used[i] != other; i++) {
+            }
+            if(i == *count_total) {
+               used[i] = other;
+               times[i] = 0;
+               (*count_total)++;
+            }
+            times[i]++;
+         }
+      }
+      for(i = 0; i < *count_total; i++) {
+         for(j = i; j > 0 && counts[j - 1] < times[i]; j--) {
+            counts[j] = counts[j - 1];
+         }
+         counts[j] = times[i];
+      }
+   }
+
+
+void free_digit_range(
+      digit_mask     free_digits,  // A bit is set for each unused digit.
+      int            base,
+      int           *counts,       // How many times each letter is used.
+      int            count_total,
+      int           *low,          // Return the least they can add up to.
+      int           *high          // Return the most they can add up to.
+   )
+   // Find the least and most that letters used the given number of
+   // times can add up to when each gets a different free digit.  The
+   // letter used most gets the smallest digit for the least and the
+   // largest for the most.
+   {
+      int           digit;
+      int           i;
+      digit_mask    left;
+
+
+      *low = 0;
+      left = free_digits;
+      for(i = 0; i < count_total && left; i++) {
+         digit = count_trailing_zeros(left);
+         left &= ~digit_bit(digit);
+         *low += counts[i] * digit;
+      }
+      *high = 0;
+      left = free_digits;
+      digit = base - 1;
+      for(i = 0; i < count_total; i++) {
+         while(digit >= 0 && !(left & digit_bit(digit))) {
+            digit--;
+         }
+         if(digit < 0) {
+            break;
+         }
+         left &= ~digit_bit(digit);
+         *high += counts[i] * digit;
+      }
+   }
+
+
+void set_prune_bounds(
+      puzzle_layout  *layout,
+      prune_bounds   *bounds
+   )
+   // Work out the smallest and largest carry out of each column when
+   // the letters in it have to have different digits, and the last
+   // column each letter is in.
+   {
+      int  column;
+      int  count_total;
+      int  counts[MAX_BASE];
+      int  fixed;
+      int  high;
+      int  i;
+      int  low;
+      int  row;
+      int  same;
+
+
+      for(i = 0; i < layout->letter_count; i++) {
+         bounds->last_column[i] = -1;
+      }
+      bounds->min_carry[layout->sum_length] = 0;
+      bounds->max_carry[layout->sum_length] = 0;
+      for(column = layout->sum_length - 1; column >= 0; column--) {
+         count_column_letters(layout, column, layout->column_lengths[column],
+                              -1, NULL, &fixed, &same, counts,
+                              &count_total);
+         free_digit_range(all_digits(layout->base), layout->base, counts,
+                          count_total, &low, &high);
+         bounds->min_carry[column] = (low + bounds->min_carry[column + 1]) /
+                                     layout->base;
+         bounds->max_carry[column] = (high + bounds->max_carry[column + 1]) /
+                                     layout->base;
+      }
+      for(column = 0; column < layout->sum_length; column++) {
+         bounds->last_column[layout->sum_ids[column]] = column;
+         for(row = 0; row < layout->column_lengths[column]; row++) {
+            bounds->last_column[(int) layout->smnds[(row << MAX_LEN_SHIFT) +
+                                              column]] = column;
+         }
+      }
+   }
+
+
+int prune_range(
+      puzzle_layout  *layout,
+      prune_bounds   *bounds,
+      solve_letter   *state,
+      digit_mask      free_digits,  // A bit is set for each unused digit.
+      int             column,
+      int             rows,         // The summand rows that are left.
+      int             letter,       // The letter to find a range for.
+      int             sum_letter,   // 1 if letter is the column's sum.
+      int             total,        // What the rows and carry must make.
+      short          *low,          // Narrowed to the range.
+      short          *high
+   )
+   // Narrow the range of values for a letter being set for the first
+   // time.  If it is a summand, the rows above it, the carry in, and
+   // it must add up to total.  If it is the sum letter, total is the
+   // base times the carry out, and all of the rows and the carry in
+   // must add up to that plus the letter.  Returns 0 if there is no
+   // value that can work.
+   {
+      int  coefficient;
+      int  count_total;
+      int  counts[MAX_BASE];
+      int  fixed;
+      int  most;
+      int  least;
+      int  same;
+      int  spare_high;
+      int  spare_low;
+
+
+      count_column_letters(layout, column, rows, letter, state, &fixed,
+                           &same, counts, &count_total);
+      free_digit_range(free_digits, layout->base, counts, count_total,
+                       &spare_low, &spare_high);
+      least = fixed + spare_low + bounds->min_carry[column + 1];
+      most = fixed + spare_high + bounds->max_carry[column + 1];
+
+      // The letter times coefficient plus the rest must be total.
+
+      coefficient = sum_letter ? same - 1 : same + 1;
+      if(coefficient > 0) {
+         *low = max_of_two(*low, -floor_div(most - total, coefficient));
+         *high = min_of_two(*high, floor_div(total - least, coefficient));
+      } else if(coefficient < 0) {
+         *low = max_of_two(*low, -floor_div(total - least, -coefficient));
+         *high = min_of_two(*high, floor_div(most - total, -coefficient));
+      } else if(total < least || total > most) {
+         return(0);
+      }
+      return(*low <= *high);
+   }
+
+
+int prune_check(
+      puzzle_layout  *layout,
+      prune_bounds   *bounds,
+      solve_letter   *state,
+      digit_mask      free_digits,  // A bit is set for each unused digit.
+      int             column,
+      int             rows,         // The summand rows that are left.
+      int             total         // What they and the carry must make.
+   )
+   // See if the summand rows above rows in a column and the carry in
+   // can add up to total, given the letters set so far.
+   {
+      int  count_total;
+      int  counts[MAX_BASE];
+      int  fixed;
+      int  same;
+      int  spare_high;
+      int  spare_low;
+
+
+      count_column_letters(layout, column, rows, -1, state, &fixed, &same,
+                           counts, &count_total);
+      free_digit_range(free_digits, layout->base, counts, count_total,
+                       &spare_low, &spare_high);
+      return(total >= fixed + spare_low + bounds->min_carry[column + 1] &&
+             total <= fixed + spare_high + bounds->max_carry[column + 1]);
+   }
+
+
+int suffix_fits(
+      puzzle_layout  *layout,
+      prune_bounds   *bounds,
+      solve_letter   *state,
+      int             column,   // The column being searched.
+      int             letter,   // A letter being given a value.
+      int             value     // The value it is being given.
+   )
+   // See if the columns at the right end that have all of their
+   // letters set still add up once letter is value.  Returns 0 if one
+   // doesn't.
+   {
+      int    carry = 0;
+      int    check;
+      int    other;
+      char  *reform_smnds = layout->smnds;
+      int    row;
+      int    total;
+
+
+      if(bounds->last_column[letter] <= column) {
+         return(1);
+      }
+      for(check = layout->sum_length - 1; check > column; check--) {
+         total = carry;
+         for(row = 0; row < layout->column_lengths[check]; row++) {
+            other = summand_char(row, check);
+            if(other == letter) {
+               total += value;
+            } else if(state[other].count) {
+               total += state[other].value;
+            } else {
+               return(1);
+            }
+         }
+         other = layout->sum_ids[check];
+         if(other == letter) {
+            if(total % layout->base != value) {
+               return(0);
+            }
+         } else if(!state[other].count) {
+            return(1);
+         } else if(total % layout->base != state[other].value) {
+            return(0);
+         }
+         carry = total / layout->base;
+      }
+      return(1);
+   }
+
+
+template<int BASE, int USE_MASK, int PRUNE>
+int search_columns(
+      puzzle_layout      *layout,          // The puzzle to solve.
+      int                 print,           // 1 if results to be printed, 0 otherwise.
+      int                 stop_after,      // Stop after this many solutions.  0 for all.
+      solve_split        *start,           // Piece to solve.  NULL for all of it.
+      int                 split_column,    // Column to split at.  0 to not split.
+      solve_split_list   *splits,          // Where to put the pieces split off.
+      output_buffer      *output,          // Where to print.  NULL for stdout.
+      search_counters    *counters,        // Return the search's counters here.
+      int                *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // This function will find solutions to an alphametic puzzle that
+   // has been laid out in columns.  It returns the number of solutions
+   // found.  If stop_after isn't 0, the function will return after
+   // finding that many solutions.  If print is set to a
+   // non-zero value, each solution found will be printed to stdout.
+   // The search can also be split up so that threads can work on it.
+   // If split_column is set, then instead of going on to that column,
+   // the search records the letter values and needed carry in splits
+   // and backtracks.  Each of these can then be solved on its own by
+   // passing it as start.  The search of a piece begins at its column
+   // and stops when it backtracks out of that column, so the backtrack
+   // counts of the split search and of all of its pieces add up to the
+   // backtrack count of the whole search.
+   // This is a template so that the two ways of finding a free digit
+   // each get their own copy of the search loop.  When USE_MASK is 0,
+   // digit_used is scanned for the next digit without a letter.  When
+   // it is 1, the free digits are kept as bits in free_digits and the
+   // next one in range is found in one step.  Both try the same values
+   // in the same order, so they find the same solutions with the same
+   // number of backtracks.
+   // When PRUNE is 1, the search also uses the stronger pruning of
+   // set_prune_bounds and prune_range.  It only works with USE_MASK
+   // set.  The solutions are the same, but fewer values are tried.
+   // BASE lets the compiler build copies of the search for a specific
+   // base.  When it isn't zero, the layout's base must match it and
+   // is replaced by the constant, so that the arithmetic with base
+   // turns into constants and shifts.
+   // I have written this to be as fast as possible because one of its
+   // intended uses is to check a huge number of potential puzzles for
+   // ones that have a solution.  Because searches of this kind can be
+   // very time consuming, even small efficiencies in this function are
+   // significant.  Because of this, all of the work is done is this one
+   // function, so it is very long.  I had previously written a recursive
+   // version of this that was more easily understandable, but it was
+   // significantly slower.
+   {
+      int     backtrack;
+      ulong   backtrack_count = 0;
+      int     base = BASE ? BASE : layout->base;
+      int    *column_lengths = layout->column_lengths;
+      int     curr_column;
+      ulong   carry_infeasible = 0;
+      ulong   column_nodes[MAX_LEN + 1];
+      int     curr_smnd_row;
+      int     depth;
+      ulong   empty_range = 0;
+      int     max_depth = 0;
+      ulong   previously_mapped = 0;
+      ulong   value_too_large = 0;
+      char    digit_used[MAX_BASE];
+      digit_mask free_digits;
+      int     i;
+      int     letter;
+      int     letter_count = layout->letter_count;
+      char   *letters = layout->letters;
+      int     min_possible;
+      int    *max_carry = layout->max_carry;
+      int     max_digit = base - 1;
+      int     max_possible;
+      int     needed_carry[MAX_LEN + 1];
+      int     needed_sum = 0;
+      prune_bounds bounds;
+      char   *reform_smnds = layout->smnds;
+      solve_split *split;
+      int     solutions_found = 0;
+      int     start_column;
+      solve_letter state[MAX_BASE];
+      int     stop_column;
+      unsigned char *sum_ids = layout->sum_ids;
+      int     sum_length = layout->sum_length;
+      int     value;
+      int     values[MAX_BASE];
+
+
+      // Initialize in case of an error.
+
+      *difficulty = 0;
+      clear_search_counters(counters);
+
+      // Initialize needed_carry to 0, and the letters to have no
+      // values yet.
+
+      memset(needed_carry, 0, sizeof(needed_carry));
+      memset(column_nodes, 0, sizeof(column_nodes));
+      for(i = 0; i < letter_count; i++) {
+         state[i].count = 0;
+         state[i].leading = (layout->leading[i] != 0);
+      }
+
+      // Zero the array that marks the digits in use.  The mask engine
+      // keeps a bit for each digit that is still free instead.
+
+      memset(digit_used, 0, sizeof(digit_used));
+      free_digits = all_digits(base);
+
+      // The stronger pruning has its own carry limits.
+
+      if(PRUNE) {
+         set_prune_bounds(layout, &bounds);
+         max_carry = bounds.max_carry;
+      }
 
       // When debugging, print out the summands in their new form.
 
       DBG_SOLVE(
-         for(i = 0; i < summand_count; i++) {
+         int j;
+
+         for(i = 0; i < layout->summand_count; i++) {
             for(j = 0; j < MAX_LEN; j++) {
               if(i < column_lengths[j]) {
-                 printf("%c", summand_char(i, j));
+                 printf("%c", letters[summand_char(i, j)]);
               } else {
                  printf(" ");
               }
             }
             printf("\n");
          }
-         for(i = 0; i < strlen(sum); i++) {
+         for(i = 0; i < sum_length; i++) {
             printf("-");
          }
-         printf("\n%s\n", sum);
+         printf("\n");
+         for(i = 0; i < sum_length; i++) {
+            printf("%c", letters[sum_ids[i]]);
+         }
+         printf("\n");
       );
 
       // Now all of the initialization is done and it is time to start
@@ -387,15 +1688,66 @@ int solve(
       // dead end, we backtrack to the previous character.
 
       // We start with column 0 and the first move isn't a backtrack.
+      // If we are solving a piece of a split search, we start with
+      // its column instead and fill in the values already chosen.
+
+      if(start) {
+         for(i = 0; i < start->letter_count; i++) {
+            letter = layout->letter_ids[(int) start->letters[i]];
+            state[letter].value = start->values[i];
+            state[letter].count = start->map_counts[i];
+            digit_used[(int) start->values[i]] = 1;
+            free_digits &= ~digit_bit(start->values[i]);
+         }
+         start_column = start->column;
+         needed_carry[start_column] = start->needed_carry;
+         depth = start->letter_count;
+      } else {
+         start_column = 0;
+         depth = 0;
+      }
+      stop_column = (split_column > 0) ? split_column : sum_length;
 
-      curr_column = 0;
+      curr_column = start_column;
       backtrack = 0;
 
       while(1) {
 
+         // See if we've come to the column where we split the search.
+         // Record a piece to solve later, then backtrack as if it had
+         // been searched.
+
+         if(curr_column == stop_column && stop_column != sum_length) {
+
+            if(splits->count == splits->size) {
+               splits->overflow = 1;
+               return(0);
+            }
+            split = &splits->splits[splits->count++];
+            split->column = curr_column;
+            split->needed_carry = needed_carry[curr_column];
+            split->letter_count = 0;
+            for(i = 0; i < letter_count; i++) {
+               if(state[i].count) {
+                  split->letters[split->letter_count] = letters[i];
+                  split->values[split->letter_count] = state[i].value;
+                  split->map_counts[split->letter_count] = state[i].count;
+                  split->letter_count++;
+               }
+            }
+
+            needed_sum = needed_carry[curr_column];
+            curr_column--;
+            if(column_lengths[curr_column] == 0) {
+               curr_smnd_row = -1;
+            } else {
+               curr_smnd_row = 0;
+            }
+            backtrack = 1;
+
          // See if we've found a solution
 
-         if(curr_column == sum_length) {
+         } else if(curr_column == sum_length) {
 
             // This is only a solution if the needed carry here is zero.
             // Even if it isn't we need to backtrack from here.
@@ -407,17 +1759,16 @@ int solve(
 
                solutions_found++;
                if(print) {
-                  print_solution(number_map, map_count);
+                  for(i = 0; i < letter_count; i++) {
+                     values[i] = state[i].value;
+                  }
+                  print_solution(letter_count, letters, values, output);
                }
 
-               // If we just wanted to see if there were any solutions,
-               // return right now.
+               // If we've found as many as were wanted, stop here.
 
-               if(just_one) {
-                //   if(allocated_smnds_array) {
-                //      delete [] reform_smnds;
-                //   }
-                  return(1);
+               if(solutions_found == stop_after) {
+                  break;
                }
             }
 
@@ -426,7 +1777,6 @@ int solve(
             curr_column--;
             curr_smnd_row = 0;
             backtrack = 1;
-            smnd_char = summand_char(curr_smnd_row, curr_column);
 
             // We want to skip looking at the sum character in this column
             // because there isn't one.
@@ -447,7 +1797,8 @@ int solve(
             // investigate the values of the summands above, or we'll
             // backtrack again.
 
-            curr_char = sum[curr_column];
+            letter = sum_ids[curr_column];
+            column_nodes[curr_column]++;
 
             DBG_SOLVE(
                if(backtrack) {
@@ -455,7 +1806,7 @@ int solve(
                } else {
                   printf("Forward");
                }
-               printf(" to sum char %c(%d)...", curr_char, curr_column);
+               printf(" to sum char %c(%d)...", letters[letter], curr_column);
             );
 
             if(backtrack) {
@@ -463,27 +1814,41 @@ int solve(
                // We got here by backtracking, so we assigned this character a
                // value the last time through.
 
-               if(map_count[curr_char] == 1) {
+               if(state[letter].count == 1) {
 
                   // This was the first occurance of this character.  Since
                   // we've backtracked to here, try to find the next available
                   // number in the range.
 
-                  value = number_map[curr_char];
-                  letter_map[value] = '\0';
-                  do {
-                     value++;
-                  } while(value <= max_value[curr_char] &&
-                          letter_map[value] != '\0');
+                  value = state[letter].value;
+                  if(USE_MASK) {
+                     free_digits |= digit_bit(value);
+                     value = next_free_digit(free_digits, value + 1,
+                                             state[letter].high);
+                     while(PRUNE && value <= state[letter].high &&
+                           !suffix_fits(layout, &bounds, state, curr_column,
+                                        letter, value)) {
+                        value = next_free_digit(free_digits, value + 1,
+                                                state[letter].high);
+                     }
+                  } else {
+                     digit_used[value] = 0;
+                     do {
+                        value++;
+                     } while(value <= state[letter].high &&
+                             digit_used[value]);
+                  }
 
-                  if(value > max_value[curr_char]) {
+                  if(value > state[letter].high) {
 
                      // We didn't find an available number in the range so
                      // we want to backtrack from here.
 
                      backtrack = 1;
                      backtrack_count++;
-                     map_count[curr_char]--;
+                     empty_range++;
+                     state[letter].count--;
+                     depth--;
 
                      DBG_SOLVE(
                         printf("no more values in range.\n");
@@ -496,8 +1861,12 @@ int solve(
                      // another.
 
                      backtrack = 0;
-                     letter_map[value] = curr_char;
-                     number_map[curr_char] = value;
+                     if(USE_MASK) {
+                        free_digits &= ~digit_bit(value);
+                     } else {
+                        digit_used[value] = 1;
+                     }
+                     state[letter].value = value;
 
                      DBG_SOLVE(
                         printf("next value in range: %d\n", value);
@@ -514,7 +1883,8 @@ int solve(
 
                   backtrack = 1;
                   backtrack_count++;
-                  map_count[curr_char]--;
+                  previously_mapped++;
+                  state[letter].count--;
 
                   DBG_SOLVE(
                      printf("previously mapped character.\n");
@@ -525,12 +1895,15 @@ int solve(
 
                // Here, we've moved forward to this sum character.
 
-               if(needed_carry[curr_column] > max_carry[curr_column]) {
+               if(needed_carry[curr_column] > max_carry[curr_column] ||
+                  (PRUNE &&
+                   needed_carry[curr_column] < bounds.min_carry[curr_column])) {
 
                   // Since we can't possibly get a carry this large, backtrack.
 
                   backtrack = 1;
                   backtrack_count++;
+                  carry_infeasible++;
 
                   DBG_SOLVE(
                      printf("none available %d > %d.\n", needed_carry[curr_column], max_carry[curr_column]);
@@ -538,13 +1911,22 @@ int solve(
 
                } else {
 
-                  if(map_count[curr_char]) {
+                  if(state[letter].count) {
 
                      // A value has already been chosen for this character.  Use
                      // it and move on.
 
-                     value = number_map[curr_char];
-                     map_count[curr_char]++;
+                     value = state[letter].value;
+                     if(PRUNE &&
+                        !prune_check(layout, &bounds, state, free_digits,
+                                     curr_column, column_lengths[curr_column],
+                                     value + base * needed_carry[curr_column])) {
+                        backtrack = 1;
+                        backtrack_count++;
+                        value_too_large++;
+                     } else {
+                        state[letter].count++;
+                     }
 
                      DBG_SOLVE(
                         printf("previously chosen value %d\n", value);
@@ -564,32 +1946,54 @@ int solve(
                      // from the next column minus the needed carry times
                      // the base here.
 
-                     min_value[curr_char] = zero_or_one_start[curr_char];
+                     state[letter].low = state[letter].leading;
                      max_possible = max_carry[curr_column + 1] +
                                     max_digit * column_lengths[curr_column] -
                                     needed_carry[curr_column] * base;
-                     max_value[curr_char] = min_of_two(max_digit, max_possible);
+                     state[letter].high = min_of_two(max_digit, max_possible);
+                     if(PRUNE &&
+                        !prune_range(layout, &bounds, state, free_digits,
+                                     curr_column, column_lengths[curr_column],
+                                     letter, 1,
+                                     base * needed_carry[curr_column],
+                                     &state[letter].low,
+                                     &state[letter].high)) {
+                        state[letter].high = state[letter].low - 1;
+                     }
 
                      DBG_SOLVE(
-                        printf("range chosen [%d-%d] ", min_value[curr_char], max_value[curr_char]);
+                        printf("range chosen [%d-%d] ", state[letter].low, state[letter].high);
                      );
 
                      // Find the first available value in this range.  If there
                      // aren't any available, then we will backtrack.
 
-                     value = min_value[curr_char];
-                     while(value <= max_value[curr_char] &&
-                           letter_map[value] != '\0') {
-                        value++;
+                     if(USE_MASK) {
+                        value = next_free_digit(free_digits,
+                                                state[letter].low,
+                                                state[letter].high);
+                        while(PRUNE && value <= state[letter].high &&
+                              !suffix_fits(layout, &bounds, state,
+                                           curr_column, letter, value)) {
+                           value = next_free_digit(free_digits, value + 1,
+                                                   state[letter].high);
+                        }
+                     } else {
+                        value = state[letter].low;
+                        while(value <= state[letter].high &&
+                              digit_used[value]) {
+                           value++;
+                        }
                      }
 
-                     if(value > max_value[curr_char]) {
+                     if(value > state[letter].high) {
 
                         // We didn't find an available number in the range so
                         // we want to backtrack from here.
 
                         backtrack = 1;
                         backtrack_count++;
+                        empty_range++;
 
                         DBG_SOLVE(
                            printf("none available.\n");
@@ -598,9 +2002,16 @@ int solve(
                      } else {
 
                         backtrack = 0;
-                        map_count[curr_char]++;
-                        letter_map[value] = curr_char;
-                        number_map[curr_char] = value;
+                        state[letter].count++;
+                        if(++depth > max_depth) {
+                           max_depth = depth;
+                        }
+                        if(USE_MASK) {
+                           free_digits &= ~digit_bit(value);
+                        } else {
+                           digit_used[value] = 1;
+                        }
+                        state[letter].value = value;
 
                         DBG_SOLVE(
                            printf("using %d\n", value);
@@ -671,9 +2082,10 @@ int solve(
          // the carry from the next column.
 
          // First check if we've backtracked off the left end, in which
-         // case we've checked all possibilities.
+         // case we've checked all possibilities.  When solving a piece
+         // of a split search, its first column is the left end.
 
-         if(curr_column == -1) {
+         if(curr_column < start_column) {
             break;
          }
 
@@ -682,7 +2094,8 @@ int solve(
 
          while(curr_smnd_row >= 0) {
 
-            curr_char = summand_char(curr_smnd_row, curr_column);
+            letter = summand_char(curr_smnd_row, curr_column);
+            column_nodes[curr_column]++;
 
             DBG_SOLVE(
                if(backtrack) {
@@ -690,7 +2103,7 @@ int solve(
                } else {
                   printf("Forward");
                }
-               printf(" to summand char %c(%d)...", curr_char, curr_column);
+               printf(" to summand char %c(%d)...", letters[letter], curr_column);
             );
 
             // We need to see whether we came to the current character
@@ -700,31 +2113,45 @@ int solve(
 
                // We backtracked here.
 
-               if(map_count[curr_char] == 1) {
+               if(state[letter].count == 1) {
 
                   // This was the first occurance of this character.  Since
                   // we've backtracked to here, try to find the next available
                   // number in the range.
 
-                  value = number_map[curr_char];
+                  value = state[letter].value;
                   needed_sum += value;
                   DBG_SOLVE(
-                     printf("First Occurrance of %c needed_sum=%d increment by %d...",curr_char, needed_sum, value);
+                     printf("First Occurrance of %c needed_sum=%d increment by %d...",letters[letter], needed_sum, value);
                   );                  
-                  letter_map[value] = '\0';
-                  do {
-                     value++;
-                  } while(value <= max_value[curr_char] &&
-                          letter_map[value] != '\0');
+                  if(USE_MASK) {
+                     free_digits |= digit_bit(value);
+                     value = next_free_digit(free_digits, value + 1,
+                                             state[letter].high);
+                     while(PRUNE && value <= state[letter].high &&
+                           !suffix_fits(layout, &bounds, state, curr_column,
+                                        letter, value)) {
+                        value = next_free_digit(free_digits, value + 1,
+                                                state[letter].high);
+                     }
+                  } else {
+                     digit_used[value] = 0;
+                     do {
+                        value++;
+                     } while(value <= state[letter].high &&
+                             digit_used[value]);
+                  }
 
-                  if(value > max_value[curr_char]) {
+                  if(value > state[letter].high) {
 
                      // We didn't find an available number in the range so
                      // we want to backtrack from here.
 
                      backtrack = 1;
                      backtrack_count++;
-                     map_count[curr_char]--;
+                     empty_range++;
+                     state[letter].count--;
+                     depth--;
 
                      DBG_SOLVE(
                         printf("no more values in range.\n");
@@ -735,8 +2162,12 @@ int solve(
                      // Go forward with this new value.
 
                      backtrack = 0;
-                     letter_map[value] = curr_char;
-                     number_map[curr_char] = value;
+                     if(USE_MASK) {
+                        free_digits &= ~digit_bit(value);
+                     } else {
+                        digit_used[value] = 1;
+                     }
+                     state[letter].value = value;
 
                      DBG_SOLVE(
                         printf("next value in range: %d\n", value);
@@ -751,37 +2182,42 @@ int solve(
                   // to backtrack.
 
                   backtrack = 1;
-                  map_count[curr_char]--;
-                  needed_sum += number_map[curr_char];
+                  state[letter].count--;
+                  needed_sum += state[letter].value;
 
                   DBG_SOLVE(
-                     printf("previously mapped character. needed_sum=%d increment by %d of %c\n", needed_sum, number_map[curr_char], curr_char);
+                     printf("previously mapped character. needed_sum=%d increment by %d of %c\n", needed_sum, state[letter].value, letters[letter]);
                   );
                }
             } else {
 
                // We are to move forward.
 
-               if(map_count[curr_char]) {
+               if(state[letter].count) {
 
                   // A value has already been chosen for this character.  Use
                   // it and move on.
 
-                  value = number_map[curr_char];
+                  value = state[letter].value;
 
                   // See if this value is too big or not.
 
-                  if(value > needed_sum) {
+                  if(value > needed_sum ||
+                     (PRUNE &&
+                      !prune_check(layout, &bounds, state, free_digits,
+                                   curr_column, curr_smnd_row,
+                                   needed_sum - value))) {
 
                      backtrack = 1;
                      backtrack_count++;
+                     value_too_large++;
 
                      DBG_SOLVE(
                         printf("previously chosen value %d too large\n", value);
                      );
 
                   } else {
-                     map_count[curr_char]++;
+                     state[letter].count++;
                      backtrack = 0;
 
                      DBG_SOLVE(
@@ -797,30 +2233,50 @@ int solve(
 
                   min_possible = needed_sum - max_digit * curr_smnd_row -
                                  max_carry[curr_column + 1];
-                  min_value[curr_char] = max_of_two(min_possible,
-                                              zero_or_one_start[curr_char]);
-                  max_value[curr_char] = min_of_two(max_digit, needed_sum);
+                  state[letter].low = max_of_two(min_possible,
+                                              state[letter].leading);
+                  state[letter].high = min_of_two(max_digit, needed_sum);
+                  if(PRUNE &&
+                     !prune_range(layout, &bounds, state, free_digits,
+                                  curr_column, curr_smnd_row, letter, 0,
+                                  needed_sum, &state[letter].low,
+                                  &state[letter].high)) {
+                     state[letter].high = state[letter].low - 1;
+                  }
 
                   DBG_SOLVE(
-                     printf("range chosen [%d-%d] ", min_value[curr_char], max_value[curr_char]);
+                     printf("range chosen [%d-%d] ", state[letter].low, state[letter].high);
                   );
 
                   // Find the first available value in this range.  If there
                   // aren't any available, then we will backtrack.
 
-                  value = min_value[curr_char];
-                  while(value <= max_value[curr_char] &&
-                        letter_map[value] != '\0') {
-                     value++;
+                  if(USE_MASK) {
+                     value = next_free_digit(free_digits,
+                                             state[letter].low,
+                                             state[letter].high);
+                     while(PRUNE && value <= state[letter].high &&
+                           !suffix_fits(layout, &bounds, state, curr_column,
+                                        letter, value)) {
+                        value = next_free_digit(free_digits, value + 1,
+                                                state[letter].high);
+                     }
+                  } else {
+                     value = state[letter].low;
+                     while(value <= state[letter].high &&
+                           digit_used[value]) {
+                        value++;
+                     }
                   }
 
-                  if(value > max_value[curr_char]) {
+                  if(value > state[letter].high) {
 
                      // We didn't find an available number in the range so
                      // we want to backtrack from here.
 
                      backtrack = 1;
                      backtrack_count++;
+                     empty_range++;
 
                      DBG_SOLVE(
                         printf("none available.\n");
@@ -829,9 +2285,16 @@ int solve(
                   } else {
 
                      backtrack = 0;
-                     map_count[curr_char]++;
-                     letter_map[value] = curr_char;
-                     number_map[curr_char] = value;
+                     state[letter].count++;
+                     if(++depth > max_depth) {
+                        max_depth = depth;
+                     }
+                     if(USE_MASK) {
+                        free_digits &= ~digit_bit(value);
+                     } else {
+                        digit_used[value] = 1;
+                     }
+                     state[letter].value = value;
 
                      DBG_SOLVE(
                         printf("using %d\n", value);
@@ -897,434 +2360,5595 @@ int solve(
          } // while (summands)
       } // while (columns)
 
-      // Get rid of the summands array if it was allocated.
-
-    //   if(allocated_smnds_array) {
-    //      delete [] reform_smnds;
-    //   }
-
       // Return the number of solutions we found.  If we only cared if more
-      // than one was found, we returned above.
-
+      // than one was found, we returned above.  The counters are kept in
+      // locals while searching, which is cheaper than going through the
+      // pointer each time.
+
+      counters->backtracks = backtrack_count;
+      counters->carry_infeasible = carry_infeasible;
+      counters->empty_range = empty_range;
+      counters->previously_mapped = previously_mapped;
+      counters->value_too_large = value_too_large;
+      memcpy(counters->column_nodes, column_nodes, sizeof(column_nodes));
+      counters->max_depth = max_depth;
       *difficulty = difficulty_conv(backtrack_count);
       return(solutions_found);
    }
 
 
-int upcase_and_check_legality(
-      char *string,        // The string to upcase and check.
-      int  *string_length  // Return the length of the string here.
+template<int BASE, int USE_MASK, int PRUNE>
+int solve_columns(
+      char              **summands,        // An array of pointers to the summands.
+      int                 summand_count,   // The number of summands.
+      int                *summand_lengths, // An array with the lengths o the summands.
+      int                 longest_summand, // The number of chars in the longest summand.
+      char               *sum,             // The word representing the sum.
+      int                 base,            // The base to solve the puzzle in.
+      int                 print,           // 1 if results to be printed, 0 otherwise.
+      int                 stop_after,      // Stop after this many solutions.  0 for all.
+      solve_split        *start,           // Piece to solve.  NULL for all of it.
+      int                 split_column,    // Column to split at.  0 to not split.
+      solve_split_list   *splits,          // Where to put the pieces split off.
+      output_buffer      *output,          // Where to print.  NULL for stdout.
+      solve_arena        *arena,           // Scratch memory for big puzzles.
+      search_counters    *counters,        // Return the search's counters here.
+      int                *difficulty       // The difficulty on a scale of 1 to 10.
    )
-   // This function will upcase the string passsed in as well as
-   // checking to make sure it only contains letters and that it is no
-   // longer than MAX_LEN.  Any leading or following whitespace will
-   // be removed.  If there is a problem with the string, an
-   // appropriate error message will be generated and zero will be
-   // returned.  A good string results in this returning 1.
+   // Lay out a puzzle and search it with search_columns.  The return
+   // value and arguments are the same as for search_columns.
+   // BASE lets the compiler build a copy for a specific base.  When it
+   // isn't zero, the base argument must match it and is replaced by
+   // the constant.  When it is zero, the argument is used.
    {
-      char  *ch_p = string;
-      char  *ch1_p;
-      int    length = strlen(string);
-      char  *new_p;
-      char  *new_str;
-      int    result = 1;
+      puzzle_layout  layout;
+      char           static_summands[MAX_LEN * MAX_STATIC_SUMMANDS];
+      int            sum_length = strlen(sum);
 
 
-      // Allocate space to copy the string into.  We don't just modify
-      // it in place so that if we have to print an error message
-      // the string is still in its original form.
-
-      new_str = new char[length + 1];
-      new_p = new_str;
-
-      // Detect any leading whitespace and ignore it.
+      // Use the constant for the base if this copy of the search was
+      // made for it.
 
-      while(*ch_p == ' ' || *ch_p == '\t') {
-         ch_p++;
+      if(BASE) {
+         base = BASE;
       }
 
-      // Now move through the string upcasing any characters and insuring
-      // that all characters are alphabetic.  Copy them to the new string
-      // as we go.
+      // Initialize in case of an error.
 
-      while(*ch_p != '\0' && *ch_p != ' ' && *ch_p != '\t') {
+      *difficulty = 0;
+      clear_search_counters(counters);
 
-         // Check for bad character.
+      // See if any of the strings is too long.  If so print message
+      // and return zero.
 
-         if(result && !isalpha(*ch_p)) {
-            printf("Words must contain only letters.  Problem with: %s\n", string);
-            result = 0;
-         }
+      if(sum_length > MAX_LEN || longest_summand > MAX_LEN) {
+         printf("Words must all be %d characters or less.\n", MAX_LEN);
+         return(0);
+      }
 
-         // Upcase this character.
+      // If a summand is longer than the sum, then there is no solution.
 
-         *new_p++ = toupper(*ch_p++);
+      if(longest_summand > sum_length) {
+         return(0);
       }
 
-      // If there is whitespace, it's either at the end of the string
-      // and we'll just ignore it or it's in the middle, in which case
-      // it's an error.  Search for the first non-whitespace character.
-
-      ch1_p = ch_p;
-      while(*ch_p == ' ' || *ch_p == '\t') {
-         ch_p++;
+      // Because malloc is somewhat expensive, and this routine needs to
+      // be as fast as possible, only take this array from the arena if
+      // there are too many summands to fit in the array on the stack.
+      // This one will hold MAX_STATIC_SUMMANDS.  The caller gives the
+      // arena memory back when the search is done.
+
+      if(summand_count <= MAX_STATIC_SUMMANDS) {
+         layout.smnds = static_summands;
+      } else {
+         layout.smnds = (char *) arena_alloc(arena, MAX_LEN * summand_count);
       }
 
-      // If we found a null, all is okay.  Put a null at the end of
-      // the string.  Note that if there was no whitespace at the end,
-      // this is a no-op.  Report an error if we didn't find a null.
+      // Lay out the puzzle.  If there are more letters than digits, a
+      // solution is impossible.
 
-      *new_p = '\0';
-      if(result && *ch_p != '\0') {
-         printf("Words must contain only letters.  Problem with: %s\n", string);
-         result = 0;
+      if(!lay_out_puzzle(&layout, summands, summand_count, summand_lengths,
+                         sum, base)) {
+         return(0);
       }
+      return(search_columns<BASE, USE_MASK, PRUNE>(&layout, print, stop_after,
+                  start, split_column, splits, output, counters,
+                  difficulty));
+   }
 
-      // Check the length of the string and report an error if too long.
 
-      length = new_p - new_str;
-      if(new_p - new_str > MAX_LEN) {
-         printf("Words can't be longer than %d characters.  %s is too long.\n", MAX_LEN, string);
-         result = 0;
+// The program engine.  Before searching, a puzzle is compiled into a
+// list of steps, one for each letter in the order the search visits
+// them: the sum letter of a column, then the summand letters in that
+// column from the bottom row up to the top, then on to the next
+// column.  A final step checks for a solution.  Whether a step is the
+// first time its letter is seen doesn't depend on the values tried,
+// so it is worked out once here instead of being looked up each time
+// the search gets to the letter.  The search itself then just moves
+// forward and backward through the list.
+// The steps don't depend on the base.  The bounds that do are filled
+// in by bind_program, so one compiled puzzle can be searched in as
+// many bases, or with as many different limits on its letters, as
+// wanted.
+
+const int STEP_SUM = 0;          // A sum letter seen before.
+const int STEP_SUM_FIRST = 2;    // The first time a sum letter is seen.
+const int STEP_SMND = 4;         // A summand letter seen before.
+const int STEP_SMND_FIRST = 6;   // The first time a summand letter is seen.
+const int STEP_END = 8;          // Past the last column.
+
+// The summand row of a step is kept in a byte.
+
+const int MAX_PROGRAM_SUMMANDS = 255;
+
+struct solve_step {
+   unsigned char  op;        // One of the STEP values.
+   unsigned char  letter;    // The letter's number in the puzzle.
+   unsigned char  column;    // The column of the letter.
+   unsigned char  row;       // The summand row.  Zero for the sum.
+   int            limit;     // Sum: the largest carry the column can make.
+                             // Summand: the most the rows above and the
+                             // carry can add to the column.
+   int            top;       // Sum: the most the summands and the carry
+                             // can add to the column.
+};
+
+struct solve_program {
+   int          step_count;
+   solve_step  *steps;                       // Taken from an arena.
+   int          sum_length;
+   int          column_lengths[MAX_LEN + 1];
+   int          column_steps[MAX_LEN + 1];   // Step of each column's sum.
+   int          letter_count;
+   char         letters[128];                // The letter for each number.
+   char         leading[MAX_BASE];           // 1 if it starts a word.
+   signed char  letter_ids[128];             // Number for each letter.
+   int          low[MAX_BASE];               // Smallest value allowed.
+   int          high[MAX_BASE];              // Largest value allowed.
+   int          base;                        // Base the bounds are for.
+};
+
+
+int compile_layout(
+      puzzle_layout   *layout,          // The puzzle laid out in columns.
+      solve_program   *program,         // The program to fill in.
+      solve_arena     *arena            // Where to put the steps.
+   )
+   // Compile a puzzle that has been laid out into a list of steps.
+   // Returns 1 if it worked, or 0 if the puzzle is too big for a
+   // program.  The program must be bound to a base with bind_program
+   // before it is run.  The steps are taken from the arena, so the
+   // program is good until the arena is released.
+   {
+      int          column;
+      int          i;
+      int          program_ids[MAX_BASE];
+      char        *reform_smnds = layout->smnds;
+      int          row;
+      solve_step  *step;
+      int          step_count;
+      int          sum_length = layout->sum_length;
+
+
+      if(layout->summand_count > MAX_PROGRAM_SUMMANDS) {
+         return(0);
       }
 
-      // Now copy the upcased string back to the one passed in, delete
-      // the allocated memory, and return the result.
+      // There is a step for each letter of each word and one more to
+      // check for a solution.
 
-      strcpy(string, new_str);
-      delete [] new_str;
-      *string_length = length;
-      return(result);
+      step_count = sum_length + 1;
+      for(column = 0; column < sum_length; column++) {
+         step_count += layout->column_lengths[column];
+      }
+      program->steps = (solve_step *) arena_alloc(arena,
+                                        step_count * sizeof(solve_step));
+      program->sum_length = sum_length;
+      memcpy(program->column_lengths, layout->column_lengths,
+             sizeof(program->column_lengths));
+
+      // Now write out the steps in the order they are searched,
+      // numbering the letters as we first come to them.  This isn't
+      // the order the layout numbered them in.
+
+      for(i = 0; i < layout->letter_count; i++) {
+         program_ids[i] = -1;
+      }
+      program->letter_count = 0;
+      step = program->steps;
+      for(column = 0; column < sum_length; column++) {
+         program->column_steps[column] = step - program->steps;
+         for(row = layout->column_lengths[column]; row >= 0; row--) {
+
+            // The sum letter is searched first, then the summands
+            // from the bottom row to the top.
+
+            if(row == layout->column_lengths[column]) {
+               i = layout->sum_ids[column];
+               step->op = STEP_SUM;
+               step->row = 0;
+            } else {
+               i = summand_char(row, column);
+               step->op = STEP_SMND;
+               step->row = row;
+            }
+            if(program_ids[i] < 0) {
+               program_ids[i] = program->letter_count;
+               program->letters[program->letter_count] = layout->letters[i];
+               program->leading[program->letter_count] =
+                                                (layout->leading[i] != 0);
+               program->letter_ids[(int) layout->letters[i]] =
+                                                program->letter_count;
+               program->letter_count++;
+               step->op += STEP_SUM_FIRST - STEP_SUM;
+            }
+            step->letter = program_ids[i];
+            step->column = column;
+            step++;
+         }
+      }
+      program->column_steps[sum_length] = step - program->steps;
+      step->op = STEP_END;
+      step->letter = 0;
+      step->column = sum_length;
+      step->row = 0;
+      step++;
+      program->step_count = step - program->steps;
+      program->base = 0;
+      return(1);
    }
 
 
-unsigned int look_for_puzzles_specific_count(
-      char         **words,
-      int            word_count,
-      int            base,
-      int           *word_lengths,
-      int           *bit_count,
-      int           *letters_used,
-      int            summand_count,
-      int            exactly_one,
-      int            disallow_rep,
-      int            first_sum_only,
-      unsigned int  *search_count
+int compile_puzzle(
+      char           **summands,        // An array of pointers to the summands.
+      int              summand_count,   // The number of summands.
+      int             *summand_lengths, // An array with the lengths of the summands.
+      int              longest_summand, // The number of chars in the longest summand.
+      char            *sum,             // The word representing the sum.
+      solve_program   *program,         // The program to fill in.
+      solve_arena     *arena            // Where to put the steps.
    )
-   // This function will look for puzzles with solutions (one or many)
-   // given the list of words and the various information about them
-   // in the other parameters.  This function returns the number of
-   // good puzzles found.  It also returns the number searched in the
-   // parameter search_count.
+   // Lay out a puzzle and compile it into a list of steps.  Returns 1
+   // if it worked, or 0 if the puzzle can't have a solution in any
+   // base or is too big for a program.  Nothing is printed either way.
+   // The program must be bound to a base with bind_program before it
+   // is run.  The steps and the scratch space used to lay out the
+   // summands are taken from the arena, so the program is good until
+   // the arena is released.
    {
-      int           backtrack;
-      int           difficulty;
-      unsigned int  good_puzzles = 0;
-      int           i;
-      int           index_limit;
-      int           letter_map;
-      int          *longest_smnd;
-      int           new_letter_map;
-      unsigned int  puzzles_tried = 0;
-      int           smnd_index;
-      int          *smnd_word_index;
-      int          *smnd_word_lengths;
-      char        **smnd_word_ptrs;
-      int          *smnd_letter_map;
-      int           solutions;
-      char         *sum;
-      int           sum_index;
-      int           sum_index_limit;
-      int           sum_length;
-      int           total_letters;
-      int           try_ind;
+      int            i, j;
+      puzzle_layout  layout;
+      int            sum_length = strlen(sum);
 
 
-      // Allocate arrays for summands.
+      if(sum_length > MAX_LEN || longest_summand > MAX_LEN ||
+            longest_summand > sum_length ||
+            summand_count > MAX_PROGRAM_SUMMANDS) {
+         return(0);
+      }
 
-      longest_smnd = new int[summand_count];
-      smnd_word_index = new int[summand_count];
-      smnd_word_ptrs = new char*[summand_count];
-      smnd_word_lengths = new int[summand_count];
-      smnd_letter_map = new int[summand_count];
+      // Lay the summands out in columns the same way solve_columns
+      // does.  The layout doesn't depend on the base, except that it
+      // won't take more letters than the base has digits, so it is
+      // given the biggest one.
 
-      // Try each word as the sum.
+      layout.smnds = (char *) arena_alloc(arena, MAX_LEN * summand_count);
+      for(i = 0; i < sum_length; i++) {
+         layout.letter_ids[(int) sum[i]] = -1;
+      }
+      for(i = 0; i < summand_count; i++) {
+         for(j = 0; j < summand_lengths[i]; j++) {
+            layout.letter_ids[(int) summands[i][j]] = -1;
+         }
+      }
+      layout.letter_count = 0;
+      start_layout(&layout, sum, MAX_BASE);
+      for(i = 0; i < summand_count; i++) {
+         if(!push_summand(&layout, summands[i], summand_lengths[i])) {
+            return(0);
+         }
+      }
+      return(compile_layout(&layout, program, arena));
+   }
 
-      sum_index_limit = (first_sum_only) ? 1 : word_count;
-      for(sum_index = 0; sum_index < sum_index_limit; sum_index++) {
-         sum = words[sum_index];
-         sum_length = word_lengths[sum_index];
 
-         DBG_FIND(
-            printf("Sum is %s\n", sum);
-         );
+int bind_program(
+      solve_program  *program,
+      int             base,      // The base to search in.
+      int            *low,       // Smallest value for each letter or NULL.
+      int            *high       // Largest value for each letter or NULL.
+   )
+   // Fill in the bounds in a compiled program for searching in the
+   // given base.  The values a letter can take can be limited by low
+   // and high, which are indexed by the letter's number.  Letters that
+   // start a word can never be zero whatever low says.  Returns 0 if
+   // the puzzle has more letters than the base has digits.
+   {
+      int          column;
+      int          i;
+      int          max_carry[MAX_LEN + 1];
+      int          max_digit = base - 1;
+      solve_step  *step;
 
-         // Find summand_count words other than sum such that
-         // no more than base characters are used and all of
-         // the summand words are not longer than the sum's length.
 
-         smnd_index = 0;
-         backtrack  = 0;
-         while(smnd_index >= 0) {
+      if(program->letter_count > base) {
+         return(0);
+      }
 
-            // See if we have a possible set of summands.
+      // Figure out the maximum carry from each column as solve_columns
+      // does.
 
-            if(smnd_index == summand_count) {
+      max_carry[program->sum_length] = 0;
+      for(column = program->sum_length - 1; column >= 0; column--) {
+         max_carry[column] = (max_digit * program->column_lengths[column] +
+                              max_carry[column + 1]) / base;
+      }
 
-               // We have a set of words to try.
+      for(i = 0; i < program->letter_count; i++) {
+         program->low[i] = (low) ? low[i] : 0;
+         if(program->leading[i] && program->low[i] < 1) {
+            program->low[i] = 1;
+         }
+         program->high[i] = (high) ? min_of_two(high[i], max_digit)
+                                   : max_digit;
+      }
 
-               solutions = solve(smnd_word_ptrs, summand_count,
-                     smnd_word_lengths, longest_smnd[smnd_index - 1], sum,
-                     base, 0, 0, &difficulty);
-               puzzles_tried++;
+      for(i = 0; i < program->step_count; i++) {
+         step = &program->steps[i];
+         column = step->column;
+         if(step->op == STEP_SUM || step->op == STEP_SUM_FIRST) {
+            step->limit = max_carry[column];
+            step->top = max_carry[column + 1] +
+                        max_digit * program->column_lengths[column];
+         } else if(step->op != STEP_END) {
+            step->limit = max_digit * step->row + max_carry[column + 1];
+            step->top = 0;
+         }
+      }
+      program->base = base;
+      return(1);
+   }
 
-               DBG_FIND(
-                  printf("  Trying ");
-                  for(i = 0; i < summand_count; i++) {
-                     if(i != 0) {
-                        printf(" + ");
-                     }
-                     printf("%s", smnd_word_ptrs[i]);
-                  }
-                  printf("\n");
-               );
 
-               // If one solution was returned, then we want to print
-               // this one.  Note that this is the correct thing to do
-               // whether we were looking for puzzles with exaclty one
-               // solution or not.
+int run_program(
+      solve_program     *program,       // A compiled and bound puzzle.
+      int                print,         // 1 if results to be printed, 0 otherwise.
+      int                stop_after,    // Stop after this many solutions.  0 for all.
+      solve_split       *start,         // Piece to solve.  NULL for all of it.
+      int                split_column,  // Column to split at.  0 to not split.
+      solve_split_list  *splits,        // Where to put the pieces split off.
+      output_buffer     *output,        // Where to print.  NULL for stdout.
+      search_counters   *counters,      // Return the search's counters here.
+      int               *difficulty     // The difficulty on a scale of 1 to 10.
+   )
+   // Search a compiled puzzle.  This takes the same steps as
+   // solve_columns and counts backtracks the same way, so it finds the
+   // same solutions in the same order with the same difficulty.  The
+   // arguments work the same way too.
+   {
+      int          backtrack;
+      ulong        backtrack_count = 0;
+      int          base = program->base;
+      int          curr_step;
+      int          depth;
+      digit_mask   free_digits;
+      int          high[MAX_BASE];
+      int          i, j;
+      int          letter;
+      int          needed_carry[MAX_LEN + 1];
+      int          needed_sum;
+      int          number_map[MAX_BASE];
+      int          solutions_found = 0;
+      solve_split *split;
+      int          split_step;
+      int          start_step;
+      solve_step  *step;
+      solve_step  *steps = program->steps;
+      int          value;
 
-               if(solutions == 1 || (solutions > 0 && !exactly_one)) {
-                  good_puzzles++;
-                  if(!exactly_one) {
-                     printf("(%d) ", solutions);
-                  }
-                  for(i = 0; i < summand_count; i++) {
-                     if(i != 0) {
-                        printf(" + ");
-                     }
-                     printf("%s", smnd_word_ptrs[i]);
-                  }
-                  letter_map = smnd_letter_map[smnd_index - 1];
-                  total_letters = bit_count[letter_map & 0x1ff]
-                    + bit_count[(letter_map >> 9) & 0x1ff]
-                    + bit_count[(letter_map >> 18) & 0x1ff];
-                  printf(" = %s", sum);
 
-                  if(DIFF_PRINT) {
-                     printf("  difficulty: %d", difficulty);
-                  }
-                  printf("\n");
-               }
+      *difficulty = 0;
+      clear_search_counters(counters);
+
+      free_digits = all_digits(base);
+      if(start) {
+         for(i = 0; i < start->letter_count; i++) {
+            letter = program->letter_ids[(int) start->letters[i]];
+            number_map[letter] = start->values[i];
+            free_digits &= ~digit_bit(start->values[i]);
+         }
+         start_step = program->column_steps[start->column];
+         needed_sum = start->needed_carry;
+         depth = start->letter_count;
+      } else {
+         start_step = 0;
+         needed_sum = 0;
+         depth = 0;
+      }
+      split_step = (split_column > 0) ? program->column_steps[split_column]
+                                      : -1;
 
-               // Backtrack from here to try another.
+      curr_step = start_step;
+      backtrack = 0;
+      while(1) {
+         step = &steps[curr_step];
+         letter = step->letter;
 
-               backtrack = 1;
-               smnd_index--;
-               continue;
+         // The op of each step is even, so adding the backtrack flag
+         // gives a different case for going forward and going back.
 
-            } else {
+         switch(step->op + backtrack) {
 
-               if(backtrack) {
+            case STEP_SUM:
 
-                  // We've backtracked to this position in the summand array.
-                  // Try to find a new index for this position after
-                  // the one here currently.
+               // A sum letter with a value already.  The needed sum
+               // coming in is the carry needed into this column.
 
-                  try_ind = smnd_word_index[smnd_index] + 1;
+               if(curr_step == split_step) {
+                  goto record_split;
+               }
+               counters->column_nodes[step->column]++;
+               needed_carry[step->column] = needed_sum;
+               if(needed_sum > step->limit) {
+                  backtrack_count++;
+                  counters->carry_infeasible++;
+                  backtrack = 1;
+                  break;
+               }
+               needed_sum = number_map[letter] + base * needed_sum;
+               break;
 
-               } else {
+            case STEP_SUM + 1:
 
-                  // We've come to this position in the summand array
-                  // going forward.  Starting at the start of the word
-                  // array, find one for this spot in the summands array.
+               counters->column_nodes[step->column]++;
+               backtrack_count++;
+               counters->previously_mapped++;
+               needed_sum = needed_carry[step->column];
+               break;
 
-                  try_ind = (smnd_index == 0) ? 0
-                          : smnd_word_index[smnd_index - 1] + disallow_rep;
-               }
+            case STEP_SUM_FIRST:
 
-               // Now look for a possible word starting at the index try_ind.
-               // We stop when we reach either word count in the case where
-               // repetition of words is allowed or the number of sumands
-               // left subtracted from word_count where repetition isn't
-               // allowed.
+               // The first time we've seen this sum letter.  Find the
+               // range of values it could take and try the first free
+               // one.
 
-               if(disallow_rep) {
-                  index_limit = (word_count -
-                                     (summand_count - smnd_index - 1));
-               } else {
-                  index_limit = word_count;
+               if(curr_step == split_step) {
+                  goto record_split;
                }
-               while(try_ind < index_limit) {
-
-                  // The sum can't be included in the summands.
+               counters->column_nodes[step->column]++;
+               needed_carry[step->column] = needed_sum;
+               if(needed_sum > step->limit) {
+                  backtrack_count++;
+                  counters->carry_infeasible++;
+                  backtrack = 1;
+                  break;
+               }
+               high[letter] = min_of_two(program->high[letter],
+                                         step->top - needed_sum * base);
+               value = next_free_digit(free_digits, program->low[letter],
+                                       high[letter]);
+               if(value > high[letter]) {
+                  backtrack_count++;
+                  counters->empty_range++;
+                  backtrack = 1;
+                  break;
+               }
+               if(++depth > counters->max_depth) {
+                  counters->max_depth = depth;
+               }
+               free_digits &= ~digit_bit(value);
+               number_map[letter] = value;
+               needed_sum = value + base * needed_sum;
+               break;
 
-                  if(try_ind == sum_index) {
-                     try_ind++;
-                     continue;
-                  }
+            case STEP_SUM_FIRST + 1:
 
-                  // A summand can't be longer than the sum.
+               // Backtracked to the first time we saw this sum letter.
+               // Try the next free value.
 
-                  if(word_lengths[try_ind] > sum_length) {
-                     try_ind++;
-                     continue;
-                  }
+               counters->column_nodes[step->column]++;
+               value = number_map[letter];
+               free_digits |= digit_bit(value);
+               value = next_free_digit(free_digits, value + 1, high[letter]);
+               if(value > high[letter]) {
+                  backtrack_count++;
+                  counters->empty_range++;
+                  depth--;
+                  needed_sum = needed_carry[step->column];
+                  break;
+               }
+               free_digits &= ~digit_bit(value);
+               number_map[letter] = value;
+               needed_sum = value + base * needed_carry[step->column];
+               backtrack = 0;
+               break;
 
-                  // See how many total letters there will be after we
-                  // add this word.  If there are more than base, there
-                  // can't be a solution.
-
-                  new_letter_map = (smnd_index == 0)
-                    ? letters_used[sum_index] | letters_used[try_ind]
-                    : smnd_letter_map[smnd_index - 1]
-                      | letters_used[try_ind];
-                  total_letters = bit_count[new_letter_map & 0x1ff]
-                    + bit_count[(new_letter_map >> 9) & 0x1ff]
-                    + bit_count[(new_letter_map >> 18) & 0x1ff];
-                  if(total_letters > base) {
-                     try_ind++;
-                     continue;
-                  }
+            case STEP_SMND:
 
-                  // This one looks okay.
+               // A summand letter with a value already.  It can't be
+               // more than what is needed.
 
+               counters->column_nodes[step->column]++;
+               value = number_map[letter];
+               if(value > needed_sum) {
+                  backtrack_count++;
+                  counters->value_too_large++;
+                  backtrack = 1;
                   break;
                }
+               needed_sum -= value;
+               break;
 
-               // See if we found a summand word to try in this place.
-               // If not, backtrack.  If so, go to next summand spot.
+            case STEP_SMND + 1:
 
-               if(try_ind >= index_limit) {
+               counters->column_nodes[step->column]++;
+               needed_sum += number_map[letter];
+               break;
 
-                  backtrack = 1;
-                  smnd_index--;
+            case STEP_SMND_FIRST:
 
-               } else {
+               // The first time we've seen this summand letter.  Find
+               // the range of values it could take and try the first
+               // free one.
 
-                  // When we go forward, we have to keep track of the
-                  // index into the words array this summand is, its
-                  // lengths, a pointer to the word, and the bit map
-                  // of letters used to this point.
-
-                  backtrack = 0;
-                  smnd_word_index[smnd_index] = try_ind;
-                  smnd_word_ptrs[smnd_index] = words[try_ind];
-                  smnd_word_lengths[smnd_index] = word_lengths[try_ind];
-                  smnd_letter_map[smnd_index] = new_letter_map;
-                  if(smnd_index == 0) {
-                     longest_smnd[smnd_index] = word_lengths[try_ind];
-                  } else {
-                    if(word_lengths[try_ind] >
-                                     longest_smnd[smnd_index - 1]) {
-                       longest_smnd[smnd_index] = word_lengths[try_ind];
-                    } else {
-                       longest_smnd[smnd_index] =
-                                     longest_smnd[smnd_index - 1];
-                    }
+               counters->column_nodes[step->column]++;
+               high[letter] = min_of_two(program->high[letter], needed_sum);
+               value = next_free_digit(free_digits,
+                             max_of_two(needed_sum - step->limit,
+                                        program->low[letter]),
+                             high[letter]);
+               if(value > high[letter]) {
+                  backtrack_count++;
+                  counters->empty_range++;
+                  backtrack = 1;
+                  break;
+               }
+               if(++depth > counters->max_depth) {
+                  counters->max_depth = depth;
+               }
+               free_digits &= ~digit_bit(value);
+               number_map[letter] = value;
+               needed_sum -= value;
+               break;
+
+            case STEP_SMND_FIRST + 1:
+
+               // Backtracked to the first time we saw this summand
+               // letter.  Try the next free value.
+
+               counters->column_nodes[step->column]++;
+               value = number_map[letter];
+               needed_sum += value;
+               free_digits |= digit_bit(value);
+               value = next_free_digit(free_digits, value + 1, high[letter]);
+               if(value > high[letter]) {
+                  backtrack_count++;
+                  counters->empty_range++;
+                  depth--;
+                  break;
+               }
+               free_digits &= ~digit_bit(value);
+               number_map[letter] = value;
+               needed_sum -= value;
+               backtrack = 0;
+               break;
+
+            case STEP_END:
+
+               // Past the last column.  It's a solution if no carry
+               // is needed out of the last column.
+
+               if(needed_sum == 0) {
+                  solutions_found++;
+                  if(print) {
+                     print_solution(program->letter_count, program->letters,
+                                    number_map, output);
                   }
+                  if(solutions_found == stop_after) {
+                     goto stop_search;
+                  }
+               }
+               backtrack = 1;
+               break;
+         }
 
-                  // Set index to next summand space.
+         if(backtrack) {
 
-                  smnd_index++;
-               }
+            // Only a sum step can be the first one searched, so only
+            // then do we need to check if we've backtracked out of the
+            // first step, in which case everything has been tried.
+
+            if(curr_step == start_step) {
+               break;
+            }
+            curr_step--;
+         } else {
+            curr_step++;
+         }
+         continue;
+
+      record_split:
+
+         // When splitting the search, record a piece instead of going
+         // on to the split column, then backtrack as if it had been
+         // searched.  The carry needed into the column is the needed
+         // sum that was passed to it.
+
+         if(splits->count == splits->size) {
+            splits->overflow = 1;
+            return(0);
+         }
+         split = &splits->splits[splits->count++];
+         split->column = split_column;
+         split->needed_carry = needed_sum;
+         split->letter_count = 0;
+         for(i = 0; i < program->letter_count; i++) {
+            j = 0;
+            for(step = steps; step < &steps[split_step]; step++) {
+               j += (step->letter == i && step->op != STEP_END);
+            }
+            if(j) {
+               split->letters[split->letter_count] = program->letters[i];
+               split->values[split->letter_count] = number_map[i];
+               split->map_counts[split->letter_count] = j;
+               split->letter_count++;
             }
          }
+         curr_step--;
+         backtrack = 1;
       }
 
-      // Now free the arrays we allocated.
+   stop_search:
+      counters->backtracks = backtrack_count;
+      *difficulty = difficulty_conv(backtrack_count);
+      return(solutions_found);
+   }
 
-      delete [] smnd_word_index;
-      delete [] smnd_word_ptrs;
-      delete [] smnd_word_lengths;
-      delete [] smnd_letter_map;
-      delete [] longest_smnd;
 
-      // Return the number of good puzzles found and the number tried.
+// The linear engine.  An addition puzzle is the same as a single
+// equation.  Each letter gets a weight, which is the sum of the place
+// values of where it is in the summands less those of where it is in
+// the sum, and the letters' values times their weights must add up
+// to zero.  The letters are given values in order of the size of
+// their weights, largest first, so that the ones that matter most are
+// set first.  Before a letter is tried, the least and most that the
+// letters after it can add to the total with the free digits that are
+// left are worked out, and only the values that could still bring the
+// total to zero are tried.  The column search can't tell that a value
+// is wrong until it has set the rest of the letters in a column, so
+// this does much better on puzzles with many summands or many
+// repeated letters.  The solutions are the same, but they come out in
+// a different order and the backtrack counts are different.
 
-      *search_count = puzzles_tried;
-      return(good_puzzles);
+const double MAX_LINEAR_TOTAL = 4.0e18;   // Keeps the totals in a long long.
+
+
+int linear_fits(
+      int    summand_count,   // The number of summands.
+      int    longest_summand, // The number of chars in the longest summand.
+      int    sum_length,      // The number of chars in the sum.
+      int    base             // The base to solve the puzzle in.
+   )
+   // See if the linear engine can search a puzzle.  The words have to
+   // fit in a layout, and the weights times the digits have to add up
+   // to less than MAX_LINEAR_TOTAL however the letters are placed.
+   // Returns 0 if the column search should be used instead.
+   {
+      double  total;
+
+
+      if(sum_length > MAX_LEN || longest_summand > MAX_LEN ||
+            longest_summand > sum_length) {
+         return(0);
+      }
+      total = (summand_count + 1) * pow((double) base, sum_length);
+      return(total < MAX_LINEAR_TOTAL);
    }
 
 
-unsigned int look_for_puzzles(
-      char         **words,
-      int            word_count,
-      int           *word_lengths,
+void linear_range(
+      long long     *weights,       // The weight of the letter at each step.
+      int            step,          // The step to find the range for.
+      int            letter_count,  // The number of steps.
+      long long      total,         // What the steps before add up to.
+      digit_mask     free_digits,   // A bit is set for each unused digit.
       int            base,
-      int            low_summand_count,
-      int            high_summand_count,
-      int            exactly_one,
-      int            disallow_rep,
-      int            first_sum_only,
-      unsigned int  *total_searched
+      int            leading,       // 1 if the letter can't be zero.
+      short         *low,           // Return the range of values to try.
+      short         *high
    )
-   // This function will look for puzzles with solutions using the words
-   // given.  It will search for them among all possible combinations
-   // from low_summand_count to high_summand_count summands.  If
-   // exactly_one is set, then it will only generate puzzles that have
-   // exactly one solution.  Otherwise it will generate puzzles that
-   // have at least one solution.
+   // Find the values for the letter at a step that could still bring
+   // the total to zero.  The letters after it have weights no bigger
+   // than its own.  The least they can add is when the positive
+   // weights, biggest first, get the smallest free digits and the
+   // negative ones get the largest.  The most is the other way around.
+   // Giving each of the two groups all of the free digits is a bit
+   // loose, but it never rules out a value that could work.
    {
-      int           bit_count[512];
-      int           bits;
-      char          ch;
-      int           i;
-      int           j;
-      int           length;
-      int          *letters_used;
-      unsigned int  number_found = 0;
-      unsigned int  search_count;
-      int           summand_count;
+      int            digit;
+      long long      first;
+      int            i;
+      long long      last;
+      digit_mask     left_high;
+      digit_mask     left_low;
+      long long      least = 0;
+      long long      most = 0;
+      long long      spare_high;
+      long long      spare_low;
+      long long      weight = weights[step];
+
+
+      // The positive weights.
+
+      left_low = free_digits;
+      left_high = free_digits;
+      for(i = step + 1; i < letter_count; i++) {
+         if(weights[i] <= 0) {
+            continue;
+         }
+         digit = count_trailing_zeros(left_low);
+         left_low &= ~digit_bit(digit);
+         least += weights[i] * digit;
+         for(digit = base - 1; !(left_high & digit_bit(digit)); digit--) {
+         }
+         left_high &= ~digit_bit(digit);
+         most += weights[i] * digit;
+      }
+
+      // The negative weights.
+
+      left_low = free_digits;
+      left_high = free_digits;
+      for(i = step + 1; i < letter_count; i++) {
+         if(weights[i] >= 0) {
+            continue;
+         }
+         for(digit = base - 1; !(left_low & digit_bit(digit)); digit--) {
+         }
+         left_low &= ~digit_bit(digit);
+         least += weights[i] * digit;
+         digit = count_trailing_zeros(left_high);
+         left_high &= ~digit_bit(digit);
+         most += weights[i] * digit;
+      }
+
+      // The letter's weight times its value must be between
+      // spare_low and spare_high.  The range is kept from going far
+      // outside of the digits so that it fits in a short.
+
+      spare_low = -total - most;
+      spare_high = -total - least;
+      first = leading;
+      last = base - 1;
+      if(weight > 0) {
+         first = max_of_two_long(first, -floor_div(-spare_low, weight));
+         last = min_of_two_long(last, floor_div(spare_high, weight));
+      } else if(weight < 0) {
+         first = max_of_two_long(first, -floor_div(spare_high, -weight));
+         last = min_of_two_long(last, floor_div(-spare_low, -weight));
+      } else if(spare_low > 0 || spare_high < 0) {
+         last = first - 1;
+      }
+      *low = min_of_two_long(first, base);
+      *high = max_of_two_long(last, -1);
+   }
+
+
+// The meet in the middle engine is the linear engine with the letters
+// split into two halves.  The half with the smallest weights is made
+// into a table of every way of giving those letters different digits,
+// with what each adds to the total and the digits it uses.  The other
+// half is searched as in the linear engine, and once its letters are
+// set, the ways of finishing that bring the total to zero are looked
+// up in the table instead of searched.  The table is sorted by total
+// and then by the digits used, and the ways with the same of both are
+// kept together as a group.  A lookup finds the groups with the total
+// it needs with a binary search and checks each group's digits
+// against those already used once, however many ways are in it.  The
+// table gets half of the letters if it fits in the memory given with
+// -meet-memory and fewer if it doesn't.  If there is room for fewer
+// than MEET_MIN_LETTERS, it is just the linear engine.
+// Making a table costs about as much as MEET_BUILD_COST backtracks
+// for each entry, which is far more than most puzzles take to search.
+// So the search starts out as the linear engine, and only makes a
+// table for the last few letters once it has backtracked enough times
+// to have paid for it.  If the search goes on long enough to pay for
+// a table with another letter, that one replaces it, up to the most
+// letters that fit.  Each table is several times the size of the one
+// before, so making the smaller ones doesn't add much.  Easy puzzles
+// are solved as fast as with the linear engine, and hard ones with
+// the biggest table that was worth making.
+
+const int MEET_MIN_LETTERS = 3;
+const int MEET_BUILD_COST = 8;
+const int DEFAULT_MEET_MEMORY = 256;   // Megabytes.
+
+struct meet_entry {
+   long long     total;     // What the letters add to the total.
+   digit_mask    used;      // The digits they use.
+   unsigned int  digits;    // The first of its digits in the table's.
+};
+
+struct meet_group {
+   long long     total;     // What each entry in it adds to the total.
+   digit_mask    used;      // The digits each entry in it uses.
+   unsigned int  first;     // Its first entry.
+   unsigned int  count;     // The number of entries in it.
+};
+
+struct meet_table {
+   int             letters;       // The number of letters in it.
+   unsigned int    entry_count;
+   meet_entry     *entries;       // Sorted by total and then digits used.
+   unsigned char  *digits;        // Each entry's digit for each letter.
+   unsigned int    group_count;
+   meet_group     *groups;        // In the same order as the entries.
+};
+
+
+int compare_meet_entries(
+      const void  *first,
+      const void  *second
+   )
+   // Order meet_entry structs by their totals and then by the digits
+   // they use for qsort.
+   {
+      const meet_entry  *first_entry = (const meet_entry *) first;
+      const meet_entry  *second_entry = (const meet_entry *) second;
+
+
+      if(first_entry->total != second_entry->total) {
+         return((first_entry->total > second_entry->total) -
+                (first_entry->total < second_entry->total));
+      }
+      return((first_entry->used > second_entry->used) -
+             (first_entry->used < second_entry->used));
+   }
+
+
+inline long long meet_entry_bytes(
+      int  table_letters   // The number of letters in the table.
+   )
+   // Return the most memory a table needs for each entry, if each one
+   // were in a group of its own.
+   {
+      return(sizeof(meet_entry) + sizeof(meet_group) + table_letters);
+   }
+
+
+long long meet_table_size(
+      int  base,
+      int  table_letters   // The number of letters in the table.
+   )
+   // Return the number of entries in a table, which is the number of
+   // ways of giving that many letters different digits.
+   {
+      int        i;
+      long long  size = 1;
+
+
+      for(i = 0; i < table_letters; i++) {
+         size *= base - i;
+      }
+      return(size);
+   }
+
+
+int meet_table_letters(
+      int        base,
+      int        letter_count,   // The number of letters in the puzzle.
+      long long  memory          // The bytes the table can use.
+   )
+   // Return the number of letters to put in the table, or 0 for none.
+   {
+      long long  size = 1;
+      int        table_letters = 0;
+
+
+      while(table_letters < letter_count / 2) {
+         size *= base - table_letters;
+         if(size > UINT_MAX ||
+               size * meet_entry_bytes(table_letters + 1) > memory) {
+            break;
+         }
+         table_letters++;
+      }
+      return((table_letters >= MEET_MIN_LETTERS) ? table_letters : 0);
+   }
+
+
+void build_meet_table(
+      meet_table  *table,          // The table to fill in.
+      long long   *weights,        // The weight of each letter in the table.
+      char        *leading,        // 1 for each that can't be zero.
+      int          table_letters,  // The number of letters in the table.
+      int          base
+   )
+   // Make a table of every way of giving the letters different digits,
+   // sorted and grouped by what they add to the total and the digits
+   // they use.  Free it with free_meet_table.
+   {
+      meet_entry     *entry;
+      meet_group     *group;
+      unsigned int    i;
+      int             letter;
+      long long       size = meet_table_size(base, table_letters);
+      long long       totals[MAX_BASE + 1];
+      int             tried[MAX_BASE];
+      digit_mask      used = 0;
+      int             value;
+
+
+      table->letters = table_letters;
+      table->entries = new meet_entry[size];
+      table->digits = new unsigned char[size * table_letters];
+      table->entry_count = 0;
+
+      letter = 0;
+      totals[0] = 0;
+      value = leading[0];
+      while(1) {
+         value = next_free_digit(~used, value, base - 1);
+         if(value > base - 1) {
+            letter--;
+            if(letter < 0) {
+               break;
+            }
+            used &= ~digit_bit(tried[letter]);
+            value = tried[letter] + 1;
+            continue;
+         }
+         tried[letter] = value;
+         used |= digit_bit(value);
+         totals[letter + 1] = totals[letter] + weights[letter] * value;
+         if(letter < table_letters - 1) {
+            letter++;
+            value = leading[letter];
+            continue;
+         }
+         entry = &table->entries[table->entry_count];
+         entry->total = totals[table_letters];
+         entry->used = used;
+         entry->digits = table->entry_count * table_letters;
+         for(i = 0; i < (unsigned int) table_letters; i++) {
+            table->digits[entry->digits + i] = tried[i];
+         }
+         table->entry_count++;
+         used &= ~digit_bit(value);
+         value++;
+      }
+      qsort(table->entries, table->entry_count, sizeof(meet_entry),
+            compare_meet_entries);
+
+      // Now gather the entries with the same total and digits.
+
+      table->groups = new meet_group[table->entry_count];
+      table->group_count = 0;
+      group = NULL;
+      for(i = 0; i < table->entry_count; i++) {
+         entry = &table->entries[i];
+         if(!group || entry->total != group->total ||
+               entry->used != group->used) {
+            group = &table->groups[table->group_count++];
+            group->total = entry->total;
+            group->used = entry->used;
+            group->first = i;
+            group->count = 0;
+         }
+         group->count++;
+      }
+   }
+
+
+void free_meet_table(
+      meet_table  *table
+   )
+   // Free the arrays of a table made by build_meet_table.
+   {
+      delete [] table->groups;
+      delete [] table->digits;
+      delete [] table->entries;
+   }
+
+
+int meet_lookup(
+      puzzle_layout  *layout,
+      meet_table     *table,
+      long long       total,          // What the letters before add up to.
+      digit_mask      used,           // The digits they use.
+      int            *order,          // The letter at each step.
+      int            *tried,          // The value at each step before.
+      int             print,          // 1 if results to be printed.
+      int             stop_after,     // Stop after this many solutions.  0 for all.
+      output_buffer  *output          // Where to print.  NULL for stdout.
+   )
+   // Find the entries in a table that bring the total to zero without
+   // using a digit again.  Each is a solution.  Returns the number.
+   {
+      const unsigned char  *digits;
+      unsigned int          first = 0;
+      meet_group           *group;
+      int                   i;
+      unsigned int          j;
+      unsigned int          last = table->group_count;
+      unsigned int          middle;
+      int                   search_count = layout->letter_count -
+                                           table->letters;
+      int                   solutions_found = 0;
+      int                   values[MAX_BASE];
+
+
+      // Find the first group with a total of -total.
+
+      while(first < last) {
+         middle = first + (last - first) / 2;
+         if(table->groups[middle].total < -total) {
+            first = middle + 1;
+         } else {
+            last = middle;
+         }
+      }
+
+      for(group = &table->groups[first];
+            group < &table->groups[table->group_count] &&
+               group->total == -total;
+            group++) {
+         if(group->used & used) {
+            continue;
+         }
+         if(!print && (!stop_after ||
+               solutions_found + (int) group->count < stop_after)) {
+            solutions_found += group->count;
+            continue;
+         }
+         for(i = 0; i < search_count; i++) {
+            values[order[i]] = tried[i];
+         }
+         for(j = group->first; j < group->first + group->count; j++) {
+            solutions_found++;
+            if(print) {
+               digits = &table->digits[table->entries[j].digits];
+               for(i = 0; i < table->letters; i++) {
+                  values[order[search_count + i]] = digits[i];
+               }
+               print_solution(layout->letter_count, layout->letters, values,
+                              output);
+            }
+            if(solutions_found == stop_after) {
+               return(solutions_found);
+            }
+         }
+      }
+      return(solutions_found);
+   }
+
+
+int search_linear(
+      puzzle_layout      *layout,          // The puzzle to solve.
+      int                 print,           // 1 if results to be printed, 0 otherwise.
+      int                 stop_after,      // Stop after this many solutions.  0 for all.
+      long long           table_memory,    // Bytes for a meet in the middle table.
+      output_buffer      *output,          // Where to print.  NULL for stdout.
+      search_counters    *counters,        // Return the search's counters here.
+      int                *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // Find the solutions to a puzzle that has been laid out, the same
+   // as search_columns, but with the linear engine.  It must have
+   // passed linear_fits.  It can't split the search.  If table_memory
+   // isn't 0, the letters with the smallest weights are looked up in a
+   // meet in the middle table that uses no more than that, once the
+   // search has gone on long enough to pay for it.  Only the letters
+   // searched count backtracks, so a table can only make the count
+   // smaller.
+   {
+      ulong         backtrack_count = 0;
+      int           base = layout->base;
+      ulong         build_after[MAX_BASE];
+      int           column;
+      digit_mask    free_digits;
+      short         high[MAX_BASE];
+      int           i, j;
+      int           letter;
+      int           letter_count = layout->letter_count;
+      long long     letter_weights[MAX_BASE];
+      short         low[MAX_BASE];
+      int           order[MAX_BASE];
+      long long     place;
+      char         *reform_smnds = layout->smnds;
+      int           row;
+      int           search_count;
+      int           solutions_found = 0;
+      int           step;
+      meet_table    table;
+      char          table_leading[MAX_BASE];
+      int           table_letters = 0;
+      int           table_most;
+      long long     totals[MAX_BASE];
+      int           tried[MAX_BASE];
+      int           value;
+      int           values[MAX_BASE];
+      long long     weight;
+      long long     weights[MAX_BASE];    // The weight at each step.
+
+
+      *difficulty = 0;
+      clear_search_counters(counters);
+
+      // Work out the weights from the columns, right to left.
+
+      memset(letter_weights, 0, sizeof(letter_weights));
+      place = 1;
+      for(column = layout->sum_length - 1; column >= 0; column--) {
+         for(row = 0; row < layout->column_lengths[column]; row++) {
+            letter_weights[(int) summand_char(row, column)] += place;
+         }
+         letter_weights[layout->sum_ids[column]] -= place;
+         place *= base;
+      }
+
+      // Put the letters in order of the size of their weights.  Ties
+      // stay in the order of the letters' numbers.
+
+      for(i = 0; i < letter_count; i++) {
+         weight = letter_weights[i];
+         for(j = i; j > 0 && llabs(weights[j - 1]) < llabs(weight); j--) {
+            weights[j] = weights[j - 1];
+            order[j] = order[j - 1];
+         }
+         weights[j] = weight;
+         order[j] = i;
+      }
+
+      // See how many of the last letters there is room for in a meet
+      // in the middle table, and how many backtracks it takes to pay
+      // for each size.  The tables are made later, if the search gets
+      // that far.
+
+      table_most = meet_table_letters(base, letter_count, table_memory);
+      for(i = MEET_MIN_LETTERS; i <= table_most; i++) {
+         build_after[i] = meet_table_size(base, i) * MEET_BUILD_COST;
+      }
+      for(i = 0; i < letter_count; i++) {
+         table_leading[i] = (layout->leading[order[i]] != 0);
+      }
+      search_count = letter_count;
+
+      // Now search.  totals holds what the letters before each step
+      // add up to, and tried the value the letter at each step has.
+
+      free_digits = all_digits(base);
+      step = 0;
+      totals[0] = 0;
+      linear_range(weights, 0, letter_count, 0, free_digits, base,
+                   layout->leading[order[0]] != 0, &low[0], &high[0]);
+      value = next_free_digit(free_digits, low[0], high[0]);
+      while(1) {
+
+         if(value > high[step]) {
+
+            // No more values to try for this letter.  Go back to the
+            // one before it and try its next value.
+
+            backtrack_count++;
+            step--;
+            if(step < 0) {
+               break;
+            }
+            free_digits |= digit_bit(tried[step]);
+            value = next_free_digit(free_digits, tried[step] + 1, high[step]);
+            continue;
+         }
+         tried[step] = value;
+         if(step >= counters->max_depth) {
+            counters->max_depth = step + 1;
+         }
+
+         // Make a table for the letters after this one if the search
+         // has paid for it and it is bigger than the one we have.
+
+         j = letter_count - 1 - step;
+         if(j > table_letters && j <= table_most &&
+               j >= MEET_MIN_LETTERS && backtrack_count >= build_after[j]) {
+            if(table_letters) {
+               free_meet_table(&table);
+            }
+            build_meet_table(&table, &weights[step + 1],
+                             &table_leading[step + 1], j, base);
+            table_letters = j;
+            search_count = step + 1;
+         }
+
+         // With a table, the rest of the letters are looked up in it
+         // once the letters before it are set.
+
+         if(table_letters && step == search_count - 1) {
+            solutions_found += meet_lookup(layout, &table,
+                                 totals[step] + weights[step] * value,
+                                 ~free_digits | digit_bit(value), order, tried,
+                                 print,
+                                 stop_after ? stop_after - solutions_found : 0,
+                                 output);
+            if(stop_after && solutions_found >= stop_after) {
+               break;
+            }
+            value = next_free_digit(free_digits, value + 1, high[step]);
+            continue;
+         }
+
+         // Without one, the range for the last letter only has values
+         // that bring the total to zero, so each one is a solution.
+
+         if(step == letter_count - 1) {
+            solutions_found++;
+            if(print) {
+               for(i = 0; i < letter_count; i++) {
+                  values[order[i]] = tried[i];
+               }
+               print_solution(letter_count, layout->letters, values, output);
+            }
+            if(solutions_found == stop_after) {
+               break;
+            }
+            value = next_free_digit(free_digits, value + 1, high[step]);
+            continue;
+         }
+
+         // Go on to the next letter.
+
+         free_digits &= ~digit_bit(value);
+         totals[step + 1] = totals[step] + weights[step] * value;
+         step++;
+         letter = order[step];
+         linear_range(weights, step, letter_count, totals[step], free_digits,
+                      base, layout->leading[letter] != 0, &low[step],
+                      &high[step]);
+         value = next_free_digit(free_digits, low[step], high[step]);
+      }
+
+      if(table_letters) {
+         free_meet_table(&table);
+      }
+      counters->backtracks = backtrack_count;
+      counters->empty_range = backtrack_count;
+      *difficulty = difficulty_conv(backtrack_count);
+      return(solutions_found);
+   }
+
+
+int solve_linear(
+      char              **summands,        // An array of pointers to the summands.
+      int                 summand_count,   // The number of summands.
+      int                *summand_lengths, // An array with the lengths of the summands.
+      char               *sum,             // The word representing the sum.
+      int                 base,            // The base to solve the puzzle in.
+      int                 print,           // 1 if results to be printed, 0 otherwise.
+      int                 stop_after,      // Stop after this many solutions.  0 for all.
+      long long           table_memory,    // Bytes for a meet in the middle table.
+      output_buffer      *output,          // Where to print.  NULL for stdout.
+      solve_arena        *arena,           // Scratch memory for the layout.
+      search_counters    *counters,        // Return the search's counters here.
+      int                *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // Lay out a puzzle and search it with search_linear.  It must have
+   // passed linear_fits.  The caller gives the arena memory back.
+   {
+      puzzle_layout  layout;
+
+
+      *difficulty = 0;
+      clear_search_counters(counters);
+      layout.smnds = (char *) arena_alloc(arena, MAX_LEN *
+                                          max_of_two(summand_count, 1));
+      if(!lay_out_puzzle(&layout, summands, summand_count, summand_lengths,
+                         sum, base)) {
+         return(0);
+      }
+      return(search_linear(&layout, print, stop_after, table_memory,
+                           output, counters, difficulty));
+   }
+
+
+// Tables of the copies of the search made for specific bases.  The
+// index is the engine, 0 for scan, 1 for mask, and 2 for mask with the
+// stronger pruning.  Bases other than 10 and 16 use the general copy.
+
+typedef int (*solve_instance)(char **, int, int *, int, char *, int, int,
+                              int, solve_split *, int, solve_split_list *,
+                              output_buffer *, solve_arena *, search_counters *,
+                              int *);
+
+static const solve_instance generic_instances[3] = {
+   solve_columns<0, 0, 0>, solve_columns<0, 1, 0>, solve_columns<0, 1, 1>
+};
+
+static const solve_instance base_10_instances[3] = {
+   solve_columns<10, 0, 0>, solve_columns<10, 1, 0>, solve_columns<10, 1, 1>
+};
+
+static const solve_instance base_16_instances[3] = {
+   solve_columns<16, 0, 0>, solve_columns<16, 1, 0>, solve_columns<16, 1, 1>
+};
+
+// The same for searching a puzzle that has already been laid out.
+
+typedef int (*search_instance)(puzzle_layout *, int, int, solve_split *,
+                               int, solve_split_list *, output_buffer *,
+                               search_counters *, int *);
+
+static const search_instance generic_searches[3] = {
+   search_columns<0, 0, 0>, search_columns<0, 1, 0>, search_columns<0, 1, 1>
+};
+
+static const search_instance base_10_searches[3] = {
+   search_columns<10, 0, 0>, search_columns<10, 1, 0>,
+   search_columns<10, 1, 1>
+};
+
+static const search_instance base_16_searches[3] = {
+   search_columns<16, 0, 0>, search_columns<16, 1, 0>,
+   search_columns<16, 1, 1>
+};
+
+
+inline int search_mode(
+      const solve_settings  *settings   // How to search.  NULL for defaults.
+   )
+   // Return the first index into the tables above for the settings.
+   {
+      if(!settings) {
+         return(0);
+      }
+      return(settings->prune ? 2 : (settings->engine != ENGINE_SCAN));
+   }
+
+
+inline int use_linear(
+      const solve_settings  *settings   // How to search.  NULL for defaults.
+   )
+   // Return 1 if the settings are for search_linear.
+   {
+      return(settings && !settings->prune &&
+             (settings->engine == ENGINE_LINEAR ||
+              settings->engine == ENGINE_MEET));
+   }
+
+
+inline long long meet_memory(
+      const solve_settings  *settings   // How to search.  NULL for defaults.
+   )
+   // Return the bytes search_linear can use for its table.
+   {
+      if(!settings || settings->engine != ENGINE_MEET) {
+         return(0);
+      }
+      return((long long) settings->meet_memory << 20);
+   }
+
+
+int solve_part(
+      char              **summands,        // An array of pointers to the summands.
+      int                 summand_count,   // The number of summands.
+      int                *summand_lengths, // An array with the lengths o the summands.
+      int                 longest_summand, // The number of chars in the longest summand.
+      char               *sum,             // The word representing the sum.
+      int                 base,            // The base to solve the puzzle in.
+      int                 print,           // 1 if results to be printed, 0 otherwise.
+      int                 stop_after,      // Stop after this many solutions.  0 for all.
+      const solve_settings *settings,      // How to search.  NULL for defaults.
+      solve_split        *start,           // Piece to solve.  NULL for all of it.
+      int                 split_column,    // Column to split at.  0 to not split.
+      solve_split_list   *splits,          // Where to put the pieces split off.
+      output_buffer      *output,          // Where to print.  NULL for stdout.
+      solve_arena        *arena,           // Scratch memory.  NULL to use its own.
+      search_counters    *counters,        // Return the search's counters here.
+      int                *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // Run the search with the engine chosen in the settings.  See
+   // solve_columns for what the arguments do.  If there is a copy of
+   // the search made for this base, it is used.  Otherwise the general
+   // one is.  Whatever the search takes from the
+   // arena is given back before returning.
+   {
+      solve_instance  instance;
+      solve_arena     local_arena;
+      size_t          mark;
+      int             mask;
+      solve_program   program;
+      int             solutions;
+
+
+      if(!arena) {
+         init_arena(&local_arena);
+         arena = &local_arena;
+      }
+      mark = arena_mark(arena);
+
+      // The program engine falls back to the mask column search for
+      // puzzles it can't compile, which also reports those that are
+      // too long.  Those that compile but have too many letters for
+      // the base have no solutions.  It doesn't do the stronger
+      // pruning, so the column search is used for that too.  So do
+      // the linear and meet in the middle engines for puzzles too big
+      // for them, and when the search is split, which they can't do.
+
+      if(use_linear(settings) && !start && !split_column &&
+            linear_fits(summand_count, longest_summand, strlen(sum), base)) {
+         solutions = solve_linear(summands, summand_count, summand_lengths,
+                                  sum, base, print, stop_after,
+                                  meet_memory(settings), output, arena,
+                                  counters, difficulty);
+      } else if(settings && settings->engine == ENGINE_PROGRAM &&
+            !settings->prune &&
+            compile_puzzle(summands, summand_count, summand_lengths,
+                           longest_summand, sum, &program, arena)) {
+         *difficulty = 0;
+         clear_search_counters(counters);
+         solutions = 0;
+         if(bind_program(&program, base, NULL, NULL)) {
+            solutions = run_program(&program, print, stop_after, start,
+                                    split_column, splits, output,
+                                    counters, difficulty);
+         }
+      } else {
+         mask = search_mode(settings);
+         if(settings && !settings->specialize) {
+            instance = generic_instances[mask];
+         } else if(base == 10) {
+            instance = base_10_instances[mask];
+         } else if(base == 16) {
+            instance = base_16_instances[mask];
+         } else {
+            instance = generic_instances[mask];
+         }
+         solutions = (*instance)(summands, summand_count, summand_lengths,
+                        longest_summand, sum, base, print, stop_after, start,
+                        split_column, splits, output, arena, counters,
+                        difficulty);
+      }
+
+      arena_release(arena, mark);
+      if(arena == &local_arena) {
+         free_arena(&local_arena);
+      }
+      counters->stopped_early = (stop_after && solutions >= stop_after);
+      return(solutions);
+   }
+
+
+int solve_layout(
+      puzzle_layout  *layout,     // The puzzle laid out in columns.
+      int             print,      // 1 if results to be printed, 0 otherwise.
+      int             stop_after, // Stop after this many solutions.  0 for all.
+      const solve_settings *settings, // How to search.  NULL for defaults.
+      output_buffer  *output,     // Where to print.  NULL for stdout.
+      solve_arena    *arena,      // Scratch memory.
+      search_counters *counters,  // Return the search's counters here.
+      int            *difficulty  // The difficulty on a scale of 1 to 10.
+   )
+   // Search a puzzle that has already been laid out, with the engine
+   // chosen in the settings.  This is the same as solve_part for the
+   // whole puzzle, but lets the caller keep the layout and change it
+   // one summand at a time, or solve it again.  The layout isn't
+   // changed.
+   {
+      size_t           mark;
+      int              mask;
+      solve_program    program;
+      search_instance  search;
+      int              solutions;
+
+
+      // The program engine falls back to the mask search for puzzles
+      // it can't compile, the same as in solve_part.  The linear and
+      // meet in the middle engines do for those too big for them.
+
+      mark = arena_mark(arena);
+      if(use_linear(settings) &&
+            linear_fits(layout->summand_count, layout->sum_length,
+                        layout->sum_length, layout->base)) {
+         solutions = search_linear(layout, print, stop_after,
+                                   meet_memory(settings), output, counters,
+                                   difficulty);
+      } else if(settings && settings->engine == ENGINE_PROGRAM &&
+            !settings->prune && compile_layout(layout, &program, arena)) {
+         *difficulty = 0;
+         clear_search_counters(counters);
+         solutions = 0;
+         if(bind_program(&program, layout->base, NULL, NULL)) {
+            solutions = run_program(&program, print, stop_after, NULL, 0,
+                                    NULL, output, counters, difficulty);
+         }
+      } else {
+         mask = search_mode(settings);
+         if(settings && !settings->specialize) {
+            search = generic_searches[mask];
+         } else if(layout->base == 10) {
+            search = base_10_searches[mask];
+         } else if(layout->base == 16) {
+            search = base_16_searches[mask];
+         } else {
+            search = generic_searches[mask];
+         }
+         solutions = (*search)(layout, print, stop_after, NULL, 0, NULL,
+                               output, counters, difficulty);
+      }
+      arena_release(arena, mark);
+      counters->stopped_early = (stop_after && solutions >= stop_after);
+      return(solutions);
+   }
+
+
+int solve(
+      char **summands,        // An array of pointers to the summands.
+      int    summand_count,   // The number of summands.
+      int   *summand_lengths, // An array with the lengths o the summands.
+      int    longest_summand, // The number of chars in the longest summand.
+      char  *sum,             // The word representing the sum.
+      int    base,            // The base to solve the puzzle in.
+      int    print,           // 1 if results to be printed, 0 otherwise.
+      int    stop_after,      // Stop after this many solutions.  0 for all.
+      const solve_settings *settings, // How to search.  NULL for defaults.
+      solve_arena *arena,     // Scratch memory.  NULL to use its own.
+      search_counters *counters, // Return the search's counters.  Can be NULL.
+      int   *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // This function will find solutions to the given alphametic puzzle.
+   // It returns the number of solutions found.  If stop_after isn't 0,
+   // the function will return after finding that many solutions.  If
+   // print is set to a non-zero value, each solution found will be
+   // printed to stdout.
+   {
+      search_counters  local_counters;
+
+
+      return(solve_part(summands, summand_count, summand_lengths,
+                        longest_summand, sum, base, print, stop_after,
+                        settings, NULL, 0, NULL, NULL, arena,
+                        counters ? counters : &local_counters, difficulty));
+   }
+
+
+// The first solutions found by solve_unique, kept so that they can be
+// shown as proof of how many solutions there are.  The letters are in
+// alphabetical order, the same as they are printed.
+
+const int MAX_WITNESSES = 2;
+
+struct solve_witnesses {
+   int   count;                              // Solutions kept.
+   int   letter_count;
+   char  letters[MAX_BASE];
+   int   values[MAX_WITNESSES][MAX_BASE];
+};
+
+
+void keep_witness(
+      void        *context,       // The solve_witnesses to keep it in.
+      int          letter_count,
+      const char  *letters,
+      const int   *values
+   )
+   // A solution_visitor that keeps the first MAX_WITNESSES solutions.
+   {
+      int               i;
+      solve_witnesses  *witnesses = (solve_witnesses *) context;
+
+
+      if(witnesses->count < MAX_WITNESSES) {
+         witnesses->letter_count = letter_count;
+         for(i = 0; i < letter_count; i++) {
+            witnesses->letters[i] = letters[i];
+            witnesses->values[witnesses->count][i] = values[i];
+         }
+         witnesses->count++;
+      }
+   }
+
+
+// What solve_unique found.
+
+const int SOLUTIONS_NONE = 0;
+const int SOLUTIONS_UNIQUE = 1;
+const int SOLUTIONS_AMBIGUOUS = 2;
+
+
+int solve_unique(
+      char **summands,        // An array of pointers to the summands.
+      int    summand_count,   // The number of summands.
+      int   *summand_lengths, // An array with the lengths o the summands.
+      int    longest_summand, // The number of chars in the longest summand.
+      char  *sum,             // The word representing the sum.
+      int    base,            // The base to solve the puzzle in.
+      const solve_settings *settings, // How to search.  NULL for defaults.
+      solve_arena *arena,     // Scratch memory.  NULL to use its own.
+      solve_witnesses *witnesses, // Return the solutions found.  Can be NULL.
+      search_counters *counters, // Return the search's counters.  Can be NULL.
+      int   *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // Find out if a puzzle has no solutions, one, or more than one,
+   // without finding all of them.  The search stops at the second.
+   // Returns SOLUTIONS_NONE, SOLUTIONS_UNIQUE or SOLUTIONS_AMBIGUOUS,
+   // and the solutions it found, at most two, in witnesses.  The
+   // difficulty is only that of the whole puzzle if it isn't ambiguous.
+   {
+      search_counters  local_counters;
+      output_buffer    output;
+      int              solutions;
+
+
+      output.text = NULL;
+      output.length = 0;
+      output.size = 0;
+      output.visit = keep_witness;
+      output.context = witnesses;
+      if(witnesses) {
+         witnesses->count = 0;
+         witnesses->letter_count = 0;
+      }
+      solutions = solve_part(summands, summand_count, summand_lengths,
+                             longest_summand, sum, base, witnesses != NULL,
+                             2, settings, NULL, 0, NULL, &output, arena,
+                             counters ? counters : &local_counters,
+                             difficulty);
+      return(min_of_two(solutions, SOLUTIONS_AMBIGUOUS));
+   }
+
+
+// Solving multiplication puzzles, like this long multiplication, where
+// there is a partial product for each digit of the multiplier:
+//
+//       ABC     multiplicand
+//     *  DE     multiplier
+//     -----
+//      FGHC     partial products, the multiplicand times E and D
+//     JKLB
+//     -----
+//     MNPQC     product
+//
+// The partial products add up to the product whenever each is the
+// multiplicand times its digit and the product is the multiplicand
+// times the multiplier, so only those are checked.  It is done a
+// column at a time from the right.  Once the letters of the factors in
+// the last k columns have values, (A mod base^k)(B mod base^k) is
+// A*B mod base^k, so the last k digits of the product are known, as
+// are those of each partial product whose digit of the multiplier has
+// a value.  The search guesses the letters of the factors in a column,
+// then works out the product's and partial products' digits in that
+// column and gives them to their letters, or backs up if a letter has
+// another value or the digit is taken.  Most letters of the product are
+// never guessed at all.  The factors so far also can't multiply out to
+// more than the product can hold, which cuts off the big ones early.
+//
+// A square root, N gives the root R, is solved as R times R is N.  The
+// lines of working under a long hand square root follow from N and R,
+// so they aren't checked.
+//
+// The values of words here can be all 64 bits, as 16 letters in base
+// 16 are.  In a larger base, the words can't be longer than
+// longest_value_word gives, so that their values still fit.  Every
+// backtrack is counted under one of the reasons in the
+// search_counters, with a digit that doesn't fit its letter counted as
+// previously_mapped and a word's value being too long or too short for
+// it as value_too_large.  column_nodes counts the columns of the
+// product, leftmost first.
+
+const int SEARCH_GO_ON = 0;       // Nothing is wrong so far.
+const int SEARCH_STOP = 1;        // All the solutions wanted are found.
+const int SEARCH_CLASH = 2;       // A digit found doesn't fit its letter.
+const int SEARCH_TOO_LARGE = 3;   // A value doesn't fit its word.
+
+inline int longest_value_word(
+      int  base
+   )
+   // Return the most letters a word can have, up to MAX_LEN, with every
+   // value it can take fitting in 64 bits.
+   {
+      int        length = 0;
+      ulonglong  place = 1;
+
+
+      while(length < MAX_LEN && place <= ULLONG_MAX / base) {
+         place *= base;
+         length++;
+      }
+
+      // base^length can be 2^64 itself, and one more letter still fits.
+
+      if(length < MAX_LEN && place == ULLONG_MAX / base + 1 &&
+            ULLONG_MAX % base == (ulonglong) base - 1) {
+         length++;
+      }
+      return(length);
+   }
+
+
+struct product_layout {
+   int         base;
+   int         letter_count;
+   char        letters[MAX_BASE];          // The letter for each number.
+   char        leading[MAX_BASE];          // 1 if it starts a word.
+   int         lengths[2];                 // Of the multiplicand and multiplier.
+   int         columns;                    // The longer of the two.
+   int         factors[2][MAX_LEN];        // Letter numbers, rightmost first.
+   int         product_length;
+   int         product[MAX_LEN];
+   int         partial_count;              // 0 or the multiplier's length.
+   int         partial_lengths[MAX_LEN];
+   int         partials[MAX_LEN][MAX_LEN];
+   ulonglong   powers[MAX_LEN];            // Of the base.
+   ulonglong   largest[MAX_LEN + 1];       // The largest value with each length.
+};
+
+struct product_search {
+   const product_layout  *layout;
+   int                    values[MAX_BASE];      // -1 if it has none yet.
+   digit_mask             free_digits;           // A bit for each unused digit.
+   int                    set_count;             // Letters with values.
+   int                    forced[MAX_BASE];      // Letters given the digits worked out.
+   int                    forced_count;
+   ulonglong              low[MAX_LEN + 1][2];   // The factors' values right of each column.
+   int                    print;
+   int                    stop_after;
+   int                    solutions;
+   output_buffer         *output;
+   search_counters       *counters;
+};
+
+
+int number_product_word(
+      product_layout  *layout,
+      int             *letter_ids,   // The number of each letter so far, or -1.
+      const char      *word,
+      int             *numbers,      // Return its letter numbers here.
+      int             *length        // Return its length here.
+   )
+   // Number the letters of a word, rightmost first, giving letters not
+   // seen before the next numbers.  Returns 0 if there are more letters
+   // than digits.
+   {
+      int  i;
+      int  letter;
+
+
+      *length = strlen(word);
+      for(i = 0; i < *length; i++) {
+         letter = (unsigned char) word[*length - 1 - i];
+         if(letter_ids[letter] < 0) {
+            if(layout->letter_count == layout->base) {
+               return(0);
+            }
+            letter_ids[letter] = layout->letter_count;
+            layout->letters[layout->letter_count] = letter;
+            layout->leading[layout->letter_count] = 0;
+            layout->letter_count++;
+         }
+         numbers[i] = letter_ids[letter];
+      }
+      layout->leading[numbers[*length - 1]] = 1;
+      return(1);
+   }
+
+
+int lay_out_product(
+      product_layout  *layout,
+      const char      *multiplicand,
+      const char      *multiplier,
+      const char      *product,
+      char           **partials,       // NULL if there are none.
+      int              partial_count,  // 0 or the multiplier's length.
+      int              base
+   )
+   // Number the letters of a multiplication puzzle.  Returns 0 if it
+   // can't have a solution, because there are more letters than digits
+   // or the product is too long or too short for the factors.
+   {
+      int  i;
+      int  letter_ids[128];
+
+
+      layout->base = base;
+      layout->letter_count = 0;
+      for(i = 0; i < 128; i++) {
+         letter_ids[i] = -1;
+      }
+      if(!number_product_word(layout, letter_ids, multiplicand,
+                              layout->factors[0], &layout->lengths[0]) ||
+            !number_product_word(layout, letter_ids, multiplier,
+                                 layout->factors[1], &layout->lengths[1]) ||
+            !number_product_word(layout, letter_ids, product,
+                                 layout->product, &layout->product_length)) {
+         return(0);
+      }
+      layout->partial_count = partial_count;
+      for(i = 0; i < partial_count; i++) {
+         if(!number_product_word(layout, letter_ids, partials[i],
+                                 layout->partials[i],
+                                 &layout->partial_lengths[i])) {
+            return(0);
+         }
+      }
+      layout->columns = max_of_two(layout->lengths[0], layout->lengths[1]);
+      if(layout->product_length < layout->lengths[0] + layout->lengths[1] - 1 ||
+            layout->product_length > layout->lengths[0] + layout->lengths[1]) {
+         return(0);
+      }
+
+      // base^MAX_LEN can be 2^64, which wraps to 0, and one less than
+      // that is still the largest value with MAX_LEN digits.
+
+      layout->powers[0] = 1;
+      layout->largest[0] = 0;
+      for(i = 1; i <= MAX_LEN; i++) {
+         layout->largest[i] = layout->powers[i - 1] * base - 1;
+         if(i < MAX_LEN) {
+            layout->powers[i] = layout->powers[i - 1] * base;
+         }
+      }
+      return(1);
+   }
+
+
+inline int multiply_fits(
+      ulonglong   x,
+      ulonglong   y,
+      ulonglong  *product
+   )
+   // Multiply two values.  Returns 0 if the product won't fit in 64 bits.
+   {
+      if(x != 0 && y > ULLONG_MAX / x) {
+         return(0);
+      }
+      *product = x * y;
+      return(1);
+   }
+
+
+int set_product_digit(
+      product_search  *search,
+      int              letter,
+      int              digit
+   )
+   // Give a letter the digit worked out for it, or check that it
+   // already has it.  Returns SEARCH_CLASH if it has another value, or
+   // if the digit is taken or would be a leading zero.
+   {
+      if(search->values[letter] >= 0) {
+         return((search->values[letter] == digit) ? SEARCH_GO_ON
+                                                  : SEARCH_CLASH);
+      }
+      if(!(search->free_digits & digit_bit(digit)) ||
+            (digit == 0 && search->layout->leading[letter])) {
+         return(SEARCH_CLASH);
+      }
+      search->values[letter] = digit;
+      search->free_digits &= ~digit_bit(digit);
+      search->forced[search->forced_count++] = letter;
+      search->set_count++;
+      search->counters->max_depth = max_of_two(search->counters->max_depth,
+                                               search->set_count);
+      return(SEARCH_GO_ON);
+   }
+
+
+void take_back_product_digits(
+      product_search  *search,
+      int              forced_count   // How many to keep.
+   )
+   // Take back the values given to letters since there were forced_count.
+   {
+      int  letter;
+
+
+      while(search->forced_count > forced_count) {
+         letter = search->forced[--search->forced_count];
+         search->free_digits |= digit_bit(search->values[letter]);
+         search->values[letter] = -1;
+         search->set_count--;
+      }
+   }
+
+
+int check_product_word(
+      product_search  *search,
+      const int       *word,      // Its letter numbers, rightmost first.
+      int              length,
+      ulonglong        value,     // No more than the word's whole value.
+      int              first,     // The columns of the word that are
+      int              last       //    known from value.
+   )
+   // Check that the digits of value from column first to last are
+   // those of the word, giving them to its letters without values.
+   {
+      int                    column;
+      const product_layout  *layout = search->layout;
+      int                    status;
+
+
+      if(value > layout->largest[length]) {
+         return(SEARCH_TOO_LARGE);
+      }
+      for(column = first; column <= last && column < length; column++) {
+         status = set_product_digit(search, word[column],
+                     (int) (value / layout->powers[column] % layout->base));
+         if(status != SEARCH_GO_ON) {
+            return(status);
+         }
+      }
+      return(SEARCH_GO_ON);
+   }
+
+
+void count_search_backtrack(
+      search_counters  *counters,
+      int               status     // What came of the value taken back.
+   )
+   {
+      counters->backtracks++;
+      if(status == SEARCH_CLASH) {
+         counters->previously_mapped++;
+      } else if(status == SEARCH_TOO_LARGE) {
+         counters->value_too_large++;
+      } else {
+         counters->empty_range++;
+      }
+   }
+
+
+int search_product_column(product_search *search, int column);
+
+
+int finish_product(
+      product_search  *search
+   )
+   // All the letters of the factors have values.  Check all of the
+   // product and the partial products, and count the solution if they
+   // are right.
+   {
+      ulonglong              a;
+      ulonglong              b;
+      int                    forced_count = search->forced_count;
+      int                    i;
+      const product_layout  *layout = search->layout;
+      int                    status;
+      ulonglong              value;
+
+
+      a = search->low[layout->columns][0];
+      b = search->low[layout->columns][1];
+      status = SEARCH_TOO_LARGE;
+      if(multiply_fits(a, b, &value) &&
+            value > layout->largest[layout->product_length - 1]) {
+         status = check_product_word(search, layout->product,
+                     layout->product_length, value, 0,
+                     layout->product_length - 1);
+      }
+      for(i = 0; status == SEARCH_GO_ON && i < layout->partial_count; i++) {
+         status = SEARCH_TOO_LARGE;
+         if(multiply_fits(a, search->values[layout->factors[1][i]], &value) &&
+               value > layout->largest[layout->partial_lengths[i] - 1]) {
+            status = check_product_word(search, layout->partials[i],
+                        layout->partial_lengths[i], value, 0,
+                        layout->partial_lengths[i] - 1);
+         }
+      }
+
+      if(status == SEARCH_GO_ON) {
+         search->solutions++;
+         if(search->print) {
+            print_solution(layout->letter_count, layout->letters,
+                           search->values, search->output);
+         }
+         if(search->stop_after && search->solutions >= search->stop_after) {
+            search->counters->stopped_early = 1;
+            status = SEARCH_STOP;
+         }
+      }
+      take_back_product_digits(search, forced_count);
+      return(status);
+   }
+
+
+int check_product_column(
+      product_search  *search,
+      int              column
+   )
+   // The letters of the factors in this column have values.  Work out
+   // the digits of the product and partial products in it, then go on
+   // to the next column.
+   {
+      int                    factor;
+      int                    forced_count = search->forced_count;
+      int                    i;
+      const product_layout  *layout = search->layout;
+      ulonglong             *low = search->low[column + 1];
+      int                    status;
+      ulonglong              value;
+
+
+      for(factor = 0; factor < 2; factor++) {
+         low[factor] = search->low[column][factor];
+         if(column < layout->lengths[factor]) {
+            low[factor] += search->values[layout->factors[factor][column]] *
+                           layout->powers[column];
+         }
+      }
+      search->counters->column_nodes[layout->product_length - 1 - column]++;
+
+      // The product's digit in this column, then the partial products'.
+      // The partial product of this column's digit of the multiplier has
+      // all of its columns so far worked out at once.
+
+      status = SEARCH_TOO_LARGE;
+      if(multiply_fits(low[0], low[1], &value)) {
+         status = check_product_word(search, layout->product,
+                     layout->product_length, value, column, column);
+      }
+      for(i = 0; status == SEARCH_GO_ON && i < layout->partial_count &&
+                 i <= column; i++) {
+         status = SEARCH_TOO_LARGE;
+         if(multiply_fits(low[0], search->values[layout->factors[1][i]],
+                          &value)) {
+            status = check_product_word(search, layout->partials[i],
+                        layout->partial_lengths[i], value,
+                        (i == column) ? 0 : column, column);
+         }
+      }
+
+      if(status == SEARCH_GO_ON) {
+         status = search_product_column(search, column + 1);
+      }
+      take_back_product_digits(search, forced_count);
+      return(status);
+   }
+
+
+int guess_product_letter(
+      product_search  *search,
+      int              column,
+      int              factor      // 0 for the multiplicand, 1 the multiplier.
+   )
+   // Try each free digit for the factor's letter in this column, if it
+   // has one without a value, then go on to the other factor.
+   {
+      int                    letter;
+      const product_layout  *layout = search->layout;
+      int                    status = SEARCH_GO_ON;
+      int                    value;
+
+
+      if(factor == 2) {
+         return(check_product_column(search, column));
+      }
+      if(column >= layout->lengths[factor] ||
+            search->values[layout->factors[factor][column]] >= 0) {
+         return(guess_product_letter(search, column, factor + 1));
+      }
+
+      letter = layout->factors[factor][column];
+      search->set_count++;
+      search->counters->max_depth = max_of_two(search->counters->max_depth,
+                                               search->set_count);
+      for(value = layout->leading[letter]; value < layout->base; value++) {
+         if(!(search->free_digits & digit_bit(value))) {
+            continue;
+         }
+         search->values[letter] = value;
+         search->free_digits &= ~digit_bit(value);
+         status = guess_product_letter(search, column, factor + 1);
+         search->free_digits |= digit_bit(value);
+         if(status == SEARCH_STOP) {
+            break;
+         }
+         count_search_backtrack(search->counters, status);
+      }
+      search->values[letter] = -1;
+      search->set_count--;
+      return((status == SEARCH_STOP) ? SEARCH_STOP : SEARCH_GO_ON);
+   }
+
+
+int search_product_column(
+      product_search  *search,
+      int              column
+   )
+   {
+      if(column < search->layout->columns) {
+         return(guess_product_letter(search, column, 0));
+      }
+      return(finish_product(search));
+   }
+
+
+int solve_product(
+      char             *multiplicand,
+      char             *multiplier,
+      char             *product,
+      char            **partials,      // The partial products for each digit
+                                       //    of the multiplier from the right.
+      int               partial_count, // 0 if they aren't given.
+      int               base,          // The base to solve the puzzle in.
+      int               print,         // Print the solutions or not.
+      int               stop_after,    // Stop after this many solutions.  0 for all.
+      output_buffer    *output,        // Where to print.  NULL for stdout.
+      search_counters  *counters,      // Return the search's counters.
+      int              *difficulty     // The difficulty on a scale of 1 to 5.
+   )
+   // Find the solutions of a multiplication puzzle, with its words
+   // already upcased and checked.  For a square root, give the root as
+   // both factors and the radicand as the product.  Returns the number
+   // of solutions found.
+   {
+      int             i;
+      product_layout  layout;
+      product_search  search;
+
+
+      clear_search_counters(counters);
+      search.solutions = 0;
+      if(lay_out_product(&layout, multiplicand, multiplier, product,
+                         partials, partial_count, base)) {
+         search.layout = &layout;
+         for(i = 0; i < MAX_BASE; i++) {
+            search.values[i] = -1;
+         }
+         search.free_digits = all_digits(base);
+         search.set_count = 0;
+         search.forced_count = 0;
+         search.low[0][0] = 0;
+         search.low[0][1] = 0;
+         search.print = print;
+         search.stop_after = stop_after;
+         search.output = output;
+         search.counters = counters;
+         search_product_column(&search, 0);
+      }
+      *difficulty = difficulty_conv(counters->backtracks);
+      return(search.solutions);
+   }
+
+
+// Solving a system of relations over the same letters, such as the
+// steps of a long division:
+//
+//            FD
+//         ------       EA * F = AFF
+//      EA ) ABCD       ABC - AFF = GH
+//           AFF        EA * D = GHD
+//           ---        GHD - GHD = I
+//            GHD
+//            GHD
+//            ---
+//              I
+//
+// Each relation is a sum and difference of words equal to another, like
+// ABC - DE = FG or AB + CD = EFG, or one word times another equal to a
+// third, like ABC * D = EFGH.  Every relation is checked a column at a
+// time from the right, all with the same letters, so a letter given a
+// value for one relation is checked against all the others at once.
+//
+// lay_out_system plans the search before it starts.  The letters are
+// given values column by column from the right across all of the
+// relations.  Once the letters in the last k columns of a relation have
+// values, the relation's words must agree mod base^k, a sum's words
+// adding up and a product's factors' last digits multiplying out to the
+// product's.  When a letter is the only one without a value in the next
+// column of a relation, and is there once, or is in a product but not
+// its factors, the relation gives its digit, so it is worked out rather
+// than guessed.  Most of the letters in the working of a long division
+// are worked out this way.
+//
+// As with the other puzzles, a word can't start with a zero, even if it
+// is a single letter, unless the system is laid out with single_zero.
+// Then a single letter can be zero, like the last remainder of a
+// division that comes out even.  Backtracks are counted as by
+// solve_product, with no column_nodes.
+
+const int MAX_RELATIONS = 32;
+const int MAX_RELATION_WORDS = 16;
+
+const int RELATION_SUM = 0;        // The words times their signs add to 0.
+const int RELATION_PRODUCT = 1;    // Word 0 times word 1 is word 2.
+
+struct system_word {
+   int  length;
+   int  letters[MAX_LEN];           // Letter numbers, rightmost first.
+   int  sign;                       // 1 or -1 in a sum.
+};
+
+struct system_relation {
+   int          kind;
+   int          word_count;
+   system_word  words[MAX_RELATION_WORDS];
+   int          width;              // Its longest word's length.
+};
+
+struct system_layout {
+   int              base;
+   int              possible;                        // 0 if there are more letters than digits.
+   int              letter_count;
+   char             letters[MAX_BASE];               // The letter for each number.
+   char             leading[MAX_BASE];               // 1 if it can't be zero.
+   int              relation_count;
+   system_relation  relations[MAX_RELATIONS];
+   int              order[MAX_BASE];                 // The letter given a value at each step.
+   int              forced_by[MAX_BASE];             // The relation that works it out, or -1.
+   int              forced_column[MAX_BASE];
+   int              check_count[MAX_BASE];           // Relations to check after each step.
+   int              checks[MAX_BASE][MAX_RELATIONS];
+   int              check_columns[MAX_BASE][MAX_RELATIONS];   // The columns known.
+   ulonglong        powers[MAX_LEN + 1];             // Of the base.  0 for 2^64.
+};
+
+struct system_search {
+   const system_layout  *layout;
+   int                   values[MAX_BASE];           // -1 if it has none yet.
+   digit_mask            free_digits;                // A bit for each unused digit.
+   int                   print;
+   int                   stop_after;
+   int                   solutions;
+   output_buffer        *output;
+   search_counters      *counters;
+};
+
+
+inline ulonglong add_mod(
+      ulonglong  x,
+      ulonglong  y,
+      ulonglong  m          // 0 for 2^64.
+   )
+   // x + y mod m, for x and y less than m.
+   {
+      x += y;
+      if(m != 0 && (x < y || x >= m)) {
+         x -= m;
+      }
+      return(x);
+   }
+
+
+inline ulonglong subtract_mod(
+      ulonglong  x,
+      ulonglong  y,
+      ulonglong  m          // 0 for 2^64.
+   )
+   // x - y mod m, for x and y less than m.
+   {
+      return((y == 0) ? x : add_mod(x, m - y, m));
+   }
+
+
+const char *parse_relation(
+      char             *text,
+      system_relation  *relation,
+      system_layout    *layout,
+      int              *letter_ids,  // The number of each letter so far, or -1.
+      int               single_zero, // 1 if a word of one letter can be zero.
+      alphabet         *letters      // The chars given to letters past Z.
+   )
+   // Read a relation like ABC - DE = FG or ABC * D = EFGH, numbering
+   // the letters not seen before and marking those that start a word
+   // as leading.  Lower case letters are upcased and spaces are
+   // skipped.  Returns NULL, or a message saying what is wrong.
+   {
+      int           i;
+      int           letter;
+      const char   *p = text;
+      int           side = 0;          // 0 left of the equals sign, 1 right.
+      int           side_words[2] = {0, 0};
+      int           sign = 1;
+      int           star_count = 0;
+      int           star_side = 0;
+      system_word   swap;
+      system_word  *word;
+      char          word_text[MAX_LEN];
+
+
+      relation->word_count = 0;
+      relation->width = 0;
+      for(;;) {
+
+         // Read a word.
+
+         while(*p == ' ') {
+            p++;
+         }
+         if(relation->word_count == MAX_RELATION_WORDS) {
+            return("A relation can have no more than 16 words.");
+         }
+         word = &relation->words[relation->word_count];
+         for(word->length = 0;
+               (letter = read_letter(&p, p + strlen(p), 1, letters)) > 0; ) {
+            if(word->length == MAX_LEN) {
+               return("Words must be letters, no more than 16 of them.");
+            }
+            word_text[word->length++] = letter;
+         }
+         if(letter == NO_LETTERS_LEFT) {
+            return("There can be no more than 37 letters other than A to Z.");
+         }
+         if(word->length == 0) {
+            return("Relations are words joined by +, -, * and one =.");
+         }
+         for(i = 0; i < word->length; i++) {
+            letter = word_text[word->length - 1 - i];
+            if(letter_ids[letter] < 0) {
+               if(layout->letter_count == layout->base) {
+                  layout->possible = 0;
+               } else {
+                  letter_ids[letter] = layout->letter_count;
+                  layout->letters[layout->letter_count] = letter;
+                  layout->leading[layout->letter_count] = 0;
+                  layout->letter_count++;
+               }
+            }
+            word->letters[i] = max_of_two(letter_ids[letter], 0);
+         }
+         if((word->length > 1 || !single_zero) &&
+               letter_ids[(int) word_text[0]] >= 0) {
+            layout->leading[letter_ids[(int) word_text[0]]] = 1;
+         }
+         word->sign = side ? -sign : sign;
+         relation->width = max_of_two(relation->width, word->length);
+         relation->word_count++;
+         side_words[side]++;
+
+         // Then what joins it to the next.
+
+         while(*p == ' ') {
+            p++;
+         }
+         if(*p == '\0') {
+            break;
+         } else if(*p == '+' || *p == '-') {
+            sign = (*p == '+') ? 1 : -1;
+         } else if(*p == '*') {
+            star_count++;
+            star_side = side;
+         } else if(*p == '=' && side == 0) {
+            side = 1;
+            sign = 1;
+         } else {
+            return("Relations are words joined by +, -, * and one =.");
+         }
+         p++;
+      }
+
+      if(side == 0) {
+         return("A relation needs an = sign.");
+      }
+      relation->kind = RELATION_SUM;
+      if(star_count > 0) {
+         if(star_count > 1 || side_words[star_side] != 2 ||
+               side_words[1 - star_side] != 1) {
+            return("A product must be one word times another equal to a third.");
+         }
+
+         // Put the factors first.
+
+         if(star_side == 1) {
+            swap = relation->words[0];
+            relation->words[0] = relation->words[1];
+            relation->words[1] = relation->words[2];
+            relation->words[2] = swap;
+         }
+         relation->kind = RELATION_PRODUCT;
+      }
+      return(NULL);
+   }
+
+
+int relation_columns_known(
+      const system_relation  *relation,
+      const int              *known       // 1 for each letter with a value.
+   )
+   // The number of columns from the right whose letters all have values.
+   {
+      int  column;
+      int  i;
+
+
+      for(column = 0; column < relation->width; column++) {
+         for(i = 0; i < relation->word_count; i++) {
+            if(column < relation->words[i].length &&
+                  !known[relation->words[i].letters[column]]) {
+               return(column);
+            }
+         }
+      }
+      return(relation->width);
+   }
+
+
+int relation_forces(
+      const system_relation  *relation,
+      const int              *known,      // 1 for each letter with a value.
+      int                     letter,
+      int                    *column      // Return the column it is in.
+   )
+   // Returns 1 if the relation can work out the letter's digit from
+   // those of the letters that have values.
+   {
+      int  count = 0;
+      int  i;
+      int  net_sign = 0;
+
+
+      *column = relation_columns_known(relation, known);
+      if(*column == relation->width) {
+         return(0);
+      }
+      for(i = 0; i < relation->word_count; i++) {
+         if(*column < relation->words[i].length) {
+            if(relation->words[i].letters[*column] == letter) {
+               if(relation->kind == RELATION_PRODUCT && i < 2) {
+                  return(0);
+               }
+               net_sign += relation->words[i].sign;
+               count++;
+            } else if(!known[relation->words[i].letters[*column]]) {
+               return(0);
+            }
+         }
+      }
+      return(count > 0 &&
+             (relation->kind == RELATION_PRODUCT || net_sign == 1 ||
+              net_sign == -1));
+   }
+
+
+const char *lay_out_system(
+      system_layout  *layout,
+      char          **relations,
+      int             relation_count,
+      int             base,
+      int             single_zero,    // 1 if a word of one letter can be zero.
+      alphabet       *letters         // The chars given to letters past Z.
+   )
+   // Read the relations and plan the search.  Returns NULL, or a message
+   // saying what is wrong with them.  The layout's possible is 0 if they
+   // can't have a solution.
+   {
+      int               column;
+      const char       *error;
+      int               i;
+      int               j;
+      int               known[MAX_BASE];
+      int               letter;
+      int               letter_ids[128];
+      system_relation  *relation;
+      int               step;
+      int               before[MAX_RELATIONS];
+      int               width = 0;
+
+
+      if(relation_count < 1 || relation_count > MAX_RELATIONS) {
+         return("There must be from 1 to 32 relations.");
+      }
+      layout->base = base;
+      layout->possible = 1;
+      layout->letter_count = 0;
+      layout->relation_count = relation_count;
+      for(i = 0; i < 128; i++) {
+         letter_ids[i] = -1;
+      }
+      for(i = 0; i < relation_count; i++) {
+         error = parse_relation(relations[i], &layout->relations[i], layout,
+                                letter_ids, single_zero, letters);
+         if(error != NULL) {
+            return(error);
+         }
+         width = max_of_two(width, layout->relations[i].width);
+      }
+      if(width > longest_value_word(base)) {
+         return("A word is too long for its value to fit in 64 bits in this base.");
+      }
+      if(!layout->possible) {
+         return(NULL);
+      }
+
+      layout->powers[0] = 1;
+      for(i = 1; i <= MAX_LEN; i++) {
+         layout->powers[i] = layout->powers[i - 1] * base;
+      }
+
+      // Order the letters by the rightmost column they are in, in any
+      // relation.
+
+      step = 0;
+      for(i = 0; i < layout->letter_count; i++) {
+         known[i] = 0;
+      }
+      for(column = 0; column < width; column++) {
+         for(i = 0; i < relation_count; i++) {
+            relation = &layout->relations[i];
+            for(j = 0; j < relation->word_count; j++) {
+               if(column < relation->words[j].length) {
+                  letter = relation->words[j].letters[column];
+                  if(!known[letter]) {
+                     known[letter] = 1;
+                     layout->order[step++] = letter;
+                  }
+               }
+            }
+         }
+      }
+
+      // Then find which can be worked out, and which relations to check
+      // after each step.
+
+      for(i = 0; i < layout->letter_count; i++) {
+         known[i] = 0;
+      }
+      for(i = 0; i < relation_count; i++) {
+         before[i] = 0;
+      }
+      for(step = 0; step < layout->letter_count; step++) {
+         letter = layout->order[step];
+         layout->forced_by[step] = -1;
+         for(i = 0; i < relation_count && layout->forced_by[step] < 0; i++) {
+            if(relation_forces(&layout->relations[i], known, letter,
+                               &column)) {
+               layout->forced_by[step] = i;
+               layout->forced_column[step] = column;
+            }
+         }
+
+         known[letter] = 1;
+         layout->check_count[step] = 0;
+         for(i = 0; i < relation_count; i++) {
+            column = relation_columns_known(&layout->relations[i], known);
+            if(column > before[i]) {
+               layout->checks[step][layout->check_count[step]] = i;
+               layout->check_columns[step][layout->check_count[step]] = column;
+               layout->check_count[step]++;
+               before[i] = column;
+            }
+         }
+      }
+      return(NULL);
+   }
+
+
+ulonglong system_word_value(
+      const system_search  *search,
+      const system_word    *word,
+      int                   columns     // How many from the right.
+   )
+   // The value of the last columns of a word, counting letters without
+   // values as 0.
+   {
+      int        column;
+      ulonglong  value = 0;
+
+
+      for(column = min_of_two(columns, word->length) - 1; column >= 0;
+          column--) {
+         value = value * search->layout->base +
+                 max_of_two(search->values[word->letters[column]], 0);
+      }
+      return(value);
+   }
+
+
+void add_wide(
+      ulonglong  *high,
+      ulonglong  *low,
+      ulonglong   value
+   )
+   // Add a value to a 128 bit total.
+   {
+      *low += value;
+      if(*low < value) {
+         (*high)++;
+      }
+   }
+
+
+int check_relation(
+      const system_search    *search,
+      const system_relation  *relation,
+      int                     columns     // How many from the right have values.
+   )
+   // Check that the last columns of a relation's words agree, and that
+   // all of it is right once all of its columns have values.
+   {
+      int        i;
+      ulonglong  modulus = search->layout->powers[columns];
+      ulonglong  high[2] = {0, 0};
+      ulonglong  low[2] = {0, 0};
+      ulonglong  value;
+
+
+      if(relation->kind == RELATION_PRODUCT) {
+         if(!multiply_fits(system_word_value(search, &relation->words[0], columns),
+                           system_word_value(search, &relation->words[1], columns),
+                           &value) ||
+               (relation->words[2].length < MAX_LEN &&
+                value >= search->layout->powers[relation->words[2].length])) {
+            return(SEARCH_TOO_LARGE);
+         }
+         if(columns < relation->width && modulus != 0) {
+            value %= modulus;
+         }
+         return((value == system_word_value(search, &relation->words[2], columns))
+                   ? SEARCH_GO_ON : SEARCH_CLASH);
+      }
+
+      // A sum's words with a sign of 1 on one side and -1 on the other.
+      // All of it is checked exactly, or just its last columns mod
+      // base^columns.
+
+      for(i = 0; i < relation->word_count; i++) {
+         value = system_word_value(search, &relation->words[i], columns);
+         if(columns == relation->width) {
+            add_wide(&high[relation->words[i].sign < 0],
+                     &low[relation->words[i].sign < 0], value);
+         } else {
+            low[relation->words[i].sign < 0] =
+                  add_mod(low[relation->words[i].sign < 0], value, modulus);
+         }
+      }
+      return((high[0] == high[1] && low[0] == low[1]) ? SEARCH_GO_ON
+                                                      : SEARCH_CLASH);
+   }
+
+
+int work_out_digit(
+      const system_search  *search,
+      int                   step
+   )
+   // The digit that the relation the layout gives for a step needs its
+   // letter to have.  Returns -1 if there isn't one.
+   {
+      int                     column;
+      int                     i;
+      const system_layout    *layout = search->layout;
+      int                     net_sign = 0;
+      ulonglong               modulus;
+      ulonglong               product;
+      const system_relation  *relation;
+      ulonglong               total[2] = {0, 0};
+      ulonglong               value;
+
+
+      relation = &layout->relations[layout->forced_by[step]];
+      column = layout->forced_column[step];
+      if(relation->kind == RELATION_PRODUCT) {
+         if(!multiply_fits(
+                  system_word_value(search, &relation->words[0], column + 1),
+                  system_word_value(search, &relation->words[1], column + 1),
+                  &product)) {
+            return(-1);
+         }
+         return((int) (product / layout->powers[column] % layout->base));
+      }
+
+      // With the letter counted as 0, the words' totals on each side
+      // differ by its digit times base^column, mod base^(column + 1).
+
+      modulus = layout->powers[column + 1];
+      for(i = 0; i < relation->word_count; i++) {
+         value = system_word_value(search, &relation->words[i], column + 1);
+         total[relation->words[i].sign < 0] =
+               add_mod(total[relation->words[i].sign < 0], value, modulus);
+         if(column < relation->words[i].length &&
+               relation->words[i].letters[column] == layout->order[step]) {
+            net_sign += relation->words[i].sign;
+         }
+      }
+      if(net_sign > 0) {
+         value = subtract_mod(total[1], total[0], modulus);
+      } else {
+         value = subtract_mod(total[0], total[1], modulus);
+      }
+      return((int) (value / layout->powers[column]));
+   }
+
+
+int search_system_step(
+      system_search  *search,
+      int             step
+   )
+   // Give the letter at this step each value it can have, or the one a
+   // relation works out for it, check the relations that can be checked
+   // and go on to the next step.
+   {
+      int                   first;
+      int                   i;
+      int                   last;
+      int                   letter;
+      const system_layout  *layout = search->layout;
+      int                   status = SEARCH_GO_ON;
+      int                   value;
+
+
+      if(step == layout->letter_count) {
+         search->solutions++;
+         if(search->print) {
+            print_solution(layout->letter_count, layout->letters,
+                           search->values, search->output);
+         }
+         if(search->stop_after && search->solutions >= search->stop_after) {
+            search->counters->stopped_early = 1;
+            return(SEARCH_STOP);
+         }
+         return(SEARCH_GO_ON);
+      }
+
+      letter = layout->order[step];
+      first = layout->leading[letter];
+      last = layout->base - 1;
+      if(layout->forced_by[step] >= 0) {
+         first = work_out_digit(search, step);
+         if(first < 0) {
+            return(SEARCH_TOO_LARGE);
+         }
+         if(!(search->free_digits & digit_bit(first)) ||
+               (first == 0 && layout->leading[letter])) {
+            return(SEARCH_CLASH);
+         }
+         last = first;
+      }
+      search->counters->max_depth = max_of_two(search->counters->max_depth,
+                                               step + 1);
+
+      for(value = first; value <= last; value++) {
+         if(!(search->free_digits & digit_bit(value))) {
+            continue;
+         }
+         search->values[letter] = value;
+         search->free_digits &= ~digit_bit(value);
+         status = SEARCH_GO_ON;
+         for(i = 0; status == SEARCH_GO_ON && i < layout->check_count[step];
+             i++) {
+            status = check_relation(search,
+                        &layout->relations[layout->checks[step][i]],
+                        layout->check_columns[step][i]);
+         }
+         if(status == SEARCH_GO_ON) {
+            status = search_system_step(search, step + 1);
+         }
+         search->free_digits |= digit_bit(value);
+         search->values[letter] = -1;
+         if(status == SEARCH_STOP) {
+            return(SEARCH_STOP);
+         }
+
+         // A worked out digit that fails isn't a guess taken back, so
+         // the step that guessed counts it.
+
+         if(layout->forced_by[step] >= 0) {
+            return(status);
+         }
+         count_search_backtrack(search->counters, status);
+      }
+      return(SEARCH_GO_ON);
+   }
+
+
+int solve_system(
+      const system_layout  *layout,
+      int                   print,       // Print the solutions or not.
+      int                   stop_after,  // Stop after this many solutions.  0 for all.
+      output_buffer        *output,      // Where to print.  NULL for stdout.
+      search_counters      *counters,    // Return the search's counters.
+      int                  *difficulty   // The difficulty on a scale of 1 to 5.
+   )
+   // Find the solutions of a system of relations laid out by
+   // lay_out_system.  Returns the number found.
+   {
+      int            i;
+      system_search  search;
+
+
+      clear_search_counters(counters);
+      search.solutions = 0;
+      if(layout->possible) {
+         search.layout = layout;
+         for(i = 0; i < MAX_BASE; i++) {
+            search.values[i] = -1;
+         }
+         search.free_digits = all_digits(layout->base);
+         search.print = print;
+         search.stop_after = stop_after;
+         search.output = output;
+         search.counters = counters;
+         search_system_step(&search, 0);
+      }
+      *difficulty = difficulty_conv(counters->backtracks);
+      return(search.solutions);
+   }
+
+
+// Split searches are cut at the first column that has at least this
+// many different letters to its left.  The column is moved to the
+// right until there are enough pieces to keep the threads busy, but
+// not so far that the pieces become too many to hold.
+
+const int SPLIT_LETTERS = 3;
+const int SPLIT_PIECES_PER_THREAD = 8;
+const int MAX_SPLIT_PIECES = 65536;
+
+// The pieces of a split search and what came of solving each.  The
+// threads take the next piece to solve from next_piece.
+
+struct split_work {
+   char               **summands;
+   int                  summand_count;
+   int                 *summand_lengths;
+   int                  longest_summand;
+   char                *sum;
+   int                  base;
+   int                  print;
+   const solve_settings *settings;
+   solve_program       *program;   // The compiled puzzle or NULL.
+   solve_split_list    *splits;
+   int                 *solutions;
+   search_counters     *counters;  // The counters of each thread.
+   output_buffer       *outputs;
+   std::atomic<int>     next_piece;
+};
+
+
+void split_worker(
+      split_work  *work,
+      int          thread_index
+   )
+   // The function run by each thread solving pieces of a split search.
+   // The counters of the pieces it solves are added to its own.
+   {
+      solve_arena      arena;
+      search_counters  counters;
+      int              difficulty;
+      int              piece;
+
+
+      init_arena(&arena);
+      while((piece = work->next_piece++) < work->splits->count) {
+         if(work->program) {
+            work->solutions[piece] = run_program(work->program, work->print,
+                  0, &work->splits->splits[piece], 0, NULL,
+                  work->print ? &work->outputs[piece] : NULL,
+                  &counters, &difficulty);
+         } else {
+            work->solutions[piece] = solve_part(work->summands,
+                  work->summand_count, work->summand_lengths,
+                  work->longest_summand, work->sum, work->base, work->print,
+                  0, work->settings, &work->splits->splits[piece], 0, NULL,
+                  work->print ? &work->outputs[piece] : NULL, &arena,
+                  &counters, &difficulty);
+         }
+         add_search_counters(&work->counters[thread_index], &counters);
+      }
+      free_arena(&arena);
+   }
+
+
+int solve_parallel(
+      char **summands,        // An array of pointers to the summands.
+      int    summand_count,   // The number of summands.
+      int   *summand_lengths, // An array with the lengths o the summands.
+      int    longest_summand, // The number of chars in the longest summand.
+      char  *sum,             // The word representing the sum.
+      int    base,            // The base to solve the puzzle in.
+      int    print,           // 1 if results to be printed, 0 otherwise.
+      const solve_settings *settings, // How to search.  NULL for defaults.
+      int    thread_count,    // The number of threads to use.
+      search_counters *counters, // Return the search's counters.  Can be NULL.
+      int   *difficulty       // The difficulty on a scale of 1 to 10.
+   )
+   // This finds all of the solutions to a puzzle, the same as solve,
+   // but splits the search into pieces that are solved by thread_count
+   // threads.  The solutions are printed in the same order that solve
+   // would print them and the difficulty and counters are the same.
+   {
+      int                column;
+      int                curr_char;
+      int                first_split;
+      int                i;
+      int                letter_count = 0;
+      char               letter_used[128];
+      solve_arena        arena;
+      search_counters    local_counters;
+      search_counters    prefix_counters;
+      int                row;
+      int                split_column = 0;
+      solve_split_list   splits;
+      int                solutions_found;
+      int                sum_length = strlen(sum);
+      std::thread       *threads;
+      split_work         work;
+
+
+      // Find the first column with enough different letters to its
+      // left.  The summands line up with the right end of the sum.
+
+      memset(letter_used, 0, sizeof(letter_used));
+      for(column = 0; column < sum_length - 1 && split_column == 0; column++) {
+         curr_char = sum[column];
+         if(!letter_used[curr_char]) {
+            letter_used[curr_char] = 1;
+            letter_count++;
+         }
+         for(i = 0; i < summand_count; i++) {
+            row = summand_lengths[i] - (sum_length - column);
+            if(row >= 0) {
+               curr_char = summands[i][row];
+               if(!letter_used[curr_char]) {
+                  letter_used[curr_char] = 1;
+                  letter_count++;
+               }
+            }
+         }
+         if(letter_count >= SPLIT_LETTERS) {
+            split_column = column + 1;
+         }
+      }
+
+      // The linear and meet in the middle engines can't split their
+      // search, so they solve the whole puzzle on one thread.
+
+      if(use_linear(settings) && linear_fits(summand_count, longest_summand, sum_length, base)) {
+         split_column = 0;
+      }
+
+      // Split the search, moving the split to the right until there
+      // are enough pieces.  If the puzzle is too small to split, just
+      // solve it.
+
+      init_arena(&arena);
+      splits.size = MAX_SPLIT_PIECES;
+      splits.splits = new solve_split[splits.size];
+      splits.count = 0;
+      first_split = split_column;
+      while(split_column > 0) {
+         splits.count = 0;
+         splits.overflow = 0;
+         solve_part(summands, summand_count, summand_lengths,
+                    longest_summand, sum, base, 0, 0, settings, NULL, split_column,
+                    &splits, NULL, &arena, &prefix_counters, difficulty);
+         if(splits.overflow) {
+            if(split_column == first_split) {
+               split_column = 0;
+               break;
+            }
+            split_column--;
+            splits.count = 0;
+            splits.overflow = 0;
+            solve_part(summands, summand_count, summand_lengths,
+                       longest_summand, sum, base, 0, 0, settings, NULL, split_column,
+                       &splits, NULL, &arena, &prefix_counters, difficulty);
+            break;
+         }
+         if(*difficulty == 0 ||
+               splits.count >= thread_count * SPLIT_PIECES_PER_THREAD ||
+               split_column == sum_length - 1) {
+            break;
+         }
+         split_column++;
+      }
+      if(split_column == 0 || *difficulty == 0) {
+         delete [] splits.splits;
+         solutions_found = solve(summands, summand_count, summand_lengths,
+                                 longest_summand, sum, base, print, 0,
+                                 settings, &arena, counters, difficulty);
+         free_arena(&arena);
+         return(solutions_found);
+      }
+
+      // Have the threads solve the pieces.
+
+      work.summands = summands;
+      work.summand_count = summand_count;
+      work.summand_lengths = summand_lengths;
+      work.longest_summand = longest_summand;
+      work.sum = sum;
+      work.base = base;
+      work.print = print;
+      work.settings = settings;
+      work.splits = &splits;
+
+      // The program engine compiles the puzzle once and all of the
+      // threads search the same copy.
+
+      work.program = NULL;
+      if(settings && settings->engine == ENGINE_PROGRAM && !settings->prune) {
+         work.program = new solve_program;
+         if(!compile_puzzle(summands, summand_count, summand_lengths,
+                            longest_summand, sum, work.program, &arena)) {
+            delete work.program;
+            work.program = NULL;
+         } else {
+            bind_program(work.program, base, NULL, NULL);
+         }
+      }
+      work.solutions = new int[splits.count];
+      work.counters = new search_counters[thread_count];
+      for(i = 0; i < thread_count; i++) {
+         clear_search_counters(&work.counters[i]);
+      }
+      work.outputs = new output_buffer[splits.count];
+      for(i = 0; i < splits.count; i++) {
+         work.outputs[i].text = NULL;
+         work.outputs[i].visit = NULL;
+         work.outputs[i].length = 0;
+         work.outputs[i].size = 0;
+      }
+      work.next_piece = 0;
+
+      threads = new std::thread[thread_count];
+      for(i = 0; i < thread_count; i++) {
+         threads[i] = std::thread(split_worker, &work, i);
+      }
+      for(i = 0; i < thread_count; i++) {
+         threads[i].join();
+      }
+      delete [] threads;
+
+      // Print the solutions in order and add up the counts.
+
+      solutions_found = 0;
+      for(i = 0; i < splits.count; i++) {
+         if(work.outputs[i].length) {
+            fputs(work.outputs[i].text, stdout);
+         }
+         delete [] work.outputs[i].text;
+         solutions_found += work.solutions[i];
+      }
+      if(!counters) {
+         counters = &local_counters;
+      }
+      *counters = prefix_counters;
+      for(i = 0; i < thread_count; i++) {
+         add_search_counters(counters, &work.counters[i]);
+      }
+      *difficulty = difficulty_conv(counters->backtracks);
+
+      delete work.program;
+      free_arena(&arena);
+      delete [] work.outputs;
+      delete [] work.counters;
+      delete [] work.solutions;
+      delete [] splits.splits;
+      return(solutions_found);
+   }
+
+
+int upcase_and_check_legality(
+      char *string,        // The string to upcase and check.
+      int  *string_length  // Return the length of the string here.
+   )
+   // This function will upcase the string passsed in as well as
+   // checking to make sure it only contains letters and that it is no
+   // longer than MAX_LEN.  The string is UTF-8, and it is changed to
+   // a char for each letter as read_letter gives them.  Any leading or
+   // following whitespace will be removed.  If there is a problem with
+   // the string, an appropriate error message will be generated and
+   // zero will be returned.  A good string results in this returning 1.
+   {
+      const char  *ch_p = string;
+      int          length = strlen(string);
+      int          letter;
+      char        *new_p;
+      char        *new_str;
+      int          result = 1;
+
+
+      // Allocate space to copy the string into.  We don't just modify
+      // it in place so that if we have to print an error message
+      // the string is still in its original form.
+
+      new_str = new char[length + 1];
+      new_p = new_str;
+
+      // Detect any leading whitespace and ignore it.
+
+      while(*ch_p == ' ' || *ch_p == '\t') {
+         ch_p++;
+      }
+
+      // Now move through the string upcasing any characters and insuring
+      // that all characters are letters.  Copy them to the new string
+      // as we go.  Each letter takes at least one byte, so there is
+      // always room.
+
+      while(*ch_p != '\0' && *ch_p != ' ' && *ch_p != '\t') {
+         letter = read_letter(&ch_p, string + length, 1, &run_letters);
+
+         // Check for bad character.  It is copied as it is.
+
+         if(letter <= 0) {
+            if(result && letter == NO_LETTERS_LEFT) {
+               printf("There can be no more than %d letters other than A to Z.  Problem with: %s\n",
+                      EXTRA_LETTERS, string);
+            } else if(result) {
+               printf("Words must contain only letters.  Problem with: %s\n", string);
+            }
+            result = 0;
+            letter = *ch_p++;
+         }
+         *new_p++ = letter;
+      }
+
+      // If there is whitespace, it's either at the end of the string
+      // and we'll just ignore it or it's in the middle, in which case
+      // it's an error.  Search for the first non-whitespace character.
+
+      while(*ch_p == ' ' || *ch_p == '\t') {
+         ch_p++;
+      }
+
+      // If we found a null, all is okay.  Put a null at the end of
+      // the string.  Note that if there was no whitespace at the end,
+      // this is a no-op.  Report an error if we didn't find a null.
+
+      *new_p = '\0';
+      if(result && *ch_p != '\0') {
+         printf("Words must contain only letters.  Problem with: %s\n", string);
+         result = 0;
+      }
+
+      // Check the length of the string and report an error if too long.
+
+      length = new_p - new_str;
+      if(new_p - new_str > MAX_LEN) {
+         printf("Words can't be longer than %d characters.  %s is too long.\n", MAX_LEN, string);
+         result = 0;
+      }
+
+      // Now copy the upcased string back to the one passed in, delete
+      // the allocated memory, and return the result.
+
+      strcpy(string, new_str);
+      delete [] new_str;
+      *string_length = length;
+      return(result);
+   }
+
+
+// The words that summands are taken from, sorted by length and then
+// by the bit map of their letters, with ties kept in the order they
+// were given.  The summands of a puzzle are chosen in this order, so
+// those that are too long for a sum are all at the end and can be left
+// off, and the words with the same letters are together in a bucket
+// that can be passed over all at once when their letters would make
+// too many.  Sums are still tried in the order the words were given,
+// and the summands of a puzzle found are printed and rated in that
+// order too.
+
+struct word_index {
+   char  **words;                     // The words in sorted order.
+   int    *lengths;                   // Their lengths.
+   digit_mask *letters;               // The bit maps of their letters.
+   int    *bucket_end;                // One past the last word in the bucket.
+   int    *position;                  // Where each given word was put.
+   int    *given;                     // Where each word here was given.
+   int     length_end[MAX_LEN + 1];   // One past the last word this long.
+};
+
+struct index_entry {
+   int         length;
+   digit_mask  letters;
+   int         word;      // Where the word was given.
+};
+
+
+int compare_index_entries(
+      const void  *first,
+      const void  *second
+   )
+   // Order index_entry structs by length, then letters, then where the
+   // word was given, for qsort.  No two are the same, so the order
+   // doesn't depend on the sort.
+   {
+      const index_entry  *a = (const index_entry *) first;
+      const index_entry  *b = (const index_entry *) second;
+
+
+      if(a->length != b->length) {
+         return(a->length - b->length);
+      }
+      if(a->letters != b->letters) {
+         return((a->letters > b->letters) - (a->letters < b->letters));
+      }
+      return(a->word - b->word);
+   }
+
+
+void build_word_index(
+      char        **words,          // The words as given.
+      int           word_count,
+      int          *word_lengths,
+      digit_mask   *letters_used,   // Bit map of the letters in each word.
+      word_index   *index           // The index to fill in.
+   )
+   // Sort the words into an index.  free_word_index gives back its
+   // arrays.
+   {
+      index_entry  *entries;
+      int           i;
+      int           length;
+
+
+      entries = new index_entry[max_of_two(word_count, 1)];
+      for(i = 0; i < word_count; i++) {
+         entries[i].length = word_lengths[i];
+         entries[i].letters = letters_used[i];
+         entries[i].word = i;
+      }
+      qsort(entries, word_count, sizeof(index_entry), compare_index_entries);
+
+      index->words = new char*[word_count];
+      index->lengths = new int[word_count];
+      index->letters = new digit_mask[word_count];
+      index->bucket_end = new int[word_count];
+      index->position = new int[word_count];
+      index->given = new int[word_count];
+      for(i = 0; i < word_count; i++) {
+         index->words[i] = words[entries[i].word];
+         index->lengths[i] = entries[i].length;
+         index->letters[i] = entries[i].letters;
+         index->position[entries[i].word] = i;
+         index->given[i] = entries[i].word;
+      }
+
+      // Work back from the end to find where each bucket ends.
+
+      for(i = word_count - 1; i >= 0; i--) {
+         if(i == word_count - 1 || index->lengths[i + 1] != index->lengths[i]
+                                || index->letters[i + 1] != index->letters[i]) {
+            index->bucket_end[i] = i + 1;
+         } else {
+            index->bucket_end[i] = index->bucket_end[i + 1];
+         }
+      }
+
+      // And where the words of each length end.
+
+      i = 0;
+      for(length = 0; length <= MAX_LEN; length++) {
+         while(i < word_count && index->lengths[i] <= length) {
+            i++;
+         }
+         index->length_end[length] = i;
+      }
+      delete [] entries;
+   }
+
+
+void free_word_index(
+      word_index  *index
+   )
+   {
+      delete [] index->words;
+      delete [] index->lengths;
+      delete [] index->letters;
+      delete [] index->bucket_end;
+      delete [] index->position;
+      delete [] index->given;
+   }
+
+
+// Information about a search for puzzles with a specific number of
+// summands.  Nothing in here changes during the search, so it can be
+// shared by all of the threads looking for puzzles.
+
+struct find_info {
+   char  **words;          // The words to build puzzles from.
+   int     word_count;     // The number of words.
+   int     base;           // The base to solve the puzzles in.
+   int    *word_lengths;   // The lengths of the words.
+   digit_mask *letters_used;  // Bit map of the letters in each word.
+   const word_index *index;  // The words sorted to pick summands from.
+   int     summand_count;  // The number of summands in each puzzle.
+   int     exactly_one;    // 1 if only unique puzzles are wanted.
+   int     disallow_rep;   // 1 if a word can't be used more than once.
+   int     print;          // 1 if the good puzzles are to be printed.
+   int     cache_entries;  // Size of each searcher's cache.  0 for none.
+   const solve_settings *settings;  // How to solve the puzzles.
+};
+
+// A cache of what came of solving puzzles, kept by each searcher when
+// looking for puzzles.  Many of the puzzles tried are the same but for
+// the letters used, like I + BB = ILL and A + CC = AMM, and these have
+// the same number of solutions, found with the same backtracks.  A
+// puzzle is looked up by its canonical form: the number of letters in
+// each column, the letters renumbered in the order the search comes to
+// them, and which of those start a word.  Puzzles with the same form
+// are searched exactly the same way.  The cache is a hash table of
+// sets of CACHE_WAYS entries.  When a set is full, the entry in it that
+// was used longest ago is replaced.
+
+const int CACHE_WAYS = 4;
+const int DEFAULT_CACHE_ENTRIES = 1 << 16;
+
+struct cache_entry {
+   unsigned int    hash;
+   unsigned short  key_length;   // 0 if the entry is empty.
+   int             solutions;
+   ulong           backtracks;
+   ulong           last_used;
+};
+
+struct cache_stats {
+   ulong   lookups;
+   ulong   hits;
+   ulong   evictions;
+   ulong   entries;     // Room for this many puzzles.
+   ulong   bytes;       // Memory used by the entries and their keys.
+};
+
+struct find_cache {
+   int              set_count;   // 0 if there is no cache.
+   int              key_size;    // Room for each key.
+   cache_entry     *entries;
+   unsigned char   *keys;        // key_size bytes for each entry.
+   unsigned char   *key;         // The key being looked up.
+   ulong            clock;       // Counts lookups to date the entries.
+   cache_stats      stats;
+};
+
+
+void init_find_cache(
+      find_cache  *cache,
+      int          entries,         // Room for at least this many.  0 for none.
+      int          summand_count    // The number of summands in each puzzle.
+   )
+   // Set up an empty cache.  The number of entries is rounded up to a
+   // power of two.
+   {
+      int  set_count;
+
+
+      memset(&cache->stats, 0, sizeof(cache->stats));
+      cache->set_count = 0;
+      cache->clock = 0;
+      if(entries <= 0) {
+         return;
+      }
+      set_count = 1;
+      while(set_count * CACHE_WAYS < entries) {
+         set_count *= 2;
+      }
+
+      // A key is the length of the sum and the leading letters, then
+      // the length of each column and its letters.
+
+      cache->key_size = 3 + MAX_LEN * (summand_count + 2) + MAX_BASE / 8;
+      cache->set_count = set_count;
+      cache->entries = new cache_entry[set_count * CACHE_WAYS];
+      cache->keys = new unsigned char[set_count * CACHE_WAYS * cache->key_size];
+      cache->key = new unsigned char[cache->key_size];
+      memset(cache->entries, 0, set_count * CACHE_WAYS * sizeof(cache_entry));
+      cache->stats.entries = set_count * CACHE_WAYS;
+      cache->stats.bytes = set_count * CACHE_WAYS *
+                           (sizeof(cache_entry) + cache->key_size);
+   }
+
+
+void free_find_cache(
+      find_cache  *cache
+   )
+   // Free the memory used by a cache.
+   {
+      if(cache->set_count) {
+         delete [] cache->entries;
+         delete [] cache->keys;
+         delete [] cache->key;
+      }
+   }
+
+
+int canonical_key(
+      puzzle_layout  *layout,
+      unsigned char  *key
+   )
+   // Write the canonical form of a puzzle to key and return its length.
+   // Which of the first 16 letters start a word is put after the sum's
+   // length, and for any more letters at the end.
+   {
+      int             canonical[MAX_BASE];
+      int             column;
+      int             i;
+      unsigned char  *key_p = key;
+      digit_mask      leading = 0;
+      int             letter;
+      int             letter_count = 0;
+      char           *reform_smnds = layout->smnds;
+      int             row;
+
+
+      for(i = 0; i < layout->letter_count; i++) {
+         canonical[i] = -1;
+      }
+      *key_p++ = layout->sum_length;
+      key_p += 2;
+      for(column = 0; column < layout->sum_length; column++) {
+         *key_p++ = layout->column_lengths[column];
+         for(row = layout->column_lengths[column]; row >= 0; row--) {
+            if(row == layout->column_lengths[column]) {
+               letter = layout->sum_ids[column];
+            } else {
+               letter = summand_char(row, column);
+            }
+            if(canonical[letter] < 0) {
+               canonical[letter] = letter_count;
+               if(layout->leading[letter]) {
+                  leading |= digit_bit(letter_count);
+               }
+               letter_count++;
+            }
+            *key_p++ = canonical[letter];
+         }
+      }
+      key[1] = leading & 0xff;
+      key[2] = (leading >> 8) & 0xff;
+      for(i = 16; i < letter_count; i += 8) {
+         *key_p++ = (leading >> i) & 0xff;
+      }
+      return(key_p - key);
+   }
+
+
+// One in this many of the searches -find stops at the second solution
+// is searched again in full, starting with the first, to estimate the
+// backtracks stopping saved.  The full searches can take far longer
+// than the stopped ones, so few are done, and the estimate isn't given
+// from fewer than MIN_STOP_SAMPLES of them.
+
+const ulong STOP_SAMPLE_RATE = 256;
+const ulong MIN_STOP_SAMPLES = 10;
+
+
+void sample_stopped_search(
+      puzzle_layout   *layout,     // The puzzle laid out in columns.
+      const solve_settings *settings, // How to search.  NULL for defaults.
+      solve_arena     *arena,      // Scratch memory.
+      const search_counters *stopped, // The counters of the stopped search.
+      search_counters *totals      // Add the saved backtracks to these.
+   )
+   // If a search was stopped early and it is one of those picked,
+   // search the puzzle again in full and add the difference in
+   // backtracks to the totals.  totals must already include the
+   // stopped search.
+   {
+      search_counters counters;
+      int             difficulty;
+
+
+      if(!stopped->stopped_early ||
+            (totals->stopped_early - 1) % STOP_SAMPLE_RATE != 0) {
+         return;
+      }
+      solve_layout(layout, 0, 0, settings, NULL, arena, &counters,
+                   &difficulty);
+      totals->sampled_stops++;
+      if(counters.backtracks > stopped->backtracks) {
+         totals->sampled_saved += counters.backtracks - stopped->backtracks;
+      }
+   }
+
+
+int solve_cached(
+      find_cache      *cache,
+      puzzle_layout   *layout,     // The puzzle laid out in columns.
+      const solve_settings *settings, // How to search.  NULL for defaults.
+      int              stop_after, // Stop after this many solutions.  0 for all.
+      solve_arena     *arena,      // Scratch memory.
+      search_counters *totals,     // Add the search's counters to these.
+      int             *difficulty  // The difficulty on a scale of 1 to 10.
+   )
+   // Find the number of solutions to a puzzle, looking in the cache
+   // first.  If it isn't there, it is solved and put there.  Only the
+   // puzzles that are searched add to the totals.  stop_after must be
+   // the same for every puzzle that uses the cache.
+   {
+      search_counters counters;
+      cache_entry    *entry;
+      unsigned int    hash = 2166136261u;
+      int             i;
+      int             key_length;
+      cache_entry    *oldest;
+      cache_entry    *set;
+      int             solutions;
+
+
+      if(!cache->set_count) {
+         solutions = solve_layout(layout, 0, stop_after, settings, NULL, arena,
+                                  &counters, difficulty);
+         add_search_counters(totals, &counters);
+         sample_stopped_search(layout, settings, arena, &counters, totals);
+         return(solutions);
+      }
+
+      // Look for the puzzle in its set.  The hash is FNV-1a.
+
+      key_length = canonical_key(layout, cache->key);
+      for(i = 0; i < key_length; i++) {
+         hash = (hash ^ cache->key[i]) * 16777619u;
+      }
+      cache->clock++;
+      cache->stats.lookups++;
+      set = &cache->entries[(hash & (cache->set_count - 1)) * CACHE_WAYS];
+      oldest = set;
+      for(entry = set; entry < set + CACHE_WAYS; entry++) {
+         if(entry->key_length == key_length && entry->hash == hash &&
+               memcmp(&cache->keys[(entry - cache->entries) * cache->key_size],
+                      cache->key, key_length) == 0) {
+            cache->stats.hits++;
+            entry->last_used = cache->clock;
+            *difficulty = difficulty_conv(entry->backtracks);
+            return(entry->solutions);
+         }
+         if(entry->last_used < oldest->last_used) {
+            oldest = entry;
+         }
+      }
+
+      // It wasn't there, so solve it and replace the oldest entry in
+      // the set.  Empty entries were never used, so they are oldest.
+
+      solutions = solve_layout(layout, 0, stop_after, settings, NULL, arena,
+                               &counters, difficulty);
+      add_search_counters(totals, &counters);
+      sample_stopped_search(layout, settings, arena, &counters, totals);
+      if(oldest->key_length) {
+         cache->stats.evictions++;
+      }
+      oldest->hash = hash;
+      oldest->key_length = key_length;
+      oldest->solutions = solutions;
+      oldest->backtracks = counters.backtracks;
+      oldest->last_used = cache->clock;
+      memcpy(&cache->keys[(oldest - cache->entries) * cache->key_size],
+             cache->key, key_length);
+      return(solutions);
+   }
+
+
+// The working arrays and counters for one searcher.  Each thread
+// has its own so that nothing needs to be locked while searching.
+
+struct find_scratch {
+   int           *smnd_word_index;
+   int           *smnd_word_lengths;
+   char         **smnd_word_ptrs;
+   digit_mask    *smnd_letter_map;
+   int           *given_order;     // The summands in the order given.
+   char         **given_ptrs;
+   int           *given_lengths;
+   char          *line;            // Buffer used to print a puzzle.
+   puzzle_layout  layout;          // The sum and the summands so far.
+   puzzle_layout  given_layout;    // A puzzle found, in the order given.
+   find_cache     cache;           // Puzzles already solved.
+   solve_arena    arena;           // Scratch memory for solving.
+   search_counters counters;       // Added up over the puzzles searched.
+   unsigned int   good_puzzles;
+   unsigned int   puzzles_tried;
+};
+
+
+void init_find_scratch(
+      find_scratch  *scratch,
+      int            summand_count,
+      int            cache_entries    // Size of the cache.  0 for none.
+   )
+   // Allocate the arrays for a searcher and zero its counters.
+   {
+      scratch->smnd_word_index = new int[summand_count];
+      scratch->smnd_word_ptrs = new char*[summand_count];
+      scratch->smnd_word_lengths = new int[summand_count];
+      scratch->smnd_letter_map = new digit_mask[summand_count];
+      scratch->given_order = new int[summand_count];
+      scratch->given_ptrs = new char*[summand_count];
+      scratch->given_lengths = new int[summand_count];
+      scratch->line = new char[(summand_count + 1) * (WORD_TEXT_SIZE + 3) + 64];
+      scratch->layout.smnds = new char[MAX_LEN * summand_count];
+      scratch->given_layout.smnds = new char[MAX_LEN * summand_count];
+      scratch->layout.letter_count = 0;
+      memset(scratch->layout.letter_ids, -1,
+             sizeof(scratch->layout.letter_ids));
+      init_find_cache(&scratch->cache, cache_entries, summand_count);
+      init_arena(&scratch->arena);
+      clear_search_counters(&scratch->counters);
+      scratch->good_puzzles = 0;
+      scratch->puzzles_tried = 0;
+   }
+
+
+void free_find_scratch(
+      find_scratch  *scratch
+   )
+   // Free the arrays allocated by init_find_scratch.
+   {
+      delete [] scratch->smnd_word_index;
+      delete [] scratch->smnd_word_ptrs;
+      delete [] scratch->smnd_word_lengths;
+      delete [] scratch->smnd_letter_map;
+      delete [] scratch->given_order;
+      delete [] scratch->given_ptrs;
+      delete [] scratch->given_lengths;
+      delete [] scratch->line;
+      delete [] scratch->layout.smnds;
+      delete [] scratch->given_layout.smnds;
+      free_find_cache(&scratch->cache);
+      free_arena(&scratch->arena);
+   }
+
+
+inline int summand_index_limit(
+      find_info  *info,
+      int         sum_index,       // The word used as the sum.
+      int         later_summands   // The number of summands after this one.
+   )
+   // Return one past the last place in the index a summand can come
+   // from.  A summand can't be longer than the sum.  If words can't be
+   // repeated, the later summands have to come after it.
+   {
+      int  limit = info->index->length_end[info->word_lengths[sum_index]];
+
+
+      if(info->disallow_rep) {
+         limit -= later_summands;
+      }
+      return(limit);
+   }
+
+
+int find_summand_word(
+      find_info  *info,
+      int         sum_index,      // The word used as the sum.
+      int         try_ind,        // The first place in the index to consider.
+      int         index_limit,    // From summand_index_limit.
+      digit_mask  prev_letters,   // Letters used by the sum and summands.
+      digit_mask *new_letters     // Letters used if this word is added.
+   )
+   // Starting at try_ind, find the first word in the index that can be
+   // added to the summands.  The word can't be the sum and can't push
+   // the number of letters used past the base.  index_limit keeps out
+   // the words longer than the sum.  Returns the place of the word
+   // found, or index_limit or more if there isn't one.
+   {
+      const word_index  *index = info->index;
+      digit_mask         letter_map;
+      int                total_letters;
+
+
+      while(try_ind < index_limit) {
+
+         // See how many total letters there will be after we
+         // add this word.  If there are more than base, there
+         // can't be a solution with it or any of the others with
+         // the same letters.
+
+         letter_map = prev_letters | index->letters[try_ind];
+         total_letters = count_bits(letter_map);
+         if(total_letters > info->base) {
+            try_ind = index->bucket_end[try_ind];
+            continue;
+         }
+
+         // The sum can't be included in the summands.
+
+         if(try_ind == index->position[sum_index]) {
+            try_ind++;
+            continue;
+         }
+
+         // This one looks okay.
+
+         *new_letters = letter_map;
+         break;
+      }
+      return(try_ind);
+   }
+
+
+void look_for_puzzles_with_sum(
+      find_info     *info,
+      find_scratch  *scratch,
+      int            sum_index,    // The word to use as the sum.
+      int            first_index   // The first summand, or -1 for all.
+   )
+   // Look for puzzles that have the word at sum_index as the sum.  If
+   // first_index isn't -1, only the puzzles that have the word at that
+   // place in the index as the first summand are tried.  This lets
+   // the search be split up among several threads.  The puzzles found
+   // are printed and the counts of good puzzles and those tried are
+   // added to the scratch counters.  The puzzle is kept laid out in
+   // the scratch layout as the summands change, so each one tried
+   // only costs laying out its last word.
+   {
+      int           backtrack;
+      int           difficulty;
+      int           first_smnd;
+      int          *given_lengths = scratch->given_lengths;
+      int          *given_order = scratch->given_order;
+      char        **given_ptrs = scratch->given_ptrs;
+      int           i, j;
+      int           index_limit;
+      puzzle_layout *layout = &scratch->layout;
+      char         *line_p;
+      digit_mask    new_letter_map;
+      int           smnd_index;
+      int          *smnd_word_index = scratch->smnd_word_index;
+      int          *smnd_word_lengths = scratch->smnd_word_lengths;
+      char        **smnd_word_ptrs = scratch->smnd_word_ptrs;
+      digit_mask   *smnd_letter_map = scratch->smnd_letter_map;
+      puzzle_layout *solve_layout_p;
+      int           solutions;
+      char         *sum = info->words[sum_index];
+      int           summand_count = info->summand_count;
+      int           try_ind;
+
+
+      DBG_FIND(
+         printf("Sum is %s\n", sum);
+      );
+
+      // If we were given the first summand, fill it in and start
+      // the search with the second one.  We stop when we backtrack
+      // to the first.
+
+      start_layout(layout, sum, info->base);
+      if(first_index >= 0) {
+         smnd_word_index[0] = first_index;
+         smnd_word_ptrs[0] = info->index->words[first_index];
+         smnd_word_lengths[0] = info->index->lengths[first_index];
+         smnd_letter_map[0] = info->letters_used[sum_index]
+                            | info->index->letters[first_index];
+         push_summand(layout, smnd_word_ptrs[0], smnd_word_lengths[0]);
+         first_smnd = 1;
+      } else {
+         first_smnd = 0;
+      }
+
+      // Find summand_count words other than sum such that
+      // no more than base characters are used and all of
+      // the summand words are not longer than the sum's length.
+
+      smnd_index = first_smnd;
+      backtrack  = 0;
+      while(smnd_index >= first_smnd) {
+
+         // See if we have a possible set of summands.
+
+         if(smnd_index == summand_count) {
+
+            // We have a set of words to try.  They were picked in
+            // index order, but the puzzle is solved and printed with
+            // them in the order the words were given, as -find did
+            // before there was an index.  The order of the rows changes
+            // the backtracks, and so the difficulty.  When the orders
+            // differ, the puzzle is laid out again in the given order.
+
+            for(i = 0; i < summand_count; i++) {
+               for(j = i; j > 0 && info->index->given[given_order[j - 1]] >
+                                   info->index->given[smnd_word_index[i]]; j--) {
+                  given_order[j] = given_order[j - 1];
+               }
+               given_order[j] = smnd_word_index[i];
+            }
+            solve_layout_p = layout;
+            for(i = 0; i < summand_count; i++) {
+               given_ptrs[i] = info->index->words[given_order[i]];
+               given_lengths[i] = info->index->lengths[given_order[i]];
+               if(given_order[i] != smnd_word_index[i]) {
+                  solve_layout_p = &scratch->given_layout;
+               }
+            }
+            if(solve_layout_p != layout) {
+               lay_out_puzzle(solve_layout_p, given_ptrs, summand_count,
+                              given_lengths, sum, info->base);
+            }
+
+            // If only puzzles with one solution are wanted, there's no
+            // need to find more than two.
+
+            solutions = solve_cached(&scratch->cache, solve_layout_p,
+                                     info->settings, info->exactly_one ? 2 : 0,
+                                     &scratch->arena, &scratch->counters,
+                                     &difficulty);
+            scratch->puzzles_tried++;
+
+            DBG_FIND(
+               printf("  Trying ");
+               for(i = 0; i < summand_count; i++) {
+                  if(i != 0) {
+                     printf(" + ");
+                  }
+                  printf("%s", smnd_word_ptrs[i]);
+               }
+               printf("\n");
+            );
+
+            // If one solution was returned, then we want to print
+            // this one.  Note that this is the correct thing to do
+            // whether we were looking for puzzles with exaclty one
+            // solution or not.  The line is built up and printed all
+            // at once so that lines from different threads don't
+            // get mixed together.  The benchmark only counts them.
+
+            if(solutions == 1 || (solutions > 0 && !info->exactly_one)) {
+               scratch->good_puzzles++;
+               if(info->print) {
+                  line_p = scratch->line;
+                  if(!info->exactly_one) {
+                     line_p += sprintf(line_p, "(%d) ", solutions);
+                  }
+                  for(i = 0; i < summand_count; i++) {
+                     if(i != 0) {
+                        line_p += sprintf(line_p, " + ");
+                     }
+                     line_p += write_word(given_ptrs[i], line_p, &run_letters);
+                  }
+                  line_p += sprintf(line_p, " = ");
+                  line_p += write_word(sum, line_p, &run_letters);
+
+                  if(DIFF_PRINT) {
+                     line_p += sprintf(line_p, "  difficulty: %d", difficulty);
+                  }
+                  sprintf(line_p, "\n");
+                  fputs(scratch->line, stdout);
+               }
+            }
+
+            // Backtrack from here to try another.
+
+            backtrack = 1;
+            smnd_index--;
+            continue;
+
+         } else {
+
+            if(backtrack) {
+
+               // We've backtracked to this position in the summand array.
+               // Take its word off of the layout and try to find a new
+               // index for this position after the one here currently.
+
+               pop_summand(layout, smnd_word_ptrs[smnd_index],
+                           smnd_word_lengths[smnd_index]);
+               try_ind = smnd_word_index[smnd_index] + 1;
+
+            } else {
+
+               // We've come to this position in the summand array
+               // going forward.  Starting at the start of the word
+               // array, find one for this spot in the summands array.
+
+               try_ind = (smnd_index == 0) ? 0
+                       : smnd_word_index[smnd_index - 1] + info->disallow_rep;
+            }
+
+            // Now look for a possible word starting at the index try_ind.
+            // We stop at the words that are longer than the sum, less
+            // the number of summands left where repetition isn't
+            // allowed.
+
+            index_limit = summand_index_limit(info, sum_index,
+                                              summand_count - smnd_index - 1);
+            try_ind = find_summand_word(info, sum_index, try_ind,
+                           index_limit,
+                           (smnd_index == 0) ? info->letters_used[sum_index]
+                                             : smnd_letter_map[smnd_index - 1],
+                           &new_letter_map);
+
+            // See if we found a summand word to try in this place.
+            // If not, backtrack.  If so, go to next summand spot.
+
+            if(try_ind >= index_limit) {
+
+               backtrack = 1;
+               smnd_index--;
+
+            } else {
+
+               // When we go forward, we have to keep track of the
+               // index into the words array this summand is, its
+               // lengths, a pointer to the word, and the bit map
+               // of letters used to this point.  The word is added to
+               // the layout.  find_summand_word has already checked
+               // that its letters fit in the base.
+
+               backtrack = 0;
+               smnd_word_index[smnd_index] = try_ind;
+               smnd_word_ptrs[smnd_index] = info->index->words[try_ind];
+               smnd_word_lengths[smnd_index] = info->index->lengths[try_ind];
+               smnd_letter_map[smnd_index] = new_letter_map;
+               push_summand(layout, smnd_word_ptrs[smnd_index],
+                            smnd_word_lengths[smnd_index]);
+
+               // Set index to next summand space.
+
+               smnd_index++;
+            }
+         }
+      }
+   }
+
+
+// When looking for puzzles with more than one thread, the work is
+// split up into tasks.  A task is either a sum word, or a sum word
+// together with the word to use as its first summand.  The amount of
+// work in a task varies enormously (long sums have many more possible
+// summands than short ones), so the tasks aren't divided up ahead of
+// time.  Each thread has its own queue of tasks.  A thread takes tasks
+// off the back of its own queue, and when that is empty, steals from
+// the front of another thread's queue.  When a thread takes a sum
+// task, it breaks it up into one task for each possible first summand
+// and puts these on its own queue where idle threads can steal them.
+// Since the sum tasks are at the front of the queues, a thief takes
+// the biggest pieces of work first.
+
+struct find_task {
+   int  sum_index;      // The word used as the sum.
+   int  first_index;    // The first summand's place in the index, or
+                        // -1 for a whole sum.
+};
+
+struct find_queue {
+   std::mutex   lock;
+   find_task   *tasks;
+   int          head;   // Index of the oldest task.  Thieves take it.
+   int          tail;   // One past the newest task.  The owner takes it.
+};
+
+struct find_work {
+   find_info         *info;
+   find_queue        *queues;
+   int                thread_count;
+   std::atomic<int>   pending;   // Tasks queued or still being worked on.
+   std::mutex         idle_lock; // Guards wakeups.
+   std::condition_variable changed;  // Signalled when wakeups changes.
+   unsigned long      wakeups;   // Bumped when tasks are queued or
+                                 // pending reaches zero.
+};
+
+
+void wake_find_workers(
+      find_work  *work
+   )
+   // Wake the threads waiting for tasks, because some were queued or
+   // because there is nothing left to wait for.
+   {
+      std::lock_guard<std::mutex> guard(work->idle_lock);
+
+      work->wakeups++;
+      work->changed.notify_all();
+   }
+
+
+int take_find_task(
+      find_work  *work,
+      int         worker,    // The thread looking for a task.
+      find_task  *task       // Return the task here.
+   )
+   // Get the next task for a worker thread.  Returns 1 if a task was
+   // found and 0 if all of the queues were empty.
+   {
+      int          i;
+      find_queue  *queue;
+
+
+      // First look in our own queue.
+
+      queue = &work->queues[worker];
+      {
+         std::lock_guard<std::mutex> guard(queue->lock);
+
+         if(queue->head < queue->tail) {
+            *task = queue->tasks[--queue->tail];
+            if(queue->head == queue->tail) {
+               queue->head = queue->tail = 0;
+            }
+            return(1);
+         }
+      }
+
+      // Ours is empty, so try to steal from the others.
+
+      for(i = 1; i < work->thread_count; i++) {
+         queue = &work->queues[(worker + i) % work->thread_count];
+         std::lock_guard<std::mutex> guard(queue->lock);
+
+         if(queue->head < queue->tail) {
+            *task = queue->tasks[queue->head++];
+            if(queue->head == queue->tail) {
+               queue->head = queue->tail = 0;
+            }
+            return(1);
+         }
+      }
+      return(0);
+   }
+
+
+void find_worker(
+      find_work     *work,
+      int            worker,    // The index of this thread.
+      find_scratch  *scratch    // This thread's arrays and counters.
+   )
+   // The function run by each thread when looking for puzzles.  It
+   // keeps taking tasks until there are none queued or being worked on.
+   {
+      int          first_index;
+      find_info   *info = work->info;
+      int          index_limit;
+      digit_mask   new_letter_map;
+      find_queue  *queue = &work->queues[worker];
+      int          queued;
+      find_task    task;
+      unsigned long wakeups;
+
+
+      while(1) {
+
+         if(!take_find_task(work, worker, &task)) {
+
+            // Nothing to do right now.  If another thread is still
+            // working on a task, it may queue more, so sleep until it
+            // does.  The wakeup count is read before looking at the
+            // queues again so that a task queued in between can't be
+            // missed.
+
+            {
+               std::lock_guard<std::mutex> guard(work->idle_lock);
+               wakeups = work->wakeups;
+            }
+            if(work->pending.load() == 0) {
+               break;
+            }
+            if(!take_find_task(work, worker, &task)) {
+               std::unique_lock<std::mutex> idle(work->idle_lock);
+               while(work->wakeups == wakeups &&
+                     work->pending.load() != 0) {
+                  work->changed.wait(idle);
+               }
+               continue;
+            }
+         }
+
+         if(task.first_index >= 0) {
+
+            look_for_puzzles_with_sum(info, scratch, task.sum_index,
+                                      task.first_index);
+
+         } else {
+
+            // Split the sum up into one task for each word that
+            // could be its first summand.  The pending count must be
+            // raised before the task we're finishing is removed from
+            // it so that no thread sees it reach zero early.
+
+            index_limit = summand_index_limit(info, task.sum_index,
+                                              info->summand_count - 1);
+            first_index = 0;
+            queued = 0;
+            while(1) {
+               first_index = find_summand_word(info, task.sum_index,
+                                  first_index, index_limit,
+                                  info->letters_used[task.sum_index],
+                                  &new_letter_map);
+               if(first_index >= index_limit) {
+                  break;
+               }
+               work->pending++;
+               {
+                  std::lock_guard<std::mutex> guard(queue->lock);
+                  queue->tasks[queue->tail].sum_index = task.sum_index;
+                  queue->tasks[queue->tail].first_index = first_index;
+                  queue->tail++;
+               }
+               queued = 1;
+               first_index++;
+            }
+            if(queued) {
+               wake_find_workers(work);
+            }
+         }
+         if(--work->pending == 0) {
+            wake_find_workers(work);
+         }
+      }
+   }
+
+
+unsigned int look_for_puzzles_specific_count(
+      char         **words,
+      int            word_count,
+      int            base,
+      int           *word_lengths,
+      digit_mask    *letters_used,
+      const word_index *index,
+      int            summand_count,
+      int            exactly_one,
+      int            disallow_rep,
+      int            first_sum_only,
+      int            print,
+      const solve_settings *settings,
+      int            thread_count,
+      int            cache_entries,
+      cache_stats   *stats,
+      search_counters *counters,
+      unsigned int  *search_count
+   )
+   // This function will look for puzzles with solutions (one or many)
+   // given the list of words and the various information about them
+   // in the other parameters.  This function returns the number of
+   // good puzzles found.  It also returns the number searched in the
+   // parameter search_count.  If thread_count is more than one, the
+   // search is shared among that many threads.  The puzzles are then
+   // printed in the order they are found rather than in word order.
+   // Each thread keeps a cache of cache_entries puzzles it has solved,
+   // and how well these did is added to stats.  The counters of the
+   // puzzles searched are added to counters.
+   {
+      unsigned int   good_puzzles = 0;
+      int            i;
+      find_info      info;
+      unsigned int   puzzles_tried = 0;
+      int            queue_size;
+      find_scratch  *scratch;
+      int            sum_index;
+      int            sum_index_limit;
+      std::thread   *threads;
+      find_work      work;
+
+
+      info.words = words;
+      info.word_count = word_count;
+      info.base = base;
+      info.word_lengths = word_lengths;
+      info.letters_used = letters_used;
+      info.index = index;
+      info.summand_count = summand_count;
+      info.exactly_one = exactly_one;
+      info.disallow_rep = disallow_rep;
+      info.print = print;
+      info.cache_entries = cache_entries;
+      info.settings = settings;
+
+      sum_index_limit = (first_sum_only) ? 1 : word_count;
+
+      if(thread_count <= 1) {
+
+         // Try each word as the sum.
+
+         scratch = new find_scratch[1];
+         init_find_scratch(&scratch[0], summand_count, info.cache_entries);
+         for(sum_index = 0; sum_index < sum_index_limit; sum_index++) {
+            look_for_puzzles_with_sum(&info, &scratch[0], sum_index, -1);
+         }
+         thread_count = 1;
+
+      } else {
+
+         // Deal the sums out to the threads' queues.  A queue never
+         // holds more than its share of the sums plus the tasks from
+         // splitting up one sum.
+
+         work.info = &info;
+         work.thread_count = thread_count;
+         work.queues = new find_queue[thread_count];
+         work.pending = sum_index_limit;
+         work.wakeups = 0;
+         queue_size = sum_index_limit / thread_count + 1 + word_count;
+         for(i = 0; i < thread_count; i++) {
+            work.queues[i].tasks = new find_task[queue_size];
+            work.queues[i].head = 0;
+            work.queues[i].tail = 0;
+         }
+         for(sum_index = 0; sum_index < sum_index_limit; sum_index++) {
+            find_queue *queue = &work.queues[sum_index % thread_count];
+            queue->tasks[queue->tail].sum_index = sum_index;
+            queue->tasks[queue->tail].first_index = -1;
+            queue->tail++;
+         }
+
+         // Start the threads and wait for them to finish.
+
+         scratch = new find_scratch[thread_count];
+         threads = new std::thread[thread_count];
+         for(i = 0; i < thread_count; i++) {
+            init_find_scratch(&scratch[i], summand_count,
+                              info.cache_entries);
+            threads[i] = std::thread(find_worker, &work, i, &scratch[i]);
+         }
+         for(i = 0; i < thread_count; i++) {
+            threads[i].join();
+         }
+         delete [] threads;
+         for(i = 0; i < thread_count; i++) {
+            delete [] work.queues[i].tasks;
+         }
+         delete [] work.queues;
+      }
+
+      // Add up the counts from each thread and free their arrays.
+
+      for(i = 0; i < thread_count; i++) {
+         good_puzzles += scratch[i].good_puzzles;
+         puzzles_tried += scratch[i].puzzles_tried;
+         stats->lookups += scratch[i].cache.stats.lookups;
+         stats->hits += scratch[i].cache.stats.hits;
+         stats->evictions += scratch[i].cache.stats.evictions;
+         add_search_counters(counters, &scratch[i].counters);
+         if(scratch[i].cache.stats.entries > stats->entries) {
+            stats->entries = scratch[i].cache.stats.entries;
+         }
+         if(scratch[i].cache.stats.bytes > stats->bytes) {
+            stats->bytes = scratch[i].cache.stats.bytes;
+         }
+         free_find_scratch(&scratch[i]);
+      }
+      delete [] scratch;
+
+      // Return the number of good puzzles found and the number tried.
+
+      *search_count = puzzles_tried;
+      return(good_puzzles);
+   }
+
+
+unsigned int look_for_puzzles(
+      char         **words,
+      int            word_count,
+      int           *word_lengths,
+      int            base,
+      int            low_summand_count,
+      int            high_summand_count,
+      int            exactly_one,
+      int            disallow_rep,
+      int            first_sum_only,
+      int            print,
+      const solve_settings *settings,
+      int            thread_count,
+      int            cache_entries,
+      cache_stats   *stats,
+      search_counters *counters,
+      unsigned int  *total_searched
+   )
+   // This function will look for puzzles with solutions using the words
+   // given.  It will search for them among all possible combinations
+   // from low_summand_count to high_summand_count summands.  If
+   // exactly_one is set, then it will only generate puzzles that have
+   // exactly one solution.  Otherwise it will generate puzzles that
+   // have at least one solution.  The search uses thread_count threads.
+   // Each keeps a cache of cache_entries puzzles, and how well the
+   // caches did is returned in stats.  The counters of all of the
+   // puzzles that were searched are added up in counters.
+   {
+      int           i;
+      word_index    index;
+      int           j;
+      digit_mask   *letters_used;
+      unsigned int  number_found = 0;
+      unsigned int  search_count;
+      int           summand_count;
+
+
+      // Initialize the search count, the cache counts and the counters.
+
+      *total_searched = 0;
+      memset(stats, 0, sizeof(*stats));
+      clear_search_counters(counters);
+
+      // Determine the letters used by each word.  The letters in a
+      // puzzle are counted from these with count_bits.
+
+      letters_used = new digit_mask[word_count];
+      for(i = 0; i < word_count; i++) {
+         letters_used[i] = 0;
+         for(j = 0; j < word_lengths[i]; j++) {
+            letters_used[i] |= digit_bit(words[i][j] - 'A');
+         }
+      }
+      build_word_index(words, word_count, word_lengths, letters_used, &index);
+
+      // Now go through the different summand counts.
+
+      for(summand_count = low_summand_count;
+          summand_count <= high_summand_count;
+          summand_count++) {
+
+         // Now call the function that looks for puzzles with a
+         // specific number of summands.
+
+         number_found += look_for_puzzles_specific_count(words,
+                            word_count, base, word_lengths,
+                            letters_used, &index, summand_count,
+                            exactly_one, disallow_rep, first_sum_only,
+                            print, settings, thread_count, cache_entries, stats,
+                            counters, &search_count);
+         *total_searched += search_count;
+      }
+
+      // Get rid of the arrays we allocated.
+
+      delete [] letters_used;
+      free_word_index(&index);
+
+      return(number_found);
+   }
+
+
+void print_counters(
+      const search_counters  *counters,
+      int                     column_count   // Columns to print the nodes of.
+   )
+   // Print the counters as the members of a JSON object, without the
+   // braces, so that the caller can add its own members.
+   {
+      int  i;
+
+
+      printf("\"backtracks\": %lu, \"backtrack_reasons\": "
+             "{\"carry_infeasible\": %lu, \"empty_range\": %lu, "
+             "\"previously_mapped\": %lu, \"value_too_large\": %lu}, "
+             "\"max_depth\": %d, \"stopped_early\": %lu, \"column_nodes\": [",
+             counters->backtracks, counters->carry_infeasible,
+             counters->empty_range, counters->previously_mapped,
+             counters->value_too_large, counters->max_depth,
+             counters->stopped_early);
+      for(i = 0; i < column_count; i++) {
+         printf((i == 0) ? "%lu" : ", %lu", counters->column_nodes[i]);
+      }
+      printf("]");
+   }
+
+
+void print_solve_stats(
+      char                  **summands,       // An array of pointers to the summands.
+      int                     summand_count,  // The number of summands.
+      char                   *sum,            // The word representing the sum.
+      int                     base,           // The base it was solved in.
+      int                     solutions,      // The number of solutions found.
+      const search_counters  *counters        // What the search did.
+   )
+   // Print a line of JSON with the puzzle and its search's counters.
+   {
+      int   i;
+      char  text[WORD_TEXT_SIZE];
+
+
+      printf("{\"puzzle\": \"");
+      for(i = 0; i < summand_count; i++) {
+         write_word(summands[i], text, &run_letters);
+         printf((i == 0) ? "%s" : " + %s", text);
+      }
+      write_word(sum, text, &run_letters);
+      printf(" = %s\", \"base\": %d, \"solutions\": %d, ", text, base,
+             solutions);
+      print_counters(counters, strlen(sum));
+      printf("}\n");
+   }
+
+
+void print_product_stats(
+      char                   *multiplicand,
+      char                   *multiplier,
+      char                   *product,
+      int                     base,           // The base it was solved in.
+      int                     solutions,      // The number of solutions found.
+      const search_counters  *counters        // What the search did.
+   )
+   // Print a line of JSON with a multiplication and its search's
+   // counters.
+   {
+      char  text[3][WORD_TEXT_SIZE];
+
+
+      write_word(multiplicand, text[0], &run_letters);
+      write_word(multiplier, text[1], &run_letters);
+      write_word(product, text[2], &run_letters);
+      printf("{\"puzzle\": \"%s * %s = %s\", \"base\": %d, \"solutions\": %d, ",
+             text[0], text[1], text[2], base, solutions);
+      print_counters(counters, strlen(product));
+      printf("}\n");
+   }
+
+
+void print_solution_count(
+      int  result       // SOLUTIONS_NONE, SOLUTIONS_UNIQUE or SOLUTIONS_AMBIGUOUS.
+   )
+   // Print what a search stopped at the second solution showed.
+   {
+      if(result == SOLUTIONS_NONE) {
+         printf("The puzzle has no solutions.\n");
+      } else if(result == SOLUTIONS_UNIQUE) {
+         printf("The puzzle has one solution.\n");
+      } else {
+         printf("The puzzle has more than one solution.  The search stopped at the second.\n");
+      }
+   }
+
+
+void print_unique(
+      const solve_witnesses  *witnesses,   // The solutions found.
+      int                     result       // What solve_unique returned.
+   )
+   // Print the solutions solve_unique found and what they show.
+   {
+      int  i;
+
+
+      for(i = 0; i < witnesses->count; i++) {
+         print_solution(witnesses->letter_count, witnesses->letters,
+                        witnesses->values[i], NULL);
+      }
+      print_solution_count(result);
+   }
+
+
+// Solving a stream of puzzles for -batch, so that a program making
+// many puzzles can keep one csolver running instead of starting one
+// for each puzzle and reading what it prints.  Each line of the input
+// is a puzzle as a JSON object:
+//
+//     {"id": 7, "summands": ["SEND", "MORE"], "sum": "MONEY", "base": 10,
+//      "stop_after": 2, "max_listed": 5}
+//
+// Only summands and sum are needed.  A multiplication is given with
+// "factors" and "product", and "partials" if the partial products are
+// part of it, and a square root with "radicand" and "root", in place
+// of them.  See solve_product for both.  A system of relations, like
+// the steps of a long division, is given with "relations", an array
+// of strings like "ABC - AFF = GH", and "single_zero": true if a word
+// of one letter in them can be zero.  See solve_system.  base is 10 by
+// default.
+// stop_after stops the search after that many solutions, and is 0, for
+// all of them, by default.  max_listed is how many of the solutions to
+// give, DEFAULT_BATCH_LISTED by default.  id can be any JSON value, and
+// is given back as it is.  Other members are skipped.  None of these
+// can be given twice, and nothing but space can follow the object.
+// Each line of the output is the result for one puzzle:
+//
+//     {"id": 7, "line": 1, "solutions": 1, "stopped_early": false,
+//      "difficulty": 1, "backtracks": 74,
+//      "listed": [{"D": 7, "E": 5, "M": 1, "N": 6, "O": 0, "R": 8, "S": 9, "Y": 2}]}
+//
+// line is the line of the input the puzzle was on, counting from 1.
+// A puzzle that can't be read gets {"id": 7, "line": 1, "error": "..."}
+// instead.  Blank lines are skipped.
+//
+// The input is read in chunks of whatever lines have come in, up to
+// BATCH_CHUNK_LINES, so that a program feeding puzzles one at a time
+// gets each answer back without waiting for more.  With more than one
+// thread, the chunks are queued for a pool of threads, each of which
+// reads the puzzles in a chunk, solves them and writes their results
+// into the chunk's own buffer.  The buffers are written out as the
+// chunks are finished, or with -ordered in the order they were read.
+// No more than BATCH_CHUNKS_PER_THREAD chunks per thread are held at
+// once, so a fast writer can't fill memory with puzzles and a slow
+// chunk can't hold up an ever growing number of finished ones.  Since
+// the output is the results, anything else, like -stats, goes to
+// stderr.
+
+const int BATCH_CHUNK_LINES = 64;
+const int BATCH_CHUNKS_PER_THREAD = 4;
+const int BATCH_READ_SIZE = 65536;
+const int DEFAULT_BATCH_LISTED = 100;
+
+struct batch_chunk {
+   char          *text;         // Its lines, each ending in a null.
+   int            line_count;
+   long           first_line;   // The line number of its first line.
+   long           sequence;     // Which chunk it is, counting from 0.
+   output_buffer  output;       // The results of its puzzles.
+   batch_chunk   *next;         // In the queue or the finished list.
+};
+
+struct batch_reader {
+   int     file;                // The file descriptor to read from.
+   char   *buffer;              // Read but not yet put in a chunk.
+   int     size;
+   int     start;               // Where the unused part begins.
+   int     end;                 // Where it ends.
+   int     at_end;              // 1 once the input has run out.
+   long    line_number;         // Of the next line to go in a chunk.
+   long    sequence;            // Of the next chunk.
+};
+
+struct batch_puzzle {
+   const char   *id;            // The id's JSON text.  NULL if it has none.
+   int           id_length;
+   char        **summands;      // Point into the line.
+   int           summand_count;
+   char         *sum;
+   char         *factors[2];    // Or a multiplication.
+   int           factor_count;
+   char         *product;
+   char         *partials[MAX_LEN];
+   int           partial_count;
+   char         *radicand;      // Or a square root.
+   char         *root;
+   char         *relations[MAX_RELATIONS];   // Or a system.
+   int           relation_count;
+   int           single_zero;   // 1 if a one letter word can be zero.
+   int           base;
+   int           stop_after;
+   int           max_listed;
+   const char   *bad_word;      // The word an error is about, if any.
+};
+
+// What each thread keeps from puzzle to puzzle, so that solving one
+// doesn't allocate anything once it has grown to fit.
+
+struct batch_scratch {
+   solve_arena     arena;
+   char          **summands;
+   int            *lengths;
+   int             size;        // Room in summands and lengths.
+   output_buffer   listing;     // The solutions listed for a puzzle.
+   alphabet        letters;     // The chars given to a puzzle's letters past Z.
+};
+
+// The visitor's context while a puzzle is solved.
+
+struct batch_listing {
+   output_buffer   *output;
+   int              listed;
+   int              max_listed;
+   const alphabet  *letters;
+};
+
+struct batch_totals {
+   std::atomic<long>   puzzles;
+   std::atomic<long>   errors;
+   std::atomic<ulong>  backtracks;
+};
+
+struct batch_work {
+   std::mutex               lock;
+   std::condition_variable  changed;
+   batch_chunk             *queue_head;      // Read and waiting to be solved.
+   batch_chunk             *queue_tail;
+   batch_chunk             *finished;        // Waiting for their turn to be written.
+   int                      in_flight;       // Read but not yet written.
+   int                      max_in_flight;
+   int                      done_reading;
+   long                     next_to_write;   // The sequence of the next chunk to write.
+   int                      ordered;
+   const solve_settings    *settings;
+   batch_totals            *totals;
+};
+
+
+char *skip_json_space(
+      char  *p
+   )
+   {
+      while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+         p++;
+      }
+      return(p);
+   }
+
+
+int parse_json_hex(
+      const char  *p      // At the four hex digits of a \u escape.
+   )
+   // Returns the code unit the digits stand for, or -1 if they aren't
+   // four hex digits.
+   {
+      int  code = 0;
+      int  i;
+
+
+      for(i = 0; i < 4; i++) {
+         if(!isxdigit(p[i])) {
+            return(-1);
+         }
+         code = code * 16 + (isdigit(p[i]) ? p[i] - '0'
+                                            : (p[i] | 0x20) - 'a' + 10);
+      }
+      return(code);
+   }
+
+
+char *parse_json_string(
+      char   *p,          // At the opening quote.
+      char  **value       // Return the start of the string here.
+   )
+   // Read a JSON string in place, turning its escapes into the chars
+   // they stand for, with \u escapes written as UTF-8, and put a null
+   // after it, so that value is the string.  A surrogate pair is one
+   // code point.  Returns a pointer past the string, or NULL if it
+   // isn't one or has an escape that isn't good or stands for a null.
+   // The string never gets longer, so it fits where it was.
+   {
+      int    code;
+      int    low;
+      char  *out;
+
+
+      if(*p != '"') {
+         return(NULL);
+      }
+      p++;
+      *value = p;
+      out = p;
+      while(*p != '"') {
+         if(*p == '\0') {
+            return(NULL);
+         }
+         if(*p != '\\') {
+            *out++ = *p++;
+            continue;
+         }
+         p++;
+         switch(*p) {
+            case '"':
+            case '\\':
+            case '/':
+               *out++ = *p;
+               break;
+            case 'b':
+               *out++ = '\b';
+               break;
+            case 'f':
+               *out++ = '\f';
+               break;
+            case 'n':
+               *out++ = '\n';
+               break;
+            case 'r':
+               *out++ = '\r';
+               break;
+            case 't':
+               *out++ = '\t';
+               break;
+            case 'u':
+               code = parse_json_hex(p + 1);
+               if(code <= 0 || (code >= 0xDC00 && code <= 0xDFFF)) {
+                  return(NULL);
+               }
+               p += 4;
+
+               // A high surrogate must have a low one after it.
+
+               if(code >= 0xD800 && code <= 0xDBFF) {
+                  if(p[1] != '\\' || p[2] != 'u') {
+                     return(NULL);
+                  }
+                  low = parse_json_hex(p + 3);
+                  if(low < 0xDC00 || low > 0xDFFF) {
+                     return(NULL);
+                  }
+                  code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                  p += 6;
+               }
+               out += encode_utf8(code, out);
+               break;
+            default:
+               return(NULL);
+         }
+         p++;
+      }
+      *out = '\0';
+      return(p + 1);
+   }
+
+
+char *parse_json_int(
+      char  *p,
+      int   *value
+   )
+   // Read a JSON number that is a whole number.  Returns a pointer past
+   // it, or NULL if it isn't one.
+   {
+      char  *end;
+      long   number;
+
+
+      number = strtol(p, &end, 10);
+      if(end == p || *end == '.' || *end == 'e' || *end == 'E' ||
+            number < -2147483647L || number > 2147483647L) {
+         return(NULL);
+      }
+      *value = (int) number;
+      return(end);
+   }
+
+
+char *skip_json_value(
+      char  *p
+   )
+   // Skip over a JSON value of any kind without changing it.  Returns a
+   // pointer past it, or NULL if it isn't one.
+   {
+      int  depth = 0;
+
+
+      do {
+         p = skip_json_space(p);
+         if(*p == '"') {
+            p++;
+            while(*p != '"') {
+               if(*p == '\0') {
+                  return(NULL);
+               }
+               if(*p == '\\' && p[1] != '\0') {
+                  p++;
+               }
+               p++;
+            }
+            p++;
+         } else if(*p == '{' || *p == '[') {
+            depth++;
+            p++;
+         } else if((*p == '}' || *p == ']') && depth > 0) {
+            depth--;
+            p++;
+         } else if((*p == ',' || *p == ':') && depth > 0) {
+            p++;
+         } else if(isalnum(*p) || *p == '-' || *p == '+' || *p == '.') {
+            while(isalnum(*p) || *p == '-' || *p == '+' || *p == '.') {
+               p++;
+            }
+         } else {
+            return(NULL);
+         }
+      } while(depth > 0);
+      return(p);
+   }
+
+
+char *parse_json_words(
+      char   *p,           // At the opening bracket.
+      char  **words,       // Return the words here.
+      int     max_words,   // The room in words.
+      int    *count        // Return the number of words here.
+   )
+   // Read a JSON array of strings that has no more than max_words of
+   // them.  Returns a pointer past it, or NULL if it isn't one.
+   {
+      if(*p != '[') {
+         return(NULL);
+      }
+      p = skip_json_space(p + 1);
+      *count = 0;
+      while(*p != ']') {
+         if(*count == max_words) {
+            return(NULL);
+         }
+         p = parse_json_string(p, &words[*count]);
+         if(p == NULL) {
+            return(NULL);
+         }
+         (*count)++;
+         p = skip_json_space(p);
+         if(*p == ',') {
+            p = skip_json_space(p + 1);
+         } else if(*p != ']') {
+            return(NULL);
+         }
+      }
+      return(p + 1);
+   }
+
+
+// The members of a puzzle that parse_batch_puzzle reads, and what it
+// says when one is given more than once.
+
+static const char *const batch_members[][2] = {
+   { "summands", "summands is given more than once." },
+   { "sum", "sum is given more than once." },
+   { "factors", "factors is given more than once." },
+   { "product", "product is given more than once." },
+   { "partials", "partials is given more than once." },
+   { "radicand", "radicand is given more than once." },
+   { "root", "root is given more than once." },
+   { "relations", "relations is given more than once." },
+   { "single_zero", "single_zero is given more than once." },
+   { "base", "base is given more than once." },
+   { "stop_after", "stop_after is given more than once." },
+   { "max_listed", "max_listed is given more than once." },
+   { "id", "id is given more than once." }
+};
+
+const int BATCH_MEMBER_COUNT = sizeof(batch_members) / sizeof(batch_members[0]);
+
+
+const char *parse_batch_puzzle(
+      char           *line,
+      batch_puzzle   *puzzle,
+      batch_scratch  *scratch
+   )
+   // Read a puzzle from a line of JSON.  The words are left where they
+   // are in the line, with a null after each.  Returns NULL, or a
+   // message saying what is wrong.  The object must be all there is on
+   // the line, and the members read can each be given only once.
+   {
+      const char   *bad_json = "The line isn't a JSON object.";
+      int           i;
+      char         *key;
+      int           member_seen[BATCH_MEMBER_COUNT];
+      char        **new_summands;
+      int          *new_lengths;
+      char         *p;
+      char         *start;
+
+
+      puzzle->id = NULL;
+      puzzle->id_length = 0;
+      puzzle->summands = scratch->summands;
+      puzzle->summand_count = 0;
+      puzzle->sum = NULL;
+      puzzle->factor_count = 0;
+      puzzle->product = NULL;
+      puzzle->partial_count = 0;
+      puzzle->radicand = NULL;
+      puzzle->root = NULL;
+      puzzle->relation_count = 0;
+      puzzle->single_zero = 0;
+      puzzle->base = 10;
+      puzzle->stop_after = 0;
+      puzzle->max_listed = DEFAULT_BATCH_LISTED;
+      puzzle->bad_word = NULL;
+
+      p = skip_json_space(line);
+      if(*p != '{') {
+         return(bad_json);
+      }
+      p = skip_json_space(p + 1);
+      memset(member_seen, 0, sizeof(member_seen));
+      while(*p != '}') {
+         p = parse_json_string(p, &key);
+         if(p == NULL) {
+            return(bad_json);
+         }
+         p = skip_json_space(p);
+         if(*p != ':') {
+            return(bad_json);
+         }
+         p = skip_json_space(p + 1);
+         for(i = 0; i < BATCH_MEMBER_COUNT; i++) {
+            if(strcmp(key, batch_members[i][0]) == 0) {
+               if(member_seen[i]) {
+                  return(batch_members[i][1]);
+               }
+               member_seen[i] = 1;
+               break;
+            }
+         }
+
+         if(strcmp(key, "summands") == 0) {
+            if(*p != '[') {
+               return("summands must be an array of words.");
+            }
+            p = skip_json_space(p + 1);
+            puzzle->summand_count = 0;
+            while(*p != ']') {
+
+               // Make room for another summand.
+
+               if(puzzle->summand_count == scratch->size) {
+                  scratch->size = max_of_two(2 * scratch->size, 16);
+                  new_summands = new char*[scratch->size];
+                  new_lengths = new int[scratch->size];
+                  if(puzzle->summand_count) {
+                     memcpy(new_summands, scratch->summands,
+                            puzzle->summand_count * sizeof(char *));
+                  }
+                  delete [] scratch->summands;
+                  delete [] scratch->lengths;
+                  scratch->summands = new_summands;
+                  scratch->lengths = new_lengths;
+                  puzzle->summands = new_summands;
+               }
+               p = parse_json_string(p,
+                                &puzzle->summands[puzzle->summand_count]);
+               if(p == NULL) {
+                  return("summands must be an array of words.");
+               }
+               puzzle->summand_count++;
+               p = skip_json_space(p);
+               if(*p == ',') {
+                  p = skip_json_space(p + 1);
+               } else if(*p != ']') {
+                  return(bad_json);
+               }
+            }
+            p++;
+         } else if(strcmp(key, "sum") == 0) {
+            p = parse_json_string(p, &puzzle->sum);
+            if(p == NULL) {
+               return("sum must be a word.");
+            }
+         } else if(strcmp(key, "factors") == 0) {
+            p = parse_json_words(p, puzzle->factors, 2, &puzzle->factor_count);
+            if(p == NULL || puzzle->factor_count != 2) {
+               return("factors must be an array of two words.");
+            }
+         } else if(strcmp(key, "product") == 0) {
+            p = parse_json_string(p, &puzzle->product);
+            if(p == NULL) {
+               return("product must be a word.");
+            }
+         } else if(strcmp(key, "partials") == 0) {
+            p = parse_json_words(p, puzzle->partials, MAX_LEN,
+                                 &puzzle->partial_count);
+            if(p == NULL) {
+               return("partials must be an array of words.");
+            }
+         } else if(strcmp(key, "radicand") == 0) {
+            p = parse_json_string(p, &puzzle->radicand);
+            if(p == NULL) {
+               return("radicand must be a word.");
+            }
+         } else if(strcmp(key, "root") == 0) {
+            p = parse_json_string(p, &puzzle->root);
+            if(p == NULL) {
+               return("root must be a word.");
+            }
+         } else if(strcmp(key, "relations") == 0) {
+            p = parse_json_words(p, puzzle->relations, MAX_RELATIONS,
+                                 &puzzle->relation_count);
+            if(p == NULL || puzzle->relation_count == 0) {
+               return("relations must be an array of 1 to 32 relations.");
+            }
+         } else if(strcmp(key, "single_zero") == 0) {
+            if(strncmp(p, "true", 4) == 0) {
+               puzzle->single_zero = 1;
+               p += 4;
+            } else if(strncmp(p, "false", 5) == 0) {
+               p += 5;
+            } else {
+               return("single_zero must be true or false.");
+            }
+         } else if(strcmp(key, "base") == 0) {
+            p = parse_json_int(p, &puzzle->base);
+            if(p == NULL || puzzle->base < 2 || puzzle->base > MAX_BASE) {
+               return("base must be a number from 2 to 62.");
+            }
+         } else if(strcmp(key, "stop_after") == 0) {
+            p = parse_json_int(p, &puzzle->stop_after);
+            if(p == NULL || puzzle->stop_after < 0) {
+               return("stop_after must be a number of solutions.");
+            }
+         } else if(strcmp(key, "max_listed") == 0) {
+            p = parse_json_int(p, &puzzle->max_listed);
+            if(p == NULL || puzzle->max_listed < 0) {
+               return("max_listed must be a number of solutions.");
+            }
+         } else if(strcmp(key, "id") == 0) {
+            start = p;
+            p = skip_json_value(p);
+            puzzle->id = start;
+            puzzle->id_length = p ? p - start : 0;
+         } else {
+            p = skip_json_value(p);
+         }
+         if(p == NULL) {
+            return(bad_json);
+         }
+
+         p = skip_json_space(p);
+         if(*p == ',') {
+            p = skip_json_space(p + 1);
+         } else if(*p != '}') {
+            return(bad_json);
+         }
+      }
+      if(*skip_json_space(p + 1) != '\0') {
+         return("There is more on the line after the puzzle.");
+      }
+
+      if((puzzle->summand_count > 0 || puzzle->sum != NULL) +
+            (puzzle->factor_count > 0 || puzzle->product != NULL ||
+             puzzle->partial_count > 0) +
+            (puzzle->radicand != NULL || puzzle->root != NULL) +
+            (puzzle->relation_count > 0) != 1) {
+         return("A puzzle needs summands and a sum, factors and a product, a radicand and a root, or relations.");
+      }
+      if((puzzle->summand_count > 0 || puzzle->sum != NULL) &&
+            (puzzle->summand_count == 0 || puzzle->sum == NULL)) {
+         return("A puzzle needs summands and a sum.");
+      }
+      if((puzzle->factor_count > 0 || puzzle->product != NULL ||
+             puzzle->partial_count > 0) &&
+            (puzzle->factor_count == 0 || puzzle->product == NULL)) {
+         return("A multiplication needs factors and a product.");
+      }
+      if(puzzle->partial_count > 0 &&
+            puzzle->partial_count != (int) strlen(puzzle->factors[1])) {
+         return("There must be a partial product for each letter of the multiplier.");
+      }
+      if((puzzle->radicand != NULL) != (puzzle->root != NULL)) {
+         return("A square root needs a radicand and a root.");
+      }
+      return(NULL);
+   }
+
+
+const char *check_batch_word(
+      char      *word,
+      int       *length,      // Return its length here.
+      alphabet  *letters      // The chars given to the puzzle's letters past Z.
+   )
+   // Upcase a word in place and check that it is only letters and no
+   // longer than MAX_LEN.  This is upcase_and_check_legality with the
+   // message returned instead of printed.  A word that isn't good is
+   // left as it was.  Returns NULL if it is good.
+   {
+      char  chars[MAX_LEN + 1];
+
+
+      *length = read_word(word, word + strlen(word), chars, 1, letters);
+      if(*length == NO_LETTERS_LEFT) {
+         return("There can be no more than 37 letters other than A to Z.");
+      }
+      if(*length <= 0 || *length > MAX_LEN) {
+         return("Words must be letters, no more than 16 of them.");
+      }
+      strcpy(word, chars);
+      return(NULL);
+   }
+
+
+const char *check_batch_words(
+      batch_puzzle   *puzzle,
+      batch_scratch  *scratch,
+      int            *longest_summand   // Return the longest summand's length.
+   )
+   // Upcase and check all of a puzzle's words, putting the summands'
+   // lengths in the scratch.  Returns NULL, or a message with the word
+   // it is about in bad_word.
+   {
+      int          count = 0;
+      const char  *error;
+      int          i;
+      int          length;
+      char        *others[MAX_LEN + 5];
+
+
+      *longest_summand = 0;
+      for(i = 0; i < puzzle->summand_count; i++) {
+         error = check_batch_word(puzzle->summands[i], &scratch->lengths[i],
+                                  &scratch->letters);
+         if(error != NULL) {
+            puzzle->bad_word = puzzle->summands[i];
+            return(error);
+         }
+         *longest_summand = max_of_two(*longest_summand, scratch->lengths[i]);
+      }
+
+      others[count++] = puzzle->sum;
+      for(i = 0; i < puzzle->factor_count; i++) {
+         others[count++] = puzzle->factors[i];
+      }
+      others[count++] = puzzle->product;
+      for(i = 0; i < puzzle->partial_count; i++) {
+         others[count++] = puzzle->partials[i];
+      }
+      others[count++] = puzzle->radicand;
+      others[count++] = puzzle->root;
+      for(i = 0; i < count; i++) {
+         if(others[i] == NULL) {
+            continue;
+         }
+         error = check_batch_word(others[i], &length, &scratch->letters);
+         if(error != NULL) {
+            puzzle->bad_word = others[i];
+            return(error);
+         }
+
+         // The words of a multiplication or root, after the sum, have
+         // values that must fit in 64 bits.
+
+         if(i > 0 && length > longest_value_word(puzzle->base)) {
+            puzzle->bad_word = others[i];
+            return("A word is too long for its value to fit in 64 bits in this base.");
+         }
+      }
+      return(NULL);
+   }
+
+
+void list_batch_solution(
+      void        *context,      // The batch_listing.
+      int          letter_count,
+      const char  *letters,
+      const int   *values
+   )
+   // The visitor for -batch, which adds a solution to the list as a JSON
+   // object until there are as many as were asked for.
+   {
+      int             i;
+      batch_listing  *listing = (batch_listing *) context;
+      char            letter[2] = {0, 0};
+      int             length = 0;
+      char            text[MAX_BASE * (LETTER_SIZE + 16) + 8];
+
+
+      if(listing->listed == listing->max_listed) {
+         return;
+      }
+      text[length++] = (listing->listed == 0) ? '{' : ',';
+      if(listing->listed > 0) {
+         text[length++] = ' ';
+         text[length++] = '{';
+      }
+      for(i = 0; i < letter_count; i++) {
+         if(i > 0) {
+            length += sprintf(&text[length], ", ");
+         }
+         letter[0] = letters[i];
+         text[length++] = '"';
+         length += write_word(letter, &text[length], listing->letters);
+         length += sprintf(&text[length], "\": %d", values[i]);
+      }
+      text[length++] = '}';
+      add_output_text(listing->output, text, length);
+      listing->listed++;
+   }
+
+
+void solve_batch_chunk(
+      batch_chunk           *chunk,
+      batch_scratch         *scratch,
+      const solve_settings  *settings,
+      batch_totals          *totals
+   )
+   // Read, solve and write the results of the puzzles in a chunk.
+   {
+      const char      *bad_p;
+      const char      *char_p;
+      search_counters  counters;
+      int              difficulty;
+      const char      *error;
+      int              i;
+      char            *line;
+      long             line_number;
+      batch_listing    listing;
+      int              longest_summand;
+      char            *next_line;
+      batch_puzzle     puzzle;
+      output_buffer    solutions;
+      int              solution_count;
+      system_layout    system;
+      char             text[200];
+
+
+      solutions.text = NULL;
+      solutions.length = 0;
+      solutions.size = 0;
+      solutions.visit = list_batch_solution;
+      solutions.context = &listing;
+      listing.output = &scratch->listing;
+      listing.letters = &scratch->letters;
+
+      // Reading a puzzle puts nulls in its line, so the next line is
+      // found first.
+
+      next_line = chunk->text;
+      for(line_number = chunk->first_line;
+          line_number < chunk->first_line + chunk->line_count;
+          line_number++) {
+
+         line = next_line;
+         next_line = line + strlen(line) + 1;
+         if(*skip_json_space(line) == '\0') {
+            continue;
+         }
+
+         // Read the puzzle and check its words.  Its letters past Z are
+         // given chars from the start again.
+
+         scratch->letters.count = 0;
+         error = parse_batch_puzzle(line, &puzzle, scratch);
+         if(error == NULL) {
+            error = check_batch_words(&puzzle, scratch, &longest_summand);
+         }
+         if(error == NULL && puzzle.relation_count > 0) {
+            error = lay_out_system(&system, puzzle.relations,
+                                   puzzle.relation_count, puzzle.base,
+                                   puzzle.single_zero, &scratch->letters);
+         }
+
+         add_output_text(&chunk->output, "{", 1);
+         if(puzzle.id != NULL && puzzle.id_length > 0) {
+            add_output_text(&chunk->output, "\"id\": ", 6);
+            add_output_text(&chunk->output, puzzle.id, puzzle.id_length);
+            add_output_text(&chunk->output, ", ", 2);
+         }
+         totals->puzzles++;
+         if(error != NULL) {
+            totals->errors++;
+            sprintf(text, "\"line\": %ld, \"error\": \"", line_number);
+            add_output(&chunk->output, text);
+            add_output(&chunk->output, error);
+            if(puzzle.bad_word != NULL) {
+               add_output_text(&chunk->output, "  Problem with: ", 16);
+
+               // Letters past ASCII are written as they were read, and
+               // anything else that isn't a letter or digit as a ?.
+
+               bad_p = puzzle.bad_word;
+               for(i = 0; i < 40 && *bad_p != '\0'; ) {
+                  char_p = bad_p;
+                  if((*bad_p & 0x80) && decode_utf8(&bad_p, bad_p + 4) > 0) {
+                     memcpy(&text[i], char_p, bad_p - char_p);
+                     i += bad_p - char_p;
+                  } else {
+                     text[i++] = ((*bad_p & 0x80) == 0 && isalnum(*bad_p)) ?
+                                    *bad_p : '?';
+                     bad_p++;
+                  }
+               }
+               add_output_text(&chunk->output, text, i);
+            }
+            add_output(&chunk->output, "\"}\n");
+            continue;
+         }
+
+         // Solve it, listing the solutions in the scratch buffer.
+
+         scratch->listing.length = 0;
+         listing.listed = 0;
+         listing.max_listed = puzzle.max_listed;
+         if(puzzle.sum != NULL) {
+            solution_count = solve_part(puzzle.summands, puzzle.summand_count,
+                                scratch->lengths, longest_summand, puzzle.sum,
+                                puzzle.base, puzzle.max_listed > 0,
+                                puzzle.stop_after, settings, NULL, 0, NULL,
+                                &solutions, &scratch->arena, &counters,
+                                &difficulty);
+         } else if(puzzle.relation_count > 0) {
+            solution_count = solve_system(&system, puzzle.max_listed > 0,
+                                puzzle.stop_after, &solutions, &counters,
+                                &difficulty);
+         } else if(puzzle.root != NULL) {
+            solution_count = solve_product(puzzle.root, puzzle.root,
+                                puzzle.radicand, NULL, 0, puzzle.base,
+                                puzzle.max_listed > 0, puzzle.stop_after,
+                                &solutions, &counters, &difficulty);
+         } else {
+            solution_count = solve_product(puzzle.factors[0],
+                                puzzle.factors[1], puzzle.product,
+                                puzzle.partials, puzzle.partial_count,
+                                puzzle.base, puzzle.max_listed > 0,
+                                puzzle.stop_after, &solutions, &counters,
+                                &difficulty);
+         }
+         totals->backtracks += counters.backtracks;
+
+         sprintf(text, "\"line\": %ld, \"solutions\": %d, \"stopped_early\": %s, "
+                       "\"difficulty\": %d, \"backtracks\": %lu, \"listed\": [",
+                 line_number, solution_count,
+                 counters.stopped_early ? "true" : "false", difficulty,
+                 counters.backtracks);
+         add_output(&chunk->output, text);
+         if(scratch->listing.length) {
+            add_output_text(&chunk->output, scratch->listing.text,
+                            scratch->listing.length);
+         }
+         add_output(&chunk->output, "]}\n");
+      }
+   }
+
+
+batch_chunk *read_batch_chunk(
+      batch_reader  *reader
+   )
+   // Wait for input and return a chunk with the whole lines that have
+   // come in, up to BATCH_CHUNK_LINES of them.  Lines already read are
+   // used without waiting for more.  A last line with no newline is
+   // taken once the input runs out.  Returns NULL at the end of the
+   // input, or if it can't be read.
+   {
+      batch_chunk  *chunk;
+      int           line_count;
+      int           line_end;
+      char         *new_buffer;
+      int           read_count;
+      int           scan;
+
+
+      while(1) {
+
+         // See how many whole lines there are.
+
+         line_count = 0;
+         line_end = reader->start;
+         for(scan = reader->start;
+             scan < reader->end && line_count < BATCH_CHUNK_LINES; scan++) {
+            if(reader->buffer[scan] == '\n') {
+               line_count++;
+               line_end = scan + 1;
+            }
+         }
+         if(line_count == 0 && reader->at_end && reader->end > reader->start) {
+            line_count = 1;
+            line_end = reader->end;
+         }
+         if(line_count > 0) {
+            break;
+         }
+         if(reader->at_end) {
+            return(NULL);
+         }
+
+         // Read more, first moving what is left to the front of the
+         // buffer and making it bigger if a line fills it.
+
+         if(reader->start > 0) {
+            memmove(reader->buffer, reader->buffer + reader->start,
+                    reader->end - reader->start);
+            reader->end -= reader->start;
+            reader->start = 0;
+         }
+         if(reader->end == reader->size) {
+            reader->size *= 2;
+            new_buffer = new char[reader->size];
+            memcpy(new_buffer, reader->buffer, reader->end);
+            delete [] reader->buffer;
+            reader->buffer = new_buffer;
+         }
+         read_count = read(reader->file, reader->buffer + reader->end,
+                           reader->size - reader->end);
+         if(read_count <= 0) {
+            reader->at_end = 1;
+         } else {
+            reader->end += read_count;
+         }
+      }
+
+      // Copy the lines into the chunk, ending each with a null.
+
+      chunk = new batch_chunk;
+      chunk->text = new char[line_end - reader->start + 1];
+      memcpy(chunk->text, reader->buffer + reader->start,
+             line_end - reader->start);
+      chunk->text[line_end - reader->start] = '\n';
+      for(scan = 0; scan <= line_end - reader->start; scan++) {
+         if(chunk->text[scan] == '\n') {
+            chunk->text[scan] = '\0';
+            if(scan > 0 && chunk->text[scan - 1] == '\r') {
+               chunk->text[scan - 1] = '\0';
+            }
+         }
+      }
+      chunk->line_count = line_count;
+      chunk->first_line = reader->line_number;
+      chunk->sequence = reader->sequence++;
+      chunk->output.text = NULL;
+      chunk->output.length = 0;
+      chunk->output.size = 0;
+      chunk->output.visit = NULL;
+      chunk->next = NULL;
+      reader->line_number += line_count;
+      reader->start = line_end;
+      return(chunk);
+   }
+
 
+void write_batch_chunk(
+      batch_chunk  *chunk
+   )
+   // Write out a chunk's results and free it.
+   {
+      if(chunk->output.length) {
+         fwrite(chunk->output.text, 1, chunk->output.length, stdout);
+         fflush(stdout);
+      }
+      delete [] chunk->output.text;
+      delete [] chunk->text;
+      delete chunk;
+   }
 
-      // Initialize search count.
 
-      *total_searched = 0;
+void finish_batch_chunk(
+      batch_work   *work,
+      batch_chunk  *chunk
+   )
+   // Write a chunk that has been solved.  With -ordered it waits in the
+   // finished list, kept in order, until the chunks before it have been
+   // written.
+   {
+      batch_chunk  **place;
 
-      // First fill in the bit_count array.  This holds the number
-      // of set bits in the the index number.  This could be made static.
 
-      for(i = 0; i < 512; i++) {
-         bits = 0;
-         for(j = 0; j < 9; j++ ) {
-            bits += ((i >> j) & 0x1);
+      std::lock_guard<std::mutex> guard(work->lock);
+      if(!work->ordered) {
+         write_batch_chunk(chunk);
+         work->in_flight--;
+      } else {
+         place = &work->finished;
+         while(*place != NULL && (*place)->sequence < chunk->sequence) {
+            place = &(*place)->next;
+         }
+         chunk->next = *place;
+         *place = chunk;
+         while(work->finished != NULL &&
+               work->finished->sequence == work->next_to_write) {
+            chunk = work->finished;
+            work->finished = chunk->next;
+            write_batch_chunk(chunk);
+            work->next_to_write++;
+            work->in_flight--;
          }
-         bit_count[i] = bits;
       }
+      work->changed.notify_all();
+   }
 
-      // Determine the letters used by each word.
 
-      letters_used = new int[word_count];
-      for(i = 0; i < word_count; i++) {
-         letters_used[i] = 0;
-         for(j = 0; j < word_lengths[i]; j++) {
-            letters_used[i] |= (1 << (words[i][j] - 'A'));
-         }
-      }
+void init_batch_scratch(
+      batch_scratch  *scratch
+   )
+   {
+      init_arena(&scratch->arena);
+      scratch->summands = NULL;
+      scratch->lengths = NULL;
+      scratch->size = 0;
+      scratch->listing.text = NULL;
+      scratch->listing.length = 0;
+      scratch->listing.size = 0;
+      scratch->listing.visit = NULL;
+      scratch->letters.count = 0;
+   }
 
-      // Now go through the different summand counts.
 
-      for(summand_count = low_summand_count;
-          summand_count <= high_summand_count;
-          summand_count++) {
+void free_batch_scratch(
+      batch_scratch  *scratch
+   )
+   {
+      free_arena(&scratch->arena);
+      delete [] scratch->summands;
+      delete [] scratch->lengths;
+      delete [] scratch->listing.text;
+   }
 
-         // Now call the function that looks for puzzles with a
-         // specific number of summands.
 
-         number_found += look_for_puzzles_specific_count(words,
-                            word_count, base, word_lengths,
-                            bit_count, letters_used, summand_count,
-                            exactly_one, disallow_rep, first_sum_only,
-                            &search_count);
-         *total_searched += search_count;
+void batch_worker(
+      batch_work  *work
+   )
+   // Solve chunks from the queue until it is empty and nothing more
+   // will be read.
+   {
+      batch_chunk    *chunk;
+      batch_scratch   scratch;
+
+
+      init_batch_scratch(&scratch);
+      while(1) {
+         {
+            std::unique_lock<std::mutex> guard(work->lock);
+            while(work->queue_head == NULL && !work->done_reading) {
+               work->changed.wait(guard);
+            }
+            chunk = work->queue_head;
+            if(chunk == NULL) {
+               break;
+            }
+            work->queue_head = chunk->next;
+            if(work->queue_head == NULL) {
+               work->queue_tail = NULL;
+            }
+         }
+         solve_batch_chunk(chunk, &scratch, work->settings, work->totals);
+         finish_batch_chunk(work, chunk);
       }
+      free_batch_scratch(&scratch);
+   }
 
-      // Get rid of the arrays we allocated.
 
-      delete [] letters_used;
+int solve_batch(
+      const char            *path,          // The file to read.  NULL for stdin.
+      const solve_settings  *settings,
+      int                    thread_count,
+      int                    ordered,       // 1 to write the results in input order.
+      int                    stats          // 1 to print totals to stderr.
+   )
+   // Solve the puzzles in a file of JSON lines, writing a line of JSON
+   // with the result for each.  See above for the formats.  Returns 0
+   // after printing a message if the file can't be read, and 1
+   // otherwise, even if some of the puzzles couldn't be.
+   {
+      batch_chunk    *chunk;
+      double          elapsed;
+      int             i;
+      batch_reader    reader;
+      batch_scratch   scratch;
+      std::chrono::steady_clock::time_point  start_time;
+      std::thread    *threads;
+      batch_totals    totals;
+      batch_work      work;
+
+
+      reader.file = 0;
+      if(path != NULL) {
+         reader.file = open(path, O_RDONLY);
+         if(reader.file < 0) {
+            fprintf(stderr, "Couldn't read %s.\n", path);
+            return(0);
+         }
+      }
+      reader.size = BATCH_READ_SIZE;
+      reader.buffer = new char[reader.size];
+      reader.start = 0;
+      reader.end = 0;
+      reader.at_end = 0;
+      reader.line_number = 1;
+      reader.sequence = 0;
+      totals.puzzles = 0;
+      totals.errors = 0;
+      totals.backtracks = 0;
+      start_time = std::chrono::steady_clock::now();
+
+      if(thread_count <= 1) {
+
+         // One thread does it all, a chunk at a time.
+
+         init_batch_scratch(&scratch);
+         while((chunk = read_batch_chunk(&reader)) != NULL) {
+            solve_batch_chunk(chunk, &scratch, settings, &totals);
+            write_batch_chunk(chunk);
+         }
+         free_batch_scratch(&scratch);
+
+      } else {
+
+         work.queue_head = NULL;
+         work.queue_tail = NULL;
+         work.finished = NULL;
+         work.in_flight = 0;
+         work.max_in_flight = BATCH_CHUNKS_PER_THREAD * thread_count;
+         work.done_reading = 0;
+         work.next_to_write = 0;
+         work.ordered = ordered;
+         work.settings = settings;
+         work.totals = &totals;
+         threads = new std::thread[thread_count];
+         for(i = 0; i < thread_count; i++) {
+            threads[i] = std::thread(batch_worker, &work);
+         }
 
-      return(number_found);
+         // Read chunks and queue them, waiting when too many are held.
+
+         while((chunk = read_batch_chunk(&reader)) != NULL) {
+            std::unique_lock<std::mutex> guard(work.lock);
+            while(work.in_flight >= work.max_in_flight) {
+               work.changed.wait(guard);
+            }
+            if(work.queue_tail != NULL) {
+               work.queue_tail->next = chunk;
+            } else {
+               work.queue_head = chunk;
+            }
+            work.queue_tail = chunk;
+            work.in_flight++;
+            work.changed.notify_all();
+         }
+         {
+            std::lock_guard<std::mutex> guard(work.lock);
+            work.done_reading = 1;
+            work.changed.notify_all();
+         }
+         for(i = 0; i < thread_count; i++) {
+            threads[i].join();
+         }
+         delete [] threads;
+      }
+
+      if(path != NULL) {
+         close(reader.file);
+      }
+      delete [] reader.buffer;
+
+      if(stats) {
+         elapsed = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start_time).count();
+         fprintf(stderr, "{\"batch\": {\"puzzles\": %ld, \"errors\": %ld, "
+                         "\"backtracks\": %lu, \"seconds\": %.3f, "
+                         "\"puzzles_per_second\": %.0f}}\n",
+                 totals.puzzles.load(), totals.errors.load(),
+                 totals.backtracks.load(), elapsed,
+                 elapsed > 0 ? totals.puzzles.load() / elapsed : 0.0);
+      }
+      return(1);
    }
 
 
@@ -1346,9 +7970,10 @@ void print_usage()
       printf("    swp -solve\n");
       printf("\n");
       printf("The program will ask for the base to solve the puzzle in (almost\n");
-      printf("always 10).  It will then ask for the summand words to be input and\n");
-      printf("finally the sum.  If the base used is to be 10, then the command line\n");
-      printf("alone can be used as:\n");
+      printf("always 10, and at most %d).  It will then ask for the summand words\n",
+             MAX_BASE);
+      printf("to be input and finally the sum.  If the base used is to be 10,\n");
+      printf("then the command line alone can be used as:\n");
       printf("\n");
       printf("    swp -solve {summands} sum\n");
       printf("\n");
@@ -1371,13 +7996,610 @@ void print_usage()
       printf("\n");
       printf("    swp -find {words}\n");
       printf("\n");
+      printf("Multiplications and square roots are solved with -multiply and\n");
+      printf("-root, in base 10.  A long multiplication can be given with its\n");
+      printf("partial products, one for each letter of the multiplier from the\n");
+      printf("right, as in\n");
+      printf("\n");
+      printf("    swp -multiply deh cg caic gje jacc\n");
+      printf("\n");
+      printf("and a square root with the number under the root first.\n");
+      printf("\n");
+      printf("    swp -multiply multiplicand multiplier {partial products} product\n");
+      printf("    swp -root radicand root\n");
+      printf("\n");
+      printf("Subtractions, long divisions and other puzzles with more than one\n");
+      printf("line to check are solved with -system.  Each line is given as a\n");
+      printf("relation between words with +, -, * and =, and all of them are\n");
+      printf("solved together.  For the long division EA ) ABCD = FD with the\n");
+      printf("working lines AFF, GHD, GHD and I:\n");
+      printf("\n");
+      printf("    swp -single-zero -system \"EA*F=AFF\" \"ABC-AFF=GH\" \"EA*D=GHD\" \"GHD-GHD=I\"\n");
+      printf("\n");
+      printf("As in the other puzzles, no word can start with a zero, unless\n");
+      printf("-single-zero is given.  Then a word of one letter, like the last\n");
+      printf("remainder I here, can be zero.\n");
+      printf("\n");
+      printf("To solve many puzzles with one run of the program the -batch\n");
+      printf("option is used.  Each line of the file, or of the input if no file\n");
+      printf("is given, is a puzzle as JSON, like\n");
+      printf("\n");
+      printf("    {\"id\": 1, \"summands\": [\"SEND\", \"MORE\"], \"sum\": \"MONEY\"}\n");
+      printf("\n");
+      printf("with base, stop_after and max_listed (%d by default) if wanted.\n",
+             DEFAULT_BATCH_LISTED);
+      printf("Multiplications have factors, product and partials in place of\n");
+      printf("summands and sum, square roots have radicand and root, and\n");
+      printf("systems have relations.  In a base over 16, the words of\n");
+      printf("multiplications, square roots and systems are limited to as many\n");
+      printf("letters as keep their values in 64 bits, 12 in base 36.\n");
+      printf("A line of JSON is printed for each with the id, the number of\n");
+      printf("solutions, the difficulty and up to max_listed of the solutions.\n");
+      printf("\n");
+      printf("    swp -batch {file}\n");
+      printf("\n");
       printf("Summary of usage:\n");
       printf("  'swp -solve {summands} sum'  Solve puzzle in base 10.\n");
       printf("  'swp -solve' Solve a puzzle.  Prompt for base, summands, and sum.\n");
       printf("  'swp -find {words}'  Look for puzzles.  Base 10.  Duplication & one solution.\n");
       printf("  'swp -find'  Look for puzzles.  Prompt for words and info.\n");
+      printf("  'swp -multiply a b {partials} product'  Solve a multiplication in base 10.\n");
+      printf("  'swp -root radicand root'  Solve a square root in base 10.\n");
+      printf("  'swp -system {relations}'  Solve relations together in base 10.\n");
+      printf("  'swp -batch {file}'  Solve puzzles given as lines of JSON.\n");
       printf("  'swp -usage' Generates this usage message.\n");
       printf("  'swp -help'  Generates this usage message.\n");
+      printf("\n");
+      printf("Options that may be given anywhere on the command line:\n");
+      printf("  '-threads N' Use N threads to solve or look for puzzles.  0 uses one\n");
+      printf("               per core.\n");
+      printf("  '-engine E'  How to search.  E is scan (the default) to look for\n");
+      printf("               free digits one at a time, mask to keep them in a\n");
+      printf("               bit mask, or program to compile the puzzle into a\n");
+      printf("               list of steps first.  All find the same solutions.\n");
+      printf("               linear solves the puzzle as one equation, trying\n");
+      printf("               the letters that matter most first.  It finds the\n");
+      printf("               same solutions in a different order, with its own\n");
+      printf("               difficulty, on one thread.  It is much faster for\n");
+      printf("               puzzles with many summands.  meet is linear, but\n");
+      printf("               once the search has gone on long enough, the\n");
+      printf("               letters that matter least are looked up in a\n");
+      printf("               table instead.  It is faster for hard puzzles and\n");
+      printf("               the same as linear for easy ones, with a lower\n");
+      printf("               difficulty when it uses a table.\n");
+      printf("  '-meet-memory N'\n");
+      printf("               The most megabytes the meet table can use.  The\n");
+      printf("               default is %d.  With too little, meet is linear.\n",
+             DEFAULT_MEET_MEMORY);
+      printf("  '-generic'   Don't use the copies of the search made for base 10\n");
+      printf("               and base 16.  Used to compare their speed.\n");
+      printf("  '-prune'     Work harder at each step to rule out values, so\n");
+      printf("               fewer are tried.  The solutions are the same, but\n");
+      printf("               the backtrack counts and so the difficulty are lower.\n");
+      printf("               Uses the mask search whatever engine is chosen.\n");
+      printf("  '-stats'     Print what the search did as a line of JSON: the\n");
+      printf("               backtracks and why they were made, the most\n");
+      printf("               letters set at once and the times each column,\n");
+      printf("               leftmost first, was come to.  For each puzzle\n");
+      printf("               solved, or added up over the puzzles -find\n");
+      printf("               searched.  With -batch, the totals and the\n");
+      printf("               puzzles per second go to stderr.\n");
+      printf("  '-unique'    With -solve, -multiply, -root or -system, stop at the\n");
+      printf("               second solution and say if the puzzle has none, one\n");
+      printf("               or more than one.  -find does this itself when only\n");
+      printf("               puzzles with one solution are wanted.\n");
+      printf("  '-single-zero'\n");
+      printf("               With -system, let a word of one letter be zero.\n");
+      printf("  '-ordered'   With -batch and more than one thread, print the\n");
+      printf("               results in the order of the puzzles rather than\n");
+      printf("               as they are solved.\n");
+      printf("  '-wordfile F'\n");
+      printf("               With -find, read the words from file F instead of\n");
+      printf("               asking for them.  Each line has a word and, if\n");
+      printf("               wanted, how many times it is used, like the lists\n");
+      printf("               in Languages.  Words with characters other than\n");
+      printf("               letters are left out, as are repeats.\n");
+      printf("  '-apostrophes A'\n");
+      printf("               What to do with words like DON'T in a word file.\n");
+      printf("               skip (the default) leaves them out, and drop takes\n");
+      printf("               out the apostrophe.\n");
+      printf("  '-min-count N'\n");
+      printf("               Leave out words in a word file used fewer than N\n");
+      printf("               times.  Words with no count are left out too.\n");
+      printf("  '-min-length N' and '-max-length N'\n");
+      printf("               Leave out words in a word file with fewer or more\n");
+      printf("               than N letters.\n");
+      printf("  '-fold-accents'\n");
+      printf("               Read letters with accents as the letters without\n");
+      printf("               them, so E, É and È are all E.  Otherwise words are\n");
+      printf("               read as UTF-8, each letter, accents and all, is its\n");
+      printf("               own letter, and there can be up to %d of them\n",
+             EXTRA_LETTERS);
+      printf("               besides A to Z in a puzzle, or in the word list\n");
+      printf("               for -find.  Letters like Æ and Ø that aren't made\n");
+      printf("               with an accent are always their own.\n");
+      printf("  '-cache N'   When looking for puzzles, remember how N puzzles came\n");
+      printf("               out so the same puzzle with other letters isn't\n");
+      printf("               solved again.  Each thread has its own.  The default\n");
+      printf("               is %d.  0 turns it off.\n", DEFAULT_CACHE_ENTRIES);
+   }
+
+
+// Reading the words for -find from a file.  The word lists in
+// Languages have a word and how often it is used on each line, sorted
+// with the most used first, and run to hundreds of thousands of lines.
+// The file is mapped into memory and read straight from there.  The
+// words that are kept are copied one after another into a single
+// buffer, so there is one allocation for all of them rather than one
+// for each.
+
+const int APOSTROPHE_SKIP = 0;   // Leave out words like DON'T.
+const int APOSTROPHE_DROP = 1;   // Take the apostrophe out: DONT.
+
+struct word_filter {
+   int    apostrophes;       // APOSTROPHE_SKIP or APOSTROPHE_DROP.
+   long   min_count;         // Leave out words used fewer times than this.
+   int    min_length;        // Leave out words with fewer letters.
+   int    max_length;        // Leave out words with more letters.
+};
+
+struct word_list {
+   const char   *map;        // The file as mapped.
+   size_t        map_size;
+   char         *text;       // The words kept, each ending in a null.
+   char        **words;      // Pointers into text.
+   int          *lengths;
+   int           count;
+   int           longest;
+   int           left_out;   // Lines that were filtered out or repeated.
+   int           bad;        // Lines with characters that aren't letters.
+};
+
+
+const char *map_file(
+      const char  *path,     // The file to map.
+      size_t      *size      // Return the size of the file here.
+   )
+   // Map a file into memory to be read.  Returns NULL after printing a
+   // message if it can't be.  Where there's no mmap the file is read
+   // into a buffer instead.  unmap_file gives it back.
+   {
+#if defined(_WIN32)
+      char   *data;
+      FILE   *file;
+      long    length;
+
+
+      file = fopen(path, "rb");
+      if(file == NULL || fseek(file, 0, SEEK_END) != 0 ||
+            (length = ftell(file)) < 0) {
+         printf("Couldn't read %s.\n", path);
+         if(file != NULL) {
+            fclose(file);
+         }
+         return(NULL);
+      }
+      rewind(file);
+      data = new char[length + 1];
+      *size = fread(data, 1, length, file);
+      fclose(file);
+      return(data);
+#else
+      void         *data;
+      int           fd;
+      struct stat   info;
+
+
+      fd = open(path, O_RDONLY);
+      if(fd < 0 || fstat(fd, &info) != 0) {
+         printf("Couldn't read %s.\n", path);
+         if(fd >= 0) {
+            close(fd);
+         }
+         return(NULL);
+      }
+      *size = info.st_size;
+
+      // An empty file can't be mapped, but there's nothing to read.
+
+      if(*size == 0) {
+         close(fd);
+         return("");
+      }
+      data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if(data == MAP_FAILED) {
+         printf("Couldn't map %s into memory.\n", path);
+         return(NULL);
+      }
+      madvise(data, *size, MADV_SEQUENTIAL);
+      return((const char *) data);
+#endif
+   }
+
+
+void unmap_file(
+      const char  *data,
+      size_t       size
+   )
+   {
+#if defined(_WIN32)
+      delete [] data;
+#else
+      if(size) {
+         munmap((void *) data, size);
+      }
+#endif
+   }
+
+
+inline unsigned int hash_word(
+      const char  *word,
+      int          length
+   )
+   {
+      unsigned int  hash = 2166136261u;
+      int           i;
+
+
+      for(i = 0; i < length; i++) {
+         hash = (hash ^ (unsigned char) word[i]) * 16777619u;
+      }
+      return(hash);
+   }
+
+
+int read_word_file(
+      const char   *path,     // The file to read.
+      word_filter  *filter,   // Which words to keep.
+      word_list    *list      // Return the words here.
+   )
+   // Read the words in a file with a word on each line, optionally
+   // followed by how often it's used.  Letters are upcased.  Words with
+   // any other characters are left out, as are those that don't pass
+   // the filter and any that are the same as one earlier in the file.
+   // A word without a count passes a min_count of 0 only.  Returns 0
+   // after printing a message if the file can't be read.  free_word_list
+   // gives back the memory.
+   {
+      long           count;
+      const char    *end;
+      unsigned int   hash;
+      int            i;
+      int            kept;
+      int            length;
+      int            letter;
+      int            line_count;
+      const char    *line_end;
+      int            new_letters;
+      char          *out;
+      const char    *p;
+      int            slot;
+      int           *table;
+      int            table_mask;
+      int            usable;
+      const char    *word_start;
+
+
+      memset(list, 0, sizeof(*list));
+      list->map = map_file(path, &list->map_size);
+      if(list->map == NULL) {
+         return(0);
+      }
+      end = list->map + list->map_size;
+
+      // Count the lines so that the arrays can be allocated once.  Each
+      // kept word with its null takes no more room than its line did,
+      // counting the newline, and the last line may not have one.
+
+      line_count = 1;
+      for(p = list->map; (p = (const char *) memchr(p, '\n', end - p)) != NULL;
+            p++) {
+         line_count++;
+      }
+      list->text = new char[list->map_size + 1];
+      list->words = new char*[line_count];
+      list->lengths = new int[line_count];
+
+      // The words kept so far go in a hash table to find repeats.  It
+      // holds their indexes, with -1 for an empty slot.
+
+      for(table_mask = 1; table_mask < 2 * line_count; table_mask <<= 1) {
+      }
+      table = new int[table_mask];
+      table_mask--;
+      memset(table, -1, sizeof(int) * (table_mask + 1));
+
+      out = list->text;
+      for(p = list->map; p < end; p = line_end + 1) {
+         line_end = (const char *) memchr(p, '\n', end - p);
+         if(line_end == NULL) {
+            line_end = end;
+         }
+
+         // Copy the word out, upcasing it, until the whitespace after
+         // it.  Stop at anything that isn't a letter.  Letters not seen
+         // before aren't given chars until the word is known to be
+         // kept, so words left out don't use them up.
+
+         while(p < line_end && (*p == ' ' || *p == '\t')) {
+            p++;
+         }
+         if(p == line_end || *p == '\r') {
+            continue;
+         }
+         word_start = p;
+         length = 0;
+         new_letters = 0;
+         usable = 1;
+         while(p < line_end && *p != ' ' && *p != '\t' && *p != '\r') {
+            if(*p == '\'' && filter->apostrophes == APOSTROPHE_DROP) {
+               p++;
+               continue;
+            }
+            letter = read_letter(&p, line_end, 0, &run_letters);
+            if(letter == NEW_LETTER) {
+               new_letters = 1;
+            } else if(letter <= 0) {
+               usable = 0;
+               break;
+            }
+            out[length++] = letter;
+         }
+         if(!usable || length == 0) {
+            list->bad++;
+            continue;
+         }
+
+         // Then the count, if there is one.
+
+         while(p < line_end && (*p == ' ' || *p == '\t')) {
+            p++;
+         }
+         count = 0;
+         while(p < line_end && *p >= '0' && *p <= '9') {
+            count = count * 10 + *p++ - '0';
+         }
+         if(count < filter->min_count || length < filter->min_length ||
+               length > filter->max_length) {
+            list->left_out++;
+            continue;
+         }
+
+         // Read the word again to give its new letters chars.  If there
+         // are none left, it's left out like a word with characters that
+         // aren't letters.
+
+         if(new_letters) {
+            length = 0;
+            letter = 1;
+            p = word_start;
+            while(letter > 0 && p < line_end && *p != ' ' && *p != '\t' &&
+                  *p != '\r') {
+               if(*p == '\'' && filter->apostrophes == APOSTROPHE_DROP) {
+                  p++;
+                  continue;
+               }
+               letter = read_letter(&p, line_end, 1, &run_letters);
+               out[length++] = letter;
+            }
+            if(letter <= 0) {
+               list->bad++;
+               continue;
+            }
+         }
+
+         // Keep the word unless it's been seen already.
+
+         hash = hash_word(out, length);
+         for(slot = hash & table_mask; table[slot] >= 0;
+               slot = (slot + 1) & table_mask) {
+            i = table[slot];
+            if(list->lengths[i] == length &&
+                  memcmp(list->words[i], out, length) == 0) {
+               break;
+            }
+         }
+         if(table[slot] >= 0) {
+            list->left_out++;
+            continue;
+         }
+         kept = list->count++;
+         table[slot] = kept;
+         out[length] = '\0';
+         list->words[kept] = out;
+         list->lengths[kept] = length;
+         if(length > list->longest) {
+            list->longest = length;
+         }
+         out += length + 1;
+      }
+
+      delete [] table;
+      return(1);
+   }
+
+
+void free_word_list(
+      word_list  *list
+   )
+   {
+      delete [] list->text;
+      delete [] list->words;
+      delete [] list->lengths;
+      if(list->map != NULL) {
+         unmap_file(list->map, list->map_size);
+      }
+      memset(list, 0, sizeof(*list));
+   }
+
+
+// Options that can be given anywhere on the command line.  These are
+// removed from argv before the rest of the arguments are looked at.
+
+struct run_options {
+   int             thread_count;    // Number of threads to use.
+   int             cache_entries;   // Size of each thread's -find cache.
+   solve_settings  settings;        // How to solve puzzles.
+   int             stats;           // 1 to print the search's counters.
+   int             unique;          // 1 to have -solve stop at the second solution.
+   int             ordered;         // 1 for -batch to keep the input's order.
+   int             single_zero;     // 1 if -system can make a one letter word 0.
+   const char     *word_file;       // Where -find gets its words.  NULL to ask.
+   word_filter     filter;          // Which of the file's words to use.
+   int             fold_accents;    // 1 to read É as E and so on.
+};
+
+
+int parse_options(
+      int          *argc,
+      char         *argv[],
+      run_options  *options
+   )
+   // Fill in the options from the command line and remove them from
+   // argv, adjusting argc to match.  Returns 0 after printing a message
+   // if there is a problem with an option, and 1 otherwise.
+   {
+      int  i;
+      int  j;
+      int  used;
+
+
+      options->thread_count = 1;
+      options->cache_entries = DEFAULT_CACHE_ENTRIES;
+      options->settings.engine = ENGINE_SCAN;
+      options->settings.specialize = 1;
+      options->settings.prune = 0;
+      options->settings.meet_memory = DEFAULT_MEET_MEMORY;
+      options->stats = 0;
+      options->unique = 0;
+      options->ordered = 0;
+      options->single_zero = 0;
+      options->word_file = NULL;
+      options->filter.apostrophes = APOSTROPHE_SKIP;
+      options->filter.min_count = 0;
+      options->filter.min_length = 1;
+      options->filter.max_length = MAX_LEN;
+      options->fold_accents = 0;
+
+      i = 1;
+      while(i < *argc) {
+
+         // Each option sets used to the number of arguments it takes
+         // up, counting itself.
+
+         used = 2;
+         if(strcmp(argv[i], "-threads") == 0) {
+            if(i + 1 >= *argc || sscanf(argv[i + 1], "%d",
+                                        &options->thread_count) != 1
+                              || options->thread_count < 0) {
+               printf("-threads must be followed by the number of threads.\n");
+               return(0);
+            }
+            if(options->thread_count == 0) {
+               options->thread_count = std::thread::hardware_concurrency();
+            }
+         } else if(strcmp(argv[i], "-cache") == 0) {
+            if(i + 1 >= *argc || sscanf(argv[i + 1], "%d",
+                                        &options->cache_entries) != 1
+                              || options->cache_entries < 0) {
+               printf("-cache must be followed by the number of puzzles to keep.\n");
+               return(0);
+            }
+         } else if(strcmp(argv[i], "-generic") == 0) {
+            options->settings.specialize = 0;
+            used = 1;
+         } else if(strcmp(argv[i], "-meet-memory") == 0) {
+            if(i + 1 >= *argc || sscanf(argv[i + 1], "%d",
+                                        &options->settings.meet_memory) != 1
+                              || options->settings.meet_memory < 0) {
+               printf("-meet-memory must be followed by a number of megabytes.\n");
+               return(0);
+            }
+         } else if(strcmp(argv[i], "-prune") == 0) {
+            options->settings.prune = 1;
+            used = 1;
+         } else if(strcmp(argv[i], "-stats") == 0) {
+            options->stats = 1;
+            used = 1;
+         } else if(strcmp(argv[i], "-unique") == 0) {
+            options->unique = 1;
+            used = 1;
+         } else if(strcmp(argv[i], "-ordered") == 0) {
+            options->ordered = 1;
+            used = 1;
+         } else if(strcmp(argv[i], "-single-zero") == 0) {
+            options->single_zero = 1;
+            used = 1;
+         } else if(strcmp(argv[i], "-fold-accents") == 0) {
+            options->fold_accents = 1;
+            used = 1;
+         } else if(strcmp(argv[i], "-wordfile") == 0) {
+            if(i + 1 >= *argc) {
+               printf("-wordfile must be followed by the name of a file.\n");
+               return(0);
+            }
+            options->word_file = argv[i + 1];
+         } else if(strcmp(argv[i], "-apostrophes") == 0) {
+            if(i + 1 < *argc && strcmp(argv[i + 1], "skip") == 0) {
+               options->filter.apostrophes = APOSTROPHE_SKIP;
+            } else if(i + 1 < *argc && strcmp(argv[i + 1], "drop") == 0) {
+               options->filter.apostrophes = APOSTROPHE_DROP;
+            } else {
+               printf("-apostrophes must be followed by skip or drop.\n");
+               return(0);
+            }
+         } else if(strcmp(argv[i], "-min-count") == 0) {
+            if(i + 1 >= *argc || sscanf(argv[i + 1], "%ld",
+                                        &options->filter.min_count) != 1
+                              || options->filter.min_count < 0) {
+               printf("-min-count must be followed by a number of uses.\n");
+               return(0);
+            }
+         } else if(strcmp(argv[i], "-min-length") == 0) {
+            if(i + 1 >= *argc || sscanf(argv[i + 1], "%d",
+                                        &options->filter.min_length) != 1
+                              || options->filter.min_length < 1) {
+               printf("-min-length must be followed by a number of letters.\n");
+               return(0);
+            }
+         } else if(strcmp(argv[i], "-max-length") == 0) {
+            if(i + 1 >= *argc || sscanf(argv[i + 1], "%d",
+                                        &options->filter.max_length) != 1
+                              || options->filter.max_length < 1
+                              || options->filter.max_length > MAX_LEN) {
+               printf("-max-length must be followed by a number of letters up to %d.\n",
+                      MAX_LEN);
+               return(0);
+            }
+         } else if(strcmp(argv[i], "-engine") == 0) {
+            if(i + 1 < *argc && strcmp(argv[i + 1], "scan") == 0) {
+               options->settings.engine = ENGINE_SCAN;
+            } else if(i + 1 < *argc && strcmp(argv[i + 1], "mask") == 0) {
+               options->settings.engine = ENGINE_MASK;
+            } else if(i + 1 < *argc && strcmp(argv[i + 1], "program") == 0) {
+               options->settings.engine = ENGINE_PROGRAM;
+            } else if(i + 1 < *argc && strcmp(argv[i + 1], "linear") == 0) {
+               options->settings.engine = ENGINE_LINEAR;
+            } else if(i + 1 < *argc && strcmp(argv[i + 1], "meet") == 0) {
+               options->settings.engine = ENGINE_MEET;
+            } else {
+               printf("-engine must be followed by scan, mask, program, linear or meet.\n");
+               return(0);
+            }
+         } else {
+            i++;
+            continue;
+         }
+
+         // Remove the option and its value.
+
+         for(j = i; j + used <= *argc; j++) {
+            argv[j] = argv[j + used];
+         }
+         *argc -= used;
+      }
+      return(1);
    }
 
 
@@ -1389,7 +8611,6 @@ char **read_words(
       int  *error
    )
    {
-      char        ch;
       char       *ch_p;
       const int   chunk_size = 20;
       int         curr_word_index = 0;
@@ -1418,7 +8639,7 @@ char **read_words(
          // the next character should be the newline.  Exit if there
          // was a problem.
 
-         if(strlen(in_string) >= MAX_LEN) {
+         if(count_characters(in_string) >= MAX_LEN) {
             printf("String was too long.  Limit is %d characters.\n", MAX_LEN);
             exit(1);
          }
@@ -1438,11 +8659,11 @@ char **read_words(
          }
 
          // Make sure there's room for the string.  If not,
-         // allocate a new array somewhat bigger and copy the
-         // old one over.  Do the same for the lengths array.
+         // allocate a new array twice as big and copy the
+         // old one over.
 
          if(curr_word_index == word_array_size) {
-            word_array_size += chunk_size;
+            word_array_size *= 2;
             word_transfer = new char*[word_array_size];
             for(i = 0; i < curr_word_index; i++) {
                word_transfer[i] = words[i];
@@ -1480,13 +8701,133 @@ char **read_words(
    }
 
 
+// Programs that use the functions above, like the benchmark in
+// csolver_bench.cxx, include this file with CSOLVER_NO_MAIN defined.
+
+#ifndef CSOLVER_NO_MAIN
+
+
+int solve_product_command(
+      int                 word_count,
+      char              **words,     // The multiplicand, multiplier, any
+                                     //    partial products and the product,
+                                     //    or the radicand and root.
+      int                 root,      // 1 for a square root.
+      const run_options  *options
+   )
+   // Solve a multiplication or square root given on the command line in
+   // base 10 and print the solutions.  Returns 0 if the words aren't
+   // good.
+   {
+      search_counters  counters;
+      int              difficulty;
+      int              i;
+      int              length;
+      char            *multiplicand;
+      char            *multiplier;
+      int              partial_count;
+      char            *product;
+      int              solutions;
+
+
+      if(root ? (word_count != 2) : (word_count < 3)) {
+         if(root) {
+            printf("-root takes the radicand and the root.\n");
+         } else {
+            printf("-multiply takes the multiplicand, the multiplier, the partial\n");
+            printf("products if they are wanted and the product.\n");
+         }
+         return(0);
+      }
+      for(i = 0; i < word_count; i++) {
+         if(!upcase_and_check_legality(words[i], &length)) {
+            return(0);
+         }
+      }
+      if(root) {
+         multiplicand = words[1];
+         multiplier = words[1];
+         product = words[0];
+         partial_count = 0;
+      } else {
+         multiplicand = words[0];
+         multiplier = words[1];
+         product = words[word_count - 1];
+         partial_count = word_count - 3;
+         if(partial_count != 0 && partial_count != (int) strlen(multiplier)) {
+            printf("There must be a partial product for each letter of the multiplier.\n");
+            return(0);
+         }
+      }
+
+      solutions = solve_product(multiplicand, multiplier, product,
+                                &words[2], partial_count, 10, 1,
+                                options->unique ? 2 : 0, NULL, &counters,
+                                &difficulty);
+      if(options->unique) {
+         print_solution_count(min_of_two(solutions, SOLUTIONS_AMBIGUOUS));
+      }
+      if(DIFF_PRINT) {
+         printf("Difficulty: %d\n", difficulty);
+      }
+      if(options->stats) {
+         print_product_stats(multiplicand, multiplier, product, 10,
+                             solutions, &counters);
+      }
+      return(1);
+   }
+
+
+int solve_system_command(
+      int                 relation_count,
+      char              **relations,
+      const run_options  *options
+   )
+   // Solve a system of relations given on the command line in base 10
+   // and print the solutions.  Returns 0 if the relations aren't good.
+   {
+      search_counters  counters;
+      int              difficulty;
+      const char      *error;
+      int              i;
+      system_layout    layout;
+      int              solutions;
+
+
+      error = lay_out_system(&layout, relations, relation_count, 10,
+                             options->single_zero, &run_letters);
+      if(error != NULL) {
+         printf("%s\n", error);
+         return(0);
+      }
+      solutions = solve_system(&layout, 1, options->unique ? 2 : 0, NULL,
+                               &counters, &difficulty);
+      if(options->unique) {
+         print_solution_count(min_of_two(solutions, SOLUTIONS_AMBIGUOUS));
+      }
+      if(DIFF_PRINT) {
+         printf("Difficulty: %d\n", difficulty);
+      }
+      if(options->stats) {
+         printf("{\"puzzle\": \"");
+         for(i = 0; i < relation_count; i++) {
+            printf((i == 0) ? "%s" : "; %s", relations[i]);
+         }
+         printf("\", \"base\": 10, \"solutions\": %d, ", solutions);
+         print_counters(&counters, 0);
+         printf("}\n");
+      }
+      return(1);
+   }
+
+
 int main(int argc, char *argv[])
    {
       int           bad_input;
       int           base = 10;
+      cache_stats   cache_counts;
       char          ch;
-      int           curr_summand_index;
-      int           curr_word_index;
+      search_counters counters;
       int           difficulty;
       int           disallow_rep;
       long          elapsed_time;
@@ -1496,25 +8837,37 @@ int main(int argc, char *argv[])
       int           first_sum_only;
       int           i;
       char          in_string[200];
-      int           j;
       int           last_char_ind;
       int           longest_summand;
       int           longest_word;
       int           max_summands;
       int           min_summands;
-      unsigned int  number_found;
+      unsigned int  number_found = 0;
+      run_options   options;
+      int           result;
       long          start_time;
       char         *sum;
       int           sum_length;
       int           summand_count;
       int          *summand_lengths;
       char        **summands;
+      int           solutions;
       unsigned int  total_searched;
+      solve_witnesses witnesses;
       int           word_count;
+      word_list     word_file_list;
       int          *word_lengths;
       char        **words;
 
 
+      // Pull out the options first so the rest of the arguments are
+      // in the same places whether they were given or not.
+
+      if(!parse_options(&argc, argv, &options)) {
+         return(1);
+      }
+      fold_accents = options.fold_accents;
+
       // If no arguments are given, or usage is requested,
       // print usage info and exit.
 
@@ -1524,6 +8877,32 @@ int main(int argc, char *argv[])
          return(0);
       }
 
+      // See if we are to solve puzzles given as lines of JSON.
+
+      if(strcmp(argv[1], "-batch") == 0) {
+         if(argc > 3) {
+            printf("-batch takes at most the name of one file.\n");
+            return(1);
+         }
+         return(!solve_batch((argc == 3) ? argv[2] : NULL, &options.settings,
+                             options.thread_count, options.ordered,
+                             options.stats));
+      }
+
+      // See if we are to solve a multiplication or a square root.
+
+      if(strcmp(argv[1], "-multiply") == 0 || strcmp(argv[1], "-root") == 0) {
+         return(!solve_product_command(argc - 2, &argv[2],
+                                       strcmp(argv[1], "-root") == 0,
+                                       &options));
+      }
+
+      // See if we are to solve a system of relations.
+
+      if(strcmp(argv[1], "-system") == 0) {
+         return(!solve_system_command(argc - 2, &argv[2], &options));
+      }
+
       // See if we are to solve a puzzle.
 
       if(strcmp(argv[1], "-solve") == 0) {
@@ -1561,11 +8940,31 @@ int main(int argc, char *argv[])
             // unless there were errors in the input.
 
             if(!bad_input) {
-               solve(summands, summand_count, summand_lengths,
-                     longest_summand, sum, base, 1, 0, &difficulty);
+               if(options.unique) {
+                  result = solve_unique(summands, summand_count,
+                                 summand_lengths, longest_summand, sum, base,
+                                 &options.settings, NULL, &witnesses,
+                                 &counters, &difficulty);
+                  print_unique(&witnesses, result);
+                  solutions = witnesses.count;
+               } else if(options.thread_count > 1) {
+                  solutions = solve_parallel(summands, summand_count,
+                                 summand_lengths, longest_summand, sum, base,
+                                 1, &options.settings, options.thread_count,
+                                 &counters, &difficulty);
+               } else {
+                  solutions = solve(summands, summand_count, summand_lengths,
+                                 longest_summand, sum, base, 1, 0,
+                                 &options.settings, NULL, &counters,
+                                 &difficulty);
+               }
                if(DIFF_PRINT) {
                   printf("Difficulty: %d\n", difficulty);
                }
+               if(options.stats) {
+                  print_solve_stats(summands, summand_count, sum, base,
+                                    solutions, &counters);
+               }
             }
 
             // Free the two allocated arrays and leave.
@@ -1581,10 +8980,10 @@ int main(int argc, char *argv[])
             // Get the base to solve the puzzle in.
 
             do {
-               printf("Input the base to solve the puzzle in (2 to 16).\n");
+               printf("Input the base to solve the puzzle in (2 to %d).\n", MAX_BASE);
                scanf("%d", &base);
                getchar();
-            } while(base < 2 || base > 16);
+            } while(base < 2 || base > MAX_BASE);
 
             // Get the summands.
 
@@ -1605,7 +9004,7 @@ int main(int argc, char *argv[])
                if(in_string[last_char_ind] == '\n') {
                   in_string[last_char_ind] = '\0';
                }
-               if(strlen(in_string) >= MAX_LEN) {
+               if(count_characters(in_string) >= MAX_LEN) {
                   printf("Sum string was too long.\n");
                   error = 1;
                }
@@ -1618,11 +9017,32 @@ int main(int argc, char *argv[])
 
                   // Call the routine to look for solutions and print them.
 
-                  solve(summands, summand_count, summand_lengths,
-                        longest_summand, sum, base, 1, 0, &difficulty);
+                  if(options.unique) {
+                     result = solve_unique(summands, summand_count,
+                                    summand_lengths, longest_summand, sum,
+                                    base, &options.settings, NULL,
+                                    &witnesses, &counters, &difficulty);
+                     print_unique(&witnesses, result);
+                     solutions = witnesses.count;
+                  } else if(options.thread_count > 1) {
+                     solutions = solve_parallel(summands, summand_count,
+                                    summand_lengths, longest_summand, sum,
+                                    base, 1, &options.settings,
+                                    options.thread_count, &counters,
+                                    &difficulty);
+                  } else {
+                     solutions = solve(summands, summand_count,
+                                    summand_lengths, longest_summand, sum,
+                                    base, 1, 0, &options.settings, NULL,
+                                    &counters, &difficulty);
+                  }
                   if(DIFF_PRINT) {
                      printf("Difficulty: %d\n", difficulty);
                   }
+                  if(options.stats) {
+                     print_solve_stats(summands, summand_count, sum, base,
+                                       solutions, &counters);
+                  }
                }
             }
 
@@ -1641,6 +9061,11 @@ int main(int argc, char *argv[])
 
       if(strcmp(argv[1], "-find") == 0) {
 
+         if(options.word_file != NULL && argc > 2) {
+            printf("Give the words either on the command line or with -wordfile.\n");
+            return(1);
+         }
+
          // See if they put the words on the command line.
 
          if(argc >= 4) {
@@ -1673,8 +9098,10 @@ int main(int argc, char *argv[])
                // summands.
 
                number_found = look_for_puzzles(words, word_count, word_lengths,
-                                base, 2, word_count - 1, 1, 0, 0,
-                                &total_searched);
+                                base, 2, word_count - 1, 1, 0, 0, 1,
+                                &options.settings, options.thread_count,
+                                options.cache_entries, &cache_counts,
+                                &counters, &total_searched);
             }
 
             delete [] word_lengths;
@@ -1688,10 +9115,10 @@ int main(int argc, char *argv[])
             // number of summands.
 
             do {
-               printf("Input the base to solve the puzzle in (2 to 16).\n");
+               printf("Input the base to solve the puzzle in (2 to %d).\n", MAX_BASE);
                scanf("%d", &base);
                getchar();
-            } while(base < 2 || base > 16);
+            } while(base < 2 || base > MAX_BASE);
 
             printf("Input the minimum number of summands.\n");
             scanf("%d", &min_summands);
@@ -1728,11 +9155,27 @@ int main(int argc, char *argv[])
                first_sum_only = 0;
             }
 
-            // Get the words to search for valid puzzles with.
-
-            printf("Input words one per line.  Press return when done.\n");
-            words = read_words(&word_count, &longest_word,
-                               &word_lengths, &error);
+            // Get the words to search for valid puzzles with, from the
+            // word file if there is one.
+
+            if(options.word_file != NULL) {
+               error = !read_word_file(options.word_file, &options.filter,
+                                       &word_file_list);
+               words = word_file_list.words;
+               word_count = word_file_list.count;
+               word_lengths = word_file_list.lengths;
+               longest_word = word_file_list.longest;
+               if(!error) {
+                  printf("Read %d words from %s.  Left out %d lines with other characters\n",
+                         word_count, options.word_file, word_file_list.bad);
+                  printf("and %d that were filtered out or repeated.\n",
+                         word_file_list.left_out);
+               }
+            } else {
+               printf("Input words one per line.  Press return when done.\n");
+               words = read_words(&word_count, &longest_word,
+                                  &word_lengths, &error);
+            }
 
             // If there wasn't an error, then go ahead and look for puzzles.
 
@@ -1746,17 +9189,24 @@ int main(int argc, char *argv[])
 
                number_found = look_for_puzzles(words, word_count, word_lengths,
                                 base, min_summands, max_summands, exactly_one,
-                                disallow_rep, first_sum_only, &total_searched);
+                                disallow_rep, first_sum_only, 1,
+                                &options.settings, options.thread_count,
+                                options.cache_entries, &cache_counts,
+                                &counters, &total_searched);
 
             }
 
             // Free allocated memory.
 
-            for(i = 0; i < word_count; i++) {
-               delete [] words[i];
+            if(options.word_file != NULL) {
+               free_word_list(&word_file_list);
+            } else {
+               for(i = 0; i < word_count; i++) {
+                  delete [] words[i];
+               }
+               delete [] word_lengths;
+               delete [] words;
             }
-            delete [] word_lengths;
-            delete [] words;
          }
 
          if(!error) {
@@ -1767,8 +9217,45 @@ int main(int argc, char *argv[])
             elapsed_time = end_time - start_time;
             printf("Elapsed time was %ld seconds.\n", elapsed_time);
             printf("Found %d good puzzles after searching %d\n", number_found, total_searched);
+            if(counters.stopped_early) {
+               printf("Stopped %lu searches at the second solution instead of finding them all.\n",
+                      counters.stopped_early);
+               if(counters.sampled_stops >= MIN_STOP_SAMPLES) {
+                  printf("That saved about %.0f backtracks, from %lu of them searched in full.\n",
+                         (double) counters.sampled_saved * counters.stopped_early /
+                                                      counters.sampled_stops,
+                         counters.sampled_stops);
+               } else {
+                  printf("Too few of them were searched in full (%lu) to say how many backtracks that saved.\n",
+                         counters.sampled_stops);
+               }
+            }
+            if(cache_counts.entries) {
+               printf("Cache hit %lu of %lu lookups (%.1f%%), replaced %lu entries.\n",
+                      cache_counts.hits, cache_counts.lookups,
+                      cache_counts.lookups ?
+                         100.0 * cache_counts.hits / cache_counts.lookups : 0.0,
+                      cache_counts.evictions);
+               printf("Cache held %lu puzzles in %lu KB per thread, in sets of %d\n",
+                      cache_counts.entries, cache_counts.bytes / 1024,
+                      CACHE_WAYS);
+               printf("with the least recently used replaced.\n");
+            }
+            if(options.stats) {
+               i = MAX_LEN;
+               while(i > 0 && counters.column_nodes[i - 1] == 0) {
+                  i--;
+               }
+               printf("{\"find\": {\"base\": %d, \"good_puzzles\": %u, "
+                      "\"puzzles_searched\": %u, ", base, number_found,
+                      total_searched);
+               print_counters(&counters, i);
+               printf("}}\n");
+            }
          }
       }
 
       return(error);
-   }
\ No newline at end of file
+   }
+
+#endif
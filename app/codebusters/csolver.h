@@ -0,0 +1,135 @@
+//
+// The alphametic solver in csolver.cxx as a library, for programs that
+// want to solve puzzles without running csolver and reading what it
+// prints.  It is built as libcsolver.a and libcsolver.so by the
+// Makefile in this directory.
+//
+// A puzzle is prepared once, which checks its words, numbers its
+// letters and lays it out in columns, and can then be solved as many
+// times as wanted.  Each solution found is given to a visitor function
+// rather than printed.  For example:
+//
+//     void show(void *context, int letter_count, const char *letters,
+//               const int *values)
+//        {
+//           ...
+//        }
+//
+//     const char      *summands[] = { "SEND", "MORE" };
+//     char             error[100];
+//     csolver_options  options;
+//     csolver_puzzle  *puzzle;
+//     csolver_result   result;
+//
+//     csolver_default_options(&options);
+//     puzzle = csolver_prepare(summands, 2, "MONEY", &options, error,
+//                              sizeof(error));
+//     csolver_solve(puzzle, NULL, show, NULL, &result);
+//     csolver_free(puzzle);
+//
+// A puzzle can only be solved on one thread at a time, but different
+// puzzles can be solved on different threads at once.  The functions
+// don't print anything.
+//
+// The interface is plain C so that it can be used from C and from
+// other languages.
+
+#ifndef CSOLVER_H
+#define CSOLVER_H
+
+#if defined(_WIN32)
+#define CSOLVER_API
+#else
+#define CSOLVER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The ways of searching.  These are the same as -engine.
+
+#define CSOLVER_ENGINE_SCAN     0   // Look for free digits one at a time.
+#define CSOLVER_ENGINE_MASK     1   // Keep the free digits in a bit mask.
+#define CSOLVER_ENGINE_PROGRAM  2   // Compile the puzzle into steps first.
+#define CSOLVER_ENGINE_LINEAR   3   // Solve the puzzle as one equation.
+#define CSOLVER_ENGINE_MEET     4   // The same with a meet in the middle table.
+
+#define CSOLVER_MAX_BASE 62
+#define CSOLVER_MAX_LEN  16
+
+// How to solve a puzzle.  Fill these in with csolver_default_options
+// first, so that options added later get their defaults.  base and
+// leading_zeros are used when the puzzle is prepared.  The others are
+// used when it is solved.
+
+typedef struct csolver_options {
+   int  base;            // The base, 2 to CSOLVER_MAX_BASE.  The default is 10.
+   int  leading_zeros;   // 1 to let a word start with a zero.  The default is 0.
+   int  stop_after;      // Stop after this many solutions.  0, the default, for all.
+   int  engine;          // A CSOLVER_ENGINE_ value.  The default is scan.
+   int  prune;           // 1 for the stronger pruning of -prune.
+   int  meet_memory;     // Megabytes for the meet in the middle table.
+} csolver_options;
+
+// What came of solving a puzzle.
+
+typedef struct csolver_result {
+   int            solutions;       // The number found.
+   int            stopped_early;   // 1 if the search stopped at stop_after.
+   int            difficulty;      // On a scale of 1 to 5.  0 if the
+                                   // words can't have a solution.
+   unsigned long  backtracks;
+} csolver_result;
+
+// Given each solution found, with the letters of the puzzle in
+// alphabetical order and the value of each.  The arrays are only good
+// until it returns.
+
+typedef void (*csolver_visitor)(void *context, int letter_count,
+                                const char *letters, const int *values);
+
+typedef struct csolver_puzzle csolver_puzzle;
+
+
+CSOLVER_API void csolver_default_options(
+      csolver_options  *options
+   );
+
+// Check the words of a puzzle and get it ready to be solved.  The
+// words are made of letters, in either case, and are no longer than
+// CSOLVER_MAX_LEN.  They are copied, so they don't have to be kept.
+// Returns NULL and puts a message in error if there is a problem.
+// error can be NULL.
+
+CSOLVER_API csolver_puzzle *csolver_prepare(
+      const char *const      *summands,
+      int                     summand_count,
+      const char             *sum,
+      const csolver_options  *options,       // NULL for the defaults.
+      char                   *error,
+      int                     error_size
+   );
+
+// Solve a prepared puzzle.  options can be NULL to use the ones it was
+// prepared with.  Their base and leading_zeros are not used.  visit can
+// be NULL if only the number of solutions is wanted.  result can be
+// NULL.  Returns the number of solutions found.
+
+CSOLVER_API int csolver_solve(
+      csolver_puzzle         *puzzle,
+      const csolver_options  *options,
+      csolver_visitor         visit,
+      void                   *context,       // Passed to visit.
+      csolver_result         *result
+   );
+
+CSOLVER_API void csolver_free(
+      csolver_puzzle  *puzzle
+   );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,446 @@
+//
+// This program times the alphametic solver in csolver.cxx on a fixed
+// corpus of puzzles, so that a change to solve or to the search for
+// puzzles can be accepted or rejected on numbers rather than on a
+// feeling.  It is built from the same source as the solver with the
+// solver's main left out.
+//
+// The corpus, csolver_bench.txt by default, has one case per line.
+// Blank lines and lines starting with # are skipped.
+//
+//     solve {case} {base} {solutions} {summands} sum
+//     find {case} {base} {min summands} {max summands} {exactly one}
+//          {no repeats} {first sum only} {good puzzles} {words}
+//     batch {case} {solutions} {a line of -batch JSON}
+//
+// A batch line is solved the way -batch solves it, and its solutions
+// are the number -batch reports, or -1 for an error.  Solve lines, and
+// batch lines, with the same case name are timed together.  A find
+// line is a case of its own, and it is run the way -find runs with
+// the same answers to its questions.  The solutions and good puzzles
+// are what the search should find.  If it finds anything else the
+// case is marked and the program returns 1.
+//
+// Each case is run over and over until it has taken at least the
+// time given with -time.  Each puzzle solved, or each find run, is
+// timed on its own.  For each case this prints:
+//
+//     puzzles     The puzzles solved, or searched in one find run.
+//     solutions   The solutions, or good puzzles, in one pass.
+//     backtracks  The backtracks in one pass.
+//     solves/s    Puzzles solved, or searched, per second.
+//     median, p99 The time for one solve, or one find run, in
+//                 microseconds.
+//
+// The solver's options, like -engine and -prune, are taken as well,
+// so the same binary can time each way of searching.  -threads is
+// used for find cases only.  With -stats, the search's counters for
+// each case are printed as a line of JSON after its line.
+//
+// Try csolver_bench -engine linear -time 2 -case base16
+
+#define CSOLVER_NO_MAIN
+#include "csolver.cxx"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+const char *DEFAULT_CORPUS = "csolver_bench.txt";
+const double DEFAULT_BENCH_TIME = 0.5;
+const int MIN_BENCH_ROUNDS = 3;
+const int MAX_CORPUS_LINE = 65536;
+const int MAX_CORPUS_WORDS = MAX_WORDS;
+
+// A puzzle to solve, or a list of words to look for puzzles in.
+
+struct bench_puzzle {
+   int     base;
+   int     expected;        // Solutions, or good puzzles for find.
+   int     word_count;      // Summands and the sum, or the find words.
+   char  **words;
+   int    *lengths;
+   int     longest;         // The longest summand.
+   int     find;            // 1 if this is a find case.
+   int     batch;           // 1 if the only word is a line of -batch JSON.
+   int     min_summands;
+   int     max_summands;
+   int     exactly_one;
+   int     disallow_rep;
+   int     first_sum_only;
+};
+
+// A named group of puzzles that are timed together.
+
+struct bench_case {
+   char                       *name;
+   std::vector<bench_puzzle>   puzzles;
+};
+
+
+double microseconds(
+      std::chrono::steady_clock::time_point  start,
+      std::chrono::steady_clock::time_point  end
+   )
+   {
+      return(std::chrono::duration<double, std::micro>(end - start).count());
+   }
+
+
+int read_corpus(
+      const char                *file_name,
+      std::vector<bench_case>   *cases
+   )
+   // Read the corpus into cases, keeping the order the cases first
+   // appear in.  Returns 0 after printing a message if the file can't
+   // be read or a line isn't right.
+   {
+      int            c;
+      FILE          *file;
+      int            i;
+      char          *line;
+      int            line_number = 0;
+      char          *name;
+      int            is_batch;
+      bench_puzzle   puzzle;
+      int            used;
+      char          *word;
+      int            word_count;
+      char          *words[MAX_CORPUS_WORDS + 8];
+
+
+      file = fopen(file_name, "r");
+      if(file == NULL) {
+         printf("Can't open the corpus %s.\n", file_name);
+         return(0);
+      }
+      line = new char[MAX_CORPUS_LINE];
+      while(fgets(line, MAX_CORPUS_LINE, file) != NULL) {
+         line_number++;
+
+         // Split the line into words.  The JSON of a batch line has
+         // spaces in it, so it is all one word.
+
+         is_batch = (strncmp(line, "batch", 5) == 0 &&
+                     (line[5] == ' ' || line[5] == '\t'));
+         word_count = 0;
+         for(word = strtok(line, " \t\r\n"); word != NULL;
+             word = strtok(NULL, (is_batch && word_count == 3) ? "\r\n"
+                                                              : " \t\r\n")) {
+            if(word_count == MAX_CORPUS_WORDS + 8) {
+               printf("%s:%d has too many words.\n", file_name, line_number);
+               return(0);
+            }
+            words[word_count++] = word;
+         }
+         if(word_count == 0 || words[0][0] == '#') {
+            continue;
+         }
+
+         // Get the numbers at the front of the line.
+
+         memset(&puzzle, 0, sizeof(puzzle));
+         if(strcmp(words[0], "solve") == 0 && word_count >= 6 &&
+               sscanf(words[2], "%d", &puzzle.base) == 1 &&
+               sscanf(words[3], "%d", &puzzle.expected) == 1) {
+            used = 4;
+         } else if(strcmp(words[0], "find") == 0 && word_count >= 11 &&
+               sscanf(words[2], "%d", &puzzle.base) == 1 &&
+               sscanf(words[3], "%d", &puzzle.min_summands) == 1 &&
+               sscanf(words[4], "%d", &puzzle.max_summands) == 1 &&
+               sscanf(words[5], "%d", &puzzle.exactly_one) == 1 &&
+               sscanf(words[6], "%d", &puzzle.disallow_rep) == 1 &&
+               sscanf(words[7], "%d", &puzzle.first_sum_only) == 1 &&
+               sscanf(words[8], "%d", &puzzle.expected) == 1) {
+            puzzle.find = 1;
+            used = 9;
+         } else if(is_batch && word_count == 4 &&
+               sscanf(words[2], "%d", &puzzle.expected) == 1) {
+            puzzle.batch = 1;
+            puzzle.base = 10;
+            used = 3;
+         } else {
+            printf("%s:%d isn't a solve, find or batch line.\n", file_name,
+                   line_number);
+            return(0);
+         }
+         if(puzzle.base < 2 || puzzle.base > MAX_BASE) {
+            printf("%s:%d has a base that isn't 2 to %d.\n", file_name,
+                   line_number, MAX_BASE);
+            return(0);
+         }
+
+         // Copy the words and check them.
+
+         puzzle.word_count = word_count - used;
+         puzzle.words = new char*[puzzle.word_count];
+         puzzle.lengths = new int[puzzle.word_count];
+         for(i = 0; i < puzzle.word_count; i++) {
+            puzzle.words[i] = new char[strlen(words[used + i]) + 1];
+            strcpy(puzzle.words[i], words[used + i]);
+            if(puzzle.batch) {
+               break;
+            }
+            if(strlen(puzzle.words[i]) >= (size_t) MAX_LEN ||
+                  !upcase_and_check_legality(puzzle.words[i],
+                                             &puzzle.lengths[i])) {
+               printf("%s:%d has a bad word.\n", file_name, line_number);
+               return(0);
+            }
+            if(i < puzzle.word_count - 1 && puzzle.lengths[i] > puzzle.longest) {
+               puzzle.longest = puzzle.lengths[i];
+            }
+         }
+
+         // Add it to its case.  Find lines are always cases of their
+         // own.
+
+         name = words[1];
+         for(c = 0; c < (int) cases->size(); c++) {
+            if(!puzzle.find && !(*cases)[c].puzzles[0].find &&
+                  (*cases)[c].puzzles[0].batch == puzzle.batch &&
+                  strcmp((*cases)[c].name, name) == 0) {
+               break;
+            }
+         }
+         if(c == (int) cases->size()) {
+            cases->push_back(bench_case());
+            cases->back().name = new char[strlen(name) + 1];
+            strcpy(cases->back().name, name);
+         }
+         (*cases)[c].puzzles.push_back(puzzle);
+      }
+      fclose(file);
+      delete [] line;
+      return(1);
+   }
+
+
+void free_corpus(
+      std::vector<bench_case>   *cases
+   )
+   // Free what read_corpus allocated.
+   {
+      int  c;
+      int  i;
+      int  p;
+
+
+      for(c = 0; c < (int) cases->size(); c++) {
+         for(p = 0; p < (int) (*cases)[c].puzzles.size(); p++) {
+            bench_puzzle *puzzle = &(*cases)[c].puzzles[p];
+            for(i = 0; i < puzzle->word_count; i++) {
+               delete [] puzzle->words[i];
+            }
+            delete [] puzzle->words;
+            delete [] puzzle->lengths;
+         }
+         delete [] (*cases)[c].name;
+      }
+      cases->clear();
+   }
+
+
+int run_batch_line(
+      const char       *line,
+      run_options      *options,
+      search_counters  *counters      // Return the search's backtracks here.
+   )
+   // Solve a line of JSON as -batch would and return the solutions in
+   // its result, or -1 if the result is an error.
+   {
+      batch_chunk     chunk;
+      const char     *found;
+      batch_scratch   scratch;
+      int             solutions = -1;
+      batch_totals    totals;
+
+
+      chunk.text = new char[strlen(line) + 1];
+      strcpy(chunk.text, line);
+      chunk.line_count = 1;
+      chunk.first_line = 1;
+      chunk.sequence = 0;
+      chunk.output.text = NULL;
+      chunk.output.length = 0;
+      chunk.output.size = 0;
+      chunk.output.visit = NULL;
+      totals.puzzles = 0;
+      totals.errors = 0;
+      totals.backtracks = 0;
+      init_batch_scratch(&scratch);
+      solve_batch_chunk(&chunk, &scratch, &options->settings, &totals);
+      found = strstr(chunk.output.text, "\"solutions\": ");
+      if(found != NULL && totals.errors == 0) {
+         solutions = atoi(found + 13);
+      }
+      clear_search_counters(counters);
+      counters->backtracks = totals.backtracks;
+      free_batch_scratch(&scratch);
+      delete [] chunk.output.text;
+      delete [] chunk.text;
+      return(solutions);
+   }
+
+
+int run_puzzle(
+      bench_puzzle          *puzzle,
+      run_options           *options,
+      solve_arena           *arena,
+      search_counters       *counters,     // Return the search's counters here.
+      unsigned int          *searched      // Return the puzzles searched.
+   )
+   // Solve a puzzle, or look for puzzles among its words, without
+   // printing anything.  Returns the number of solutions or good
+   // puzzles.
+   {
+      int           difficulty;
+      cache_stats   stats;
+
+
+      if(puzzle->find) {
+         return(look_for_puzzles(puzzle->words, puzzle->word_count,
+                   puzzle->lengths, puzzle->base, puzzle->min_summands,
+                   puzzle->max_summands, puzzle->exactly_one,
+                   puzzle->disallow_rep, puzzle->first_sum_only, 0,
+                   &options->settings, options->thread_count,
+                   options->cache_entries, &stats, counters, searched));
+      }
+      *searched = 1;
+      if(puzzle->batch) {
+         return(run_batch_line(puzzle->words[0], options, counters));
+      }
+      return(solve_part(puzzle->words, puzzle->word_count - 1,
+                        puzzle->lengths, puzzle->longest,
+                        puzzle->words[puzzle->word_count - 1], puzzle->base,
+                        0, 0, &options->settings, NULL, 0, NULL, NULL, arena,
+                        counters, &difficulty));
+   }
+
+
+int run_case(
+      bench_case    *bench,
+      run_options   *options,
+      solve_arena   *arena,
+      double         min_time     // Seconds to keep running the case.
+   )
+   // Time a case and print a line for it.  Returns 0 if a puzzle
+   // didn't come out the way the corpus says it should.
+   {
+      search_counters                         case_counters;
+      int                                     case_solutions = 0;
+      int                                     column_count;
+      search_counters                         counters;
+      std::chrono::steady_clock::time_point   end;
+      int                                     good = 1;
+      int                                     p;
+      int                                     rounds = 0;
+      std::vector<double>                     samples;
+      unsigned int                            searched;
+      unsigned int                            case_searched = 0;
+      int                                     solutions;
+      std::chrono::steady_clock::time_point   start;
+      double                                  total_time = 0.0;
+      double                                  took;
+
+
+      // The first round is also checked against the corpus.  The ones
+      // after it should come out the same.
+
+      clear_search_counters(&case_counters);
+      while(rounds < MIN_BENCH_ROUNDS || total_time < min_time * 1.0e6) {
+         for(p = 0; p < (int) bench->puzzles.size(); p++) {
+            start = std::chrono::steady_clock::now();
+            solutions = run_puzzle(&bench->puzzles[p], options, arena,
+                                   &counters, &searched);
+            end = std::chrono::steady_clock::now();
+            took = microseconds(start, end);
+            samples.push_back(took);
+            total_time += took;
+            if(rounds == 0) {
+               case_solutions += max_of_two(solutions, 0);
+               add_search_counters(&case_counters, &counters);
+               case_searched += searched;
+               if(solutions != bench->puzzles[p].expected) {
+                  good = 0;
+               }
+            }
+         }
+         rounds++;
+      }
+      std::sort(samples.begin(), samples.end());
+
+      printf("%-12s %9u %10d %12lu %11.0f %11.1f %11.1f%s\n", bench->name,
+             case_searched, case_solutions, case_counters.backtracks,
+             (double) case_searched * rounds / (total_time / 1.0e6),
+             samples[samples.size() / 2],
+             samples[(samples.size() * 99) / 100],
+             good ? "" : "  WRONG COUNT");
+      if(options->stats) {
+         column_count = MAX_LEN;
+         while(column_count > 0 &&
+               case_counters.column_nodes[column_count - 1] == 0) {
+            column_count--;
+         }
+         printf("{\"case\": \"%s\", ", bench->name);
+         print_counters(&case_counters, column_count);
+         printf("}\n");
+      }
+      return(good);
+   }
+
+
+int main(int argc, char *argv[])
+   {
+      solve_arena               arena;
+      std::vector<bench_case>   cases;
+      int                       c;
+      const char               *case_name = NULL;
+      const char               *corpus = DEFAULT_CORPUS;
+      int                       good = 1;
+      int                       i;
+      double                    min_time = DEFAULT_BENCH_TIME;
+      run_options               options;
+
+
+      // Take the solver's options out first, then the benchmark's.
+
+      if(!parse_options(&argc, argv, &options)) {
+         return(1);
+      }
+      for(i = 1; i < argc; i++) {
+         if(strcmp(argv[i], "-time") == 0 && i + 1 < argc &&
+               sscanf(argv[i + 1], "%lf", &min_time) == 1) {
+            i++;
+         } else if(strcmp(argv[i], "-case") == 0 && i + 1 < argc) {
+            case_name = argv[++i];
+         } else if(argv[i][0] != '-') {
+            corpus = argv[i];
+         } else {
+            printf("Usage: csolver_bench [solver options] [-time SECONDS] [-case NAME] [corpus]\n");
+            return(1);
+         }
+      }
+      if(!read_corpus(corpus, &cases)) {
+         return(1);
+      }
+
+      // Run the cases.  -case picks the ones whose names start with
+      // the name given.
+
+      init_arena(&arena);
+      printf("%-12s %9s %10s %12s %11s %11s %11s\n", "case", "puzzles",
+             "solutions", "backtracks", "solves/s", "median us", "p99 us");
+      for(c = 0; c < (int) cases.size(); c++) {
+         if(case_name != NULL &&
+               strncmp(cases[c].name, case_name, strlen(case_name)) != 0) {
+            continue;
+         }
+         if(!run_case(&cases[c], &options, &arena, min_time)) {
+            good = 0;
+         }
+      }
+      free_arena(&arena);
+      free_corpus(&cases);
+      return(!good);
+   }
@@ -0,0 +1,243 @@
+//
+// The library interface to the alphametic solver described in
+// csolver.h.  It is built from the same source as the solver with the
+// solver's main left out, like the benchmark in csolver_bench.cxx.
+// A prepared puzzle keeps its layout and its own scratch memory, so
+// solving it again doesn't lay it out again or allocate anything.
+
+#define CSOLVER_NO_MAIN
+#include "csolver.cxx"
+#include "csolver.h"
+
+#include <stdarg.h>
+
+struct csolver_puzzle {
+   csolver_options  options;     // The options it was prepared with.
+   puzzle_layout    layout;
+   int              possible;    // 0 if it can't have a solution.
+   solve_arena      arena;
+};
+
+
+void set_error(
+      char        *error,        // Where to put the message.  Can be NULL.
+      int          error_size,
+      const char  *format,
+      ...
+   )
+   {
+      va_list  args;
+
+
+      if(error && error_size > 0) {
+         va_start(args, format);
+         vsnprintf(error, error_size, format, args);
+         va_end(args);
+      }
+   }
+
+
+int copy_word(
+      const char  *word,
+      char        *copy,         // Room for MAX_LEN letters and a null.
+      char        *error,
+      int          error_size
+   )
+   // Copy a word, upcasing it.  Returns its length, or 0 after putting
+   // a message in error if it is empty, too long or has something
+   // other than letters in it.
+   {
+      int  length;
+
+
+      for(length = 0; word[length]; length++) {
+         if(length == MAX_LEN) {
+            set_error(error, error_size,
+                      "Words can't be longer than %d letters.  %s is too long.",
+                      MAX_LEN, word);
+            return(0);
+         }
+         if(!(word[length] >= 'a' && word[length] <= 'z') &&
+               !(word[length] >= 'A' && word[length] <= 'Z')) {
+            set_error(error, error_size,
+                      "Words must contain only letters.  Problem with: %s",
+                      word);
+            return(0);
+         }
+         copy[length] = toupper(word[length]);
+      }
+      copy[length] = '\0';
+      if(length == 0) {
+         set_error(error, error_size, "Words can't be empty.");
+      }
+      return(length);
+   }
+
+
+void csolver_default_options(
+      csolver_options  *options
+   )
+   {
+      options->base = 10;
+      options->leading_zeros = 0;
+      options->stop_after = 0;
+      options->engine = CSOLVER_ENGINE_SCAN;
+      options->prune = 0;
+      options->meet_memory = DEFAULT_MEET_MEMORY;
+   }
+
+
+csolver_puzzle *csolver_prepare(
+      const char *const      *summands,
+      int                     summand_count,
+      const char             *sum,
+      const csolver_options  *options,
+      char                   *error,
+      int                     error_size
+   )
+   {
+      char            *copies;
+      int              i;
+      int             *lengths;
+      csolver_options  local_options;
+      char            *smnd_ptrs[MAX_STATIC_SUMMANDS];
+      char           **words;
+      csolver_puzzle  *puzzle;
+
+
+      if(!options) {
+         csolver_default_options(&local_options);
+         options = &local_options;
+      }
+      if(options->base < 2 || options->base > MAX_BASE) {
+         set_error(error, error_size, "The base must be from 2 to %d.",
+                   MAX_BASE);
+         return(NULL);
+      }
+      if(options->engine < ENGINE_SCAN || options->engine > ENGINE_MEET) {
+         set_error(error, error_size, "There is no engine %d.",
+                   options->engine);
+         return(NULL);
+      }
+      if(summand_count < 1) {
+         set_error(error, error_size, "A puzzle needs at least one summand.");
+         return(NULL);
+      }
+
+      // Copy and check the words.  The sum goes after the summands.
+
+      copies = new char[(summand_count + 1) * (MAX_LEN + 1)];
+      lengths = new int[summand_count + 1];
+      words = (summand_count + 1 <= MAX_STATIC_SUMMANDS) ? smnd_ptrs
+                                       : new char*[summand_count + 1];
+      for(i = 0; i <= summand_count; i++) {
+         words[i] = &copies[i * (MAX_LEN + 1)];
+         lengths[i] = copy_word((i < summand_count) ? summands[i] : sum,
+                                words[i], error, error_size);
+         if(!lengths[i]) {
+            break;
+         }
+      }
+
+      puzzle = NULL;
+      if(i > summand_count) {
+         puzzle = new csolver_puzzle;
+         puzzle->options = *options;
+         init_arena(&puzzle->arena);
+         puzzle->layout.smnds = new char[MAX_LEN * summand_count];
+
+         // A summand longer than the sum would have to start with a
+         // zero.  The layout can't hold one, so when that is allowed
+         // the puzzle isn't taken.
+
+         puzzle->possible = 1;
+         for(i = 0; i < summand_count; i++) {
+            if(lengths[i] > lengths[summand_count]) {
+               puzzle->possible = 0;
+            }
+         }
+         if(!puzzle->possible && options->leading_zeros) {
+            set_error(error, error_size,
+                      "With leading zeros, summands can't be longer than the sum.");
+            csolver_free(puzzle);
+            puzzle = NULL;
+         } else if(puzzle->possible) {
+            puzzle->possible = lay_out_puzzle(&puzzle->layout, words,
+                                  summand_count, lengths,
+                                  words[summand_count], options->base);
+            if(options->leading_zeros) {
+               memset(puzzle->layout.leading, 0,
+                      sizeof(puzzle->layout.leading));
+            }
+         }
+      }
+
+      if(words != smnd_ptrs) {
+         delete [] words;
+      }
+      delete [] lengths;
+      delete [] copies;
+      return(puzzle);
+   }
+
+
+int csolver_solve(
+      csolver_puzzle         *puzzle,
+      const csolver_options  *options,
+      csolver_visitor         visit,
+      void                   *context,
+      csolver_result         *result
+   )
+   {
+      search_counters  counters;
+      int              difficulty;
+      output_buffer    output;
+      solve_settings   settings;
+      int              solutions;
+
+
+      if(!options) {
+         options = &puzzle->options;
+      }
+      settings.engine = options->engine;
+      settings.specialize = 1;
+      settings.prune = options->prune;
+      settings.meet_memory = options->meet_memory;
+
+      output.text = NULL;
+      output.length = 0;
+      output.size = 0;
+      output.visit = visit;
+      output.context = context;
+
+      if(puzzle->possible) {
+         solutions = solve_layout(&puzzle->layout, visit != NULL,
+                                  max_of_two(options->stop_after, 0),
+                                  &settings, &output, &puzzle->arena,
+                                  &counters, &difficulty);
+      } else {
+         solutions = 0;
+         clear_search_counters(&counters);
+         difficulty = 0;
+      }
+
+      if(result) {
+         result->solutions = solutions;
+         result->stopped_early = (int) counters.stopped_early;
+         result->difficulty = difficulty;
+         result->backtracks = counters.backtracks;
+      }
+      return(solutions);
+   }
+
+
+void csolver_free(
+      csolver_puzzle  *puzzle
+   )
+   {
+      if(puzzle) {
+         delete [] puzzle->layout.smnds;
+         free_arena(&puzzle->arena);
+         delete puzzle;
+      }
+   }
@@ -0,0 +1,124 @@
+//
+// The entry point of the WebAssembly build of the solver, which the
+// binding in app/common/csolverwasm.ts calls.  Calling back into
+// JavaScript for each solution would need a function table and is
+// slow, so this prepares and solves a puzzle in one call and keeps the
+// last solution found in a report that the binding reads out of the
+// module's memory.  The binding knows the report's layout, so change
+// the two together.
+//
+// It is built with csolver_lib.cxx by "make wasm", which needs
+// Emscripten.
+
+#include <stddef.h>
+#include <string.h>
+#include "csolver.h"
+
+const int REPORT_ERROR_SIZE = 100;
+
+struct csolver_report {
+   int           solutions;
+   int           stopped_early;
+   int           difficulty;
+   unsigned int  backtracks;
+   int           letter_count;                 // In the last solution.
+   int           letters[CSOLVER_MAX_BASE];
+   int           values[CSOLVER_MAX_BASE];
+   char          error[REPORT_ERROR_SIZE];     // Why it returned -1.
+};
+
+// The binding reads the report as 32 bit words at these places.
+
+static_assert(offsetof(csolver_report, difficulty) == 2 * 4 &&
+              offsetof(csolver_report, backtracks) == 3 * 4 &&
+              offsetof(csolver_report, letter_count) == 4 * 4 &&
+              offsetof(csolver_report, letters) == 5 * 4 &&
+              offsetof(csolver_report, values) == (5 + CSOLVER_MAX_BASE) * 4 &&
+              offsetof(csolver_report, error) == (5 + 2 * CSOLVER_MAX_BASE) * 4,
+              "csolver_report doesn't match REPORT_ in csolverwasm.ts");
+
+
+void keep_last_solution(
+      void        *context,      // The report.
+      int          letter_count,
+      const char  *letters,
+      const int   *values
+   )
+   // The visitor.  Each solution replaces the one before.
+   {
+      int              i;
+      csolver_report  *report = (csolver_report *) context;
+
+
+      report->letter_count = letter_count;
+      for(i = 0; i < letter_count; i++) {
+         report->letters[i] = letters[i];
+         report->values[i] = values[i];
+      }
+   }
+
+
+extern "C" CSOLVER_API int csolver_sum_search(
+      char            *words,       // The summands then the sum, split by spaces.
+      int              base,        // The base to solve the puzzle in.
+      int              stop_after,  // Stop after this many solutions.  0 for all.
+      int              engine,      // A CSOLVER_ENGINE_ value.
+      csolver_report  *report       // Where to put what was found.
+   )
+   // Solve a puzzle given as one string.  The spaces in words are
+   // replaced with nulls.  Returns the number of solutions, or -1 with
+   // a message in the report's error if the puzzle can't be taken.
+   {
+      int               count;
+      int               i;
+      int               length;
+      csolver_options   options;
+      csolver_puzzle   *puzzle;
+      csolver_result    result;
+      const char      **summands;
+
+
+      memset(report, 0, sizeof(*report));
+
+      // Split the words and count them.  The last one is the sum.
+
+      length = strlen(words);
+      count = 0;
+      for(i = 0; i < length; i++) {
+         if(words[i] == ' ') {
+            words[i] = '\0';
+         } else if(i == 0 || words[i - 1] == '\0') {
+            count++;
+         }
+      }
+      if(count < 2) {
+         strcpy(report->error, "A puzzle needs a summand and a sum.");
+         return(-1);
+      }
+      summands = new const char*[count];
+      count = 0;
+      for(i = 0; i < length; i++) {
+         if(words[i] != '\0' && (i == 0 || words[i - 1] == '\0')) {
+            summands[count++] = &words[i];
+         }
+      }
+
+      csolver_default_options(&options);
+      options.base = base;
+      options.stop_after = stop_after;
+      options.engine = engine;
+      puzzle = csolver_prepare(summands, count - 1, summands[count - 1],
+                               &options, report->error, REPORT_ERROR_SIZE);
+      delete [] summands;
+      if(!puzzle) {
+         return(-1);
+      }
+      csolver_solve(puzzle, NULL, keep_last_solution, report, &result);
+      csolver_free(puzzle);
+
+      report->solutions = result.solutions;
+      report->stopped_early = result.stopped_early;
+      report->difficulty = result.difficulty;
+      report->backtracks = (unsigned int) result.backtracks;
+      return(result.solutions);
+   }
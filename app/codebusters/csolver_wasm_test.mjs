@@ -0,0 +1,172 @@
+//
+// Checks the WebAssembly build of the solver against the TypeScript one
+// in app/common/cryptarithm.ts, then times the two on the same puzzles.
+// It runs under Node with nothing but the packages from npm install, so
+// it can be run headless:
+//
+//     make wasm-test
+//     node csolver_wasm_test.mjs [-time seconds] [-case name] [corpus]
+//
+// The puzzles are the solve lines of the benchmark corpus,
+// csolver_bench.txt by default.  See csolver_bench.cxx for the format.
+// Each puzzle is solved by both engines, and the number of solutions,
+// the difficulty and the mapping returned have to be the same and the
+// number of solutions has to be the one in the corpus.  Each is solved
+// again with just_one set.  Anything different is printed and the
+// program exits with 1.
+//
+// Then each case is run over and over by each engine until it has taken
+// at least the time given with -time, one second by default.  For each
+// case and engine this prints the puzzles, the solves per second and the
+// median time of one solve in microseconds.
+
+import { mkdtempSync, readFileSync, rmSync, writeFileSync } from 'fs';
+import { createRequire } from 'module';
+import { tmpdir } from 'os';
+import path from 'path';
+import { fileURLToPath, pathToFileURL } from 'url';
+
+const here = path.dirname(fileURLToPath(import.meta.url));
+const require = createRequire(import.meta.url);
+
+// The app's TypeScript is compiled by webpack, so compile the files the
+// solver needs into a scratch directory with the typescript package and
+// import them from there.
+
+async function loadSolvers() {
+    const ts = require('typescript');
+    const dir = mkdtempSync(path.join(tmpdir(), 'csolver-'));
+    try {
+        for (const name of ['ciphercommon', 'cryptarithm', 'csolverwasm']) {
+            const source = readFileSync(path.join(here, '..', 'common', name + '.ts'), 'utf8');
+            const js = ts.transpileModule(source, {
+                compilerOptions: {
+                    module: ts.ModuleKind.ESNext,
+                    target: ts.ScriptTarget.ES2020,
+                },
+            }).outputText;
+            writeFileSync(
+                path.join(dir, name + '.mjs'),
+                js.replace(/from '(?:\.\.\/common|\.)\/(\w+)'/g, "from './$1.mjs'")
+            );
+        }
+        const cryptarithm = await import(pathToFileURL(path.join(dir, 'cryptarithm.mjs')));
+        const wasm = await import(pathToFileURL(path.join(dir, 'csolverwasm.mjs')));
+        const factory = await import(pathToFileURL(path.join(here, 'csolver_wasm.mjs')));
+        wasm.setCsolverWasmModule(await factory.default());
+        return { cryptarithm, wasm };
+    } finally {
+        rmSync(dir, { recursive: true, force: true });
+    }
+}
+
+function readCorpus(file, onlyCase) {
+    const puzzles = [];
+    for (const line of readFileSync(file, 'utf8').split('\n')) {
+        const fields = line.trim().split(/\s+/);
+        if (fields[0] !== 'solve' || (onlyCase && fields[1] !== onlyCase)) {
+            continue;
+        }
+        const words = fields.slice(4);
+        puzzles.push({
+            name: fields[1],
+            base: Number(fields[2]),
+            solutions: Number(fields[3]),
+            sum: words.pop(),
+            sumands: words,
+        });
+    }
+    return puzzles;
+}
+
+function sameResult(a, b) {
+    return (
+        a.count === b.count &&
+        a.difficulty === b.difficulty &&
+        JSON.stringify(a.mapping) === JSON.stringify(b.mapping)
+    );
+}
+
+function check(puzzles, engines) {
+    let failed = 0;
+    for (const puzzle of puzzles) {
+        const text = `${puzzle.sumands.join(' ')} ${puzzle.sum} base ${puzzle.base}`;
+        for (const justOne of [false, true]) {
+            const results = engines.map((engine) =>
+                engine.search(puzzle.sumands, puzzle.sum, puzzle.base, justOne)
+            );
+            const expected = justOne ? Math.min(puzzle.solutions, 1) : puzzle.solutions;
+            if (results[0].count !== expected || !sameResult(results[0], results[1])) {
+                failed++;
+                console.log(`WRONG ${puzzle.name}${justOne ? ' just_one' : ''}: ${text}`);
+                for (let i = 0; i < engines.length; i++) {
+                    console.log(`    ${engines[i].name}: ${JSON.stringify(results[i])}`);
+                }
+            }
+        }
+    }
+    return failed;
+}
+
+function time(puzzles, engine, seconds) {
+    const times = [];
+    const start = performance.now();
+    do {
+        for (const puzzle of puzzles) {
+            const begin = performance.now();
+            engine.search(puzzle.sumands, puzzle.sum, puzzle.base, false);
+            times.push(performance.now() - begin);
+        }
+    } while (performance.now() - start < seconds * 1000);
+    times.sort((a, b) => a - b);
+    const total = times.reduce((a, b) => a + b, 0);
+    return {
+        solvesPerSecond: times.length / (total / 1000),
+        median: times[Math.floor(times.length / 2)] * 1000,
+    };
+}
+
+async function main() {
+    let seconds = 1;
+    let onlyCase = undefined;
+    let corpus = path.join(here, 'csolver_bench.txt');
+    const args = process.argv.slice(2);
+    for (let i = 0; i < args.length; i++) {
+        if (args[i] === '-time' && i + 1 < args.length) {
+            seconds = Number(args[++i]);
+        } else if (args[i] === '-case' && i + 1 < args.length) {
+            onlyCase = args[++i];
+        } else if (args[i].startsWith('-')) {
+            console.log('Usage: node csolver_wasm_test.mjs [-time seconds] [-case name] [corpus]');
+            process.exit(2);
+        } else {
+            corpus = args[i];
+        }
+    }
+
+    const { cryptarithm, wasm } = await loadSolvers();
+    const engines = [
+        { name: 'ts', search: cryptarithm.cryptarithmSumandSearchTS },
+        { name: 'wasm', search: wasm.csolverWasmSumandSearch },
+    ];
+    const puzzles = readCorpus(corpus, onlyCase);
+    const failed = check(puzzles, engines);
+    console.log(`${puzzles.length} puzzles checked, ${failed} wrong`);
+
+    const cases = [...new Set(puzzles.map((puzzle) => puzzle.name))];
+    console.log('case         engine  puzzles    solves/s   median us');
+    for (const name of cases) {
+        const casePuzzles = puzzles.filter((puzzle) => puzzle.name === name);
+        for (const engine of engines) {
+            const result = time(casePuzzles, engine, seconds);
+            console.log(
+                `${name.padEnd(12)} ${engine.name.padEnd(6)} ${String(casePuzzles.length).padStart(8)}` +
+                    ` ${result.solvesPerSecond.toFixed(1).padStart(11)}` +
+                    ` ${result.median.toFixed(1).padStart(11)}`
+            );
+        }
+    }
+    process.exit(failed ? 1 : 0);
+}
+
+main();
@@ -1,4 +1,5 @@
 import { makeFilledArray, BoolMap, NumberMap, repeatStr, StringMap } from '../common/ciphercommon';
+import { csolverWasmReady, csolverWasmSumandSearch } from './csolverwasm';
 
 enum CryptarithmType {
     Automatic,
@@ -144,6 +145,51 @@ export interface cryptarithmResult {
     difficulty: number
     mapping: NumberMap
 }
+
+/** Which implementation cryptarithmSumandSearch() uses */
+export type cryptarithmEngine = 'ts' | 'wasm'
+let sumandSearchEngine: cryptarithmEngine = 'ts'
+
+/**
+ * Choose the implementation used by cryptarithmSumandSearch().  'wasm' only
+ * takes effect once the WebAssembly solver has been loaded with
+ * loadCsolverWasm(); until then, the TypeScript one is used.
+ * @param engine Engine to use
+ */
+export function setCryptarithmEngine(engine: cryptarithmEngine): void {
+    sumandSearchEngine = engine
+}
+
+/**
+ * @returns The implementation cryptarithmSumandSearch() is using
+ */
+export function getCryptarithmEngine(): cryptarithmEngine {
+    if (sumandSearchEngine === 'wasm' && csolverWasmReady()) {
+        return 'wasm'
+    }
+    return 'ts'
+}
+
+/**
+ * Find the solutions to an addition puzzle with the engine chosen by
+ * setCryptarithmEngine().  See cryptarithmSumandSearchTS() for the details.
+ * Printing is only done by the TypeScript engine.
+ * @param sumands Array of strings to sum in ascending length order
+ * @param sum Sum string to target.  Must not be shorter than any of the sumands
+ * @param base Number base to solve the problem in (default=10)
+ * @param just_one true to leave after first solution, false to check for more than one solution
+ * @param print true if results to be printed
+ * @returns Number of solutions, difficulty and the last solution found
+ */
+export function cryptarithmSumandSearch(sumands: string[], sum: string, base: number = 10, just_one = false, print = false): cryptarithmResult {
+    if (!print && getCryptarithmEngine() === 'wasm') {
+        const result = csolverWasmSumandSearch(sumands, sum, base, just_one)
+        if (result.error === undefined) {
+            return result
+        }
+    }
+    return cryptarithmSumandSearchTS(sumands, sum, base, just_one, print)
+}
 /**
  * This routine taken with permission from http://www.trumancollins.net/truman/alphamet/swp.C
  * which is the backend behind http://www.trumancollins.net/truman/alphamet/alpha_gen.shtml
@@ -170,7 +216,7 @@ export interface cryptarithmResult {
  * @param print true if results to be printed
  * @returns 
  */
-export function cryptarithmSumandSearch(sumands: string[], sum: string, base: number = 10, just_one = false, print = false): cryptarithmResult {
+export function cryptarithmSumandSearchTS(sumands: string[], sum: string, base: number = 10, just_one = false, print = false): cryptarithmResult {
     //    {
     let dbgmsg = "";
     let curr_char = '';
@@ -0,0 +1,202 @@
+import { NumberMap } from './ciphercommon';
+
+/**
+ * Binding for the WebAssembly build of the native alphametic solver in
+ * app/codebusters/csolver.cxx.  The module is built there with `make wasm`
+ * (which needs Emscripten) as csolver_wasm.mjs and csolver_wasm.wasm.
+ * Nothing here is loaded until loadCsolverWasm() is called, so the app
+ * works the same without the module and uses the TypeScript engine.
+ * This file doesn't import cryptarithm.ts, which imports it.
+ */
+
+/**
+ * The parts of the Emscripten module that the binding uses
+ */
+export interface csolverWasmModule {
+    _csolver_sum_search(
+        words: number,
+        base: number,
+        stopAfter: number,
+        engine: number,
+        report: number
+    ): number
+    _malloc(size: number): number
+    _free(ptr: number): void
+    HEAPU8: Uint8Array
+    HEAP32: Int32Array
+    HEAPU32: Uint32Array
+}
+
+// The layout of csolver_report in csolver_wasm.cxx, in 32 bit words.
+// Change this and the C struct together.
+const MAX_BASE = 62
+const REPORT_SOLUTIONS = 0
+const REPORT_DIFFICULTY = 2
+const REPORT_BACKTRACKS = 3
+const REPORT_LETTER_COUNT = 4
+const REPORT_LETTERS = 5
+const REPORT_VALUES = REPORT_LETTERS + MAX_BASE
+const REPORT_ERROR = REPORT_VALUES + MAX_BASE
+const REPORT_ERROR_SIZE = 100
+const REPORT_SIZE = REPORT_ERROR * 4 + REPORT_ERROR_SIZE
+
+/**
+ * What csolverWasmSumandSearch() found.  It has the fields of the
+ * cryptarithmResult the TypeScript engine returns, so it can be used in its
+ * place, and error says why the solver couldn't take the puzzle if it couldn't.
+ */
+export interface csolverWasmResult {
+    count: number
+    difficulty: number
+    mapping: NumberMap
+    error?: string
+}
+
+/** The engines of csolver's -engine, in the order of CSOLVER_ENGINE_ in csolver.h */
+export const csolverWasmEngines = ['scan', 'mask', 'program', 'linear', 'meet']
+
+let wasmModule: csolverWasmModule = undefined
+let reportPtr = 0
+let wordsPtr = 0
+let wordsSize = 0
+
+/**
+ * Start using an Emscripten module that has already been instantiated.
+ * This is how a test running under Node hands over the module.
+ * @param module Module returned by the csolver_wasm.mjs factory
+ */
+export function setCsolverWasmModule(module: csolverWasmModule): void {
+    wasmModule = module
+    reportPtr = module._malloc(REPORT_SIZE)
+    wordsPtr = 0
+    wordsSize = 0
+}
+
+/**
+ * Load and instantiate the WebAssembly solver.
+ * @param url Where to find csolver_wasm.mjs (default = next to the page)
+ * @returns true if it was loaded, false if it couldn't be
+ */
+export async function loadCsolverWasm(url: string = 'csolver_wasm.mjs'): Promise<boolean> {
+    if (wasmModule !== undefined) {
+        return true
+    }
+    try {
+        const factory = await import(/* webpackIgnore: true */ url)
+        setCsolverWasmModule(await factory.default())
+        return true
+    } catch (e) {
+        console.log(`Unable to load the WebAssembly solver from ${url}: ${e}`)
+        return false
+    }
+}
+
+/**
+ * @returns true if the WebAssembly solver has been loaded
+ */
+export function csolverWasmReady(): boolean {
+    return wasmModule !== undefined
+}
+
+/**
+ * Solve an addition puzzle with the WebAssembly solver.  This returns the
+ * same result as cryptarithmSumandSearch(), including the mapping of the
+ * last solution found.
+ * @param sumands Array of strings to sum
+ * @param sum Sum string to target
+ * @param base Number base to solve the problem in (default=10)
+ * @param just_one true to leave after first solution
+ * @param engine Index into csolverWasmEngines of the search to use (default=scan)
+ * @returns Result of the search.  If the solver isn't loaded or couldn't take
+ *          the puzzle (such as a word that is too long), error says why and the
+ *          caller should use the TypeScript engine instead.
+ */
+export function csolverWasmSumandSearch(
+    sumands: string[],
+    sum: string,
+    base: number = 10,
+    just_one = false,
+    engine = 0
+): csolverWasmResult {
+    if (wasmModule === undefined) {
+        return { count: 0, difficulty: -1, mapping: {}, error: 'The WebAssembly solver is not loaded' }
+    }
+    // The TypeScript engine rates a summand longer than the sum, or more
+    // letters than digits, this way
+    const letters = new Set(sum)
+    for (const sumstr of sumands) {
+        if (sumstr.length > sum.length) {
+            return { count: 0, difficulty: -1, mapping: {} }
+        }
+        for (const c of sumstr) {
+            letters.add(c)
+        }
+    }
+    if (letters.size > base) {
+        return { count: 0, difficulty: -1, mapping: {} }
+    }
+    // Copy the words into the module's memory, keeping the buffer between calls.
+    // Anything that isn't plain ASCII is sent as a character the solver rejects.
+    const words = [...sumands, sum].join(' ')
+    if (words.length + 1 > wordsSize) {
+        if (wordsPtr !== 0) {
+            wasmModule._free(wordsPtr)
+        }
+        wordsSize = Math.max(words.length + 1, 256)
+        wordsPtr = wasmModule._malloc(wordsSize)
+    }
+    let heap = wasmModule.HEAPU8
+    for (let i = 0; i < words.length; i++) {
+        const code = words.charCodeAt(i)
+        heap[wordsPtr + i] = code < 128 ? code : 63
+    }
+    heap[wordsPtr + words.length] = 0
+
+    const count = wasmModule._csolver_sum_search(
+        wordsPtr,
+        base,
+        just_one ? 1 : 0,
+        engine,
+        reportPtr
+    )
+    // Memory may have grown during the call, so get the views again
+    const report = reportPtr / 4
+    const heap32 = wasmModule.HEAP32
+    if (count < 0) {
+        heap = wasmModule.HEAPU8
+        let msg = ''
+        for (let i = 0; i < REPORT_ERROR_SIZE && heap[reportPtr + REPORT_ERROR * 4 + i]; i++) {
+            msg += String.fromCharCode(heap[reportPtr + REPORT_ERROR * 4 + i])
+        }
+        return { count: 0, difficulty: -1, mapping: {}, error: msg }
+    }
+    // Like the TypeScript engine, give every letter A to Z as 0 when there
+    // is no solution
+    const mapping: NumberMap = {}
+    if (count === 0) {
+        for (const c of 'ABCDEFGHIJKLMNOPQRSTUVWXYZ') {
+            mapping[c] = 0
+        }
+    } else {
+        const letterCount = heap32[report + REPORT_LETTER_COUNT]
+        for (let i = 0; i < letterCount; i++) {
+            const c = String.fromCharCode(heap32[report + REPORT_LETTERS + i])
+            mapping[c] = heap32[report + REPORT_VALUES + i]
+        }
+    }
+    return {
+        count: heap32[report + REPORT_SOLUTIONS],
+        difficulty: heap32[report + REPORT_DIFFICULTY],
+        mapping: mapping,
+    }
+}
+
+/**
+ * @returns The backtracks taken by the last call to csolverWasmSumandSearch()
+ */
+export function csolverWasmBacktracks(): number {
+    if (wasmModule === undefined) {
+        return 0
+    }
+    return wasmModule.HEAPU32[reportPtr / 4 + REPORT_BACKTRACKS]
+}
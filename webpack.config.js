@@ -714,6 +714,26 @@ module.exports = (env, argv) => {
         );
     }
 
+    // --env=wasm=y makes the cryptarithm pages use the WebAssembly solver.  Build
+    // it first with "make wasm" in app/codebusters.
+    config.plugins.push(new webpack.DefinePlugin({
+        __CSOLVER_WASM__: JSON.stringify(!!env.wasm),
+    }));
+    if (env.wasm) {
+        config.plugins.push(new CopyWebpackPlugin({
+            patterns: [
+                {
+                    from: path.join(__dirname, 'app', 'codebusters', 'csolver_wasm.mjs'),
+                    to: dist,
+                },
+                {
+                    from: path.join(__dirname, 'app', 'codebusters', 'csolver_wasm.wasm'),
+                    to: dist,
+                },
+            ],
+        }));
+    }
+
     if (env.analyze) {
         config.plugins.push(new BundleAnalyzerPlugin());
     }